@@ -26,6 +26,21 @@ class Contact(Structure):
         ("prop_count", c_int)
     ]
 
+class DuplicateCluster(Structure):
+    _fields_ = [
+        ("first", c_int),
+        ("count", c_int),
+        ("score", c_double)
+    ]
+
+class DuplicateReport(Structure):
+    _fields_ = [
+        ("cluster_count", c_int),
+        ("clusters", POINTER(DuplicateCluster)),
+        ("member_count", c_int),
+        ("members", POINTER(c_int))
+    ]
+
 VCAPI = CDLL("libvcparser.so")
 
 createCard = VCAPI.createCard
@@ -60,12 +75,115 @@ decodeDate = VCAPI.decodeDate
 decodeDate.argtypes = [c_char_p]
 decodeDate.restype = c_char_p
 
+loadCardBatch = VCAPI.loadCardBatch
+loadCardBatch.argtypes = [POINTER(c_char_p), c_int, c_int, POINTER(CardPtr), POINTER(c_int), POINTER(Contact)]
+loadCardBatch.restype = c_int
+
+loadCardBatchCached = VCAPI.loadCardBatchCached
+loadCardBatchCached.argtypes = [c_void_p, POINTER(c_char_p), c_int, c_int, POINTER(CardPtr), POINTER(c_int), POINTER(Contact)]
+loadCardBatchCached.restype = c_int
+
+openCardCache = VCAPI.openCardCache
+openCardCache.argtypes = [c_char_p, POINTER(c_void_p)]
+openCardCache.restype = c_int
+
+saveCardCache = VCAPI.saveCardCache
+saveCardCache.argtypes = [c_void_p]
+saveCardCache.restype = c_int
+
+closeCardCache = VCAPI.closeCardCache
+closeCardCache.argtypes = [c_void_p]
+closeCardCache.restype = None
+
+CARD_CREATED, CARD_MODIFIED, CARD_RENAMED, CARD_DELETED, CARD_RESCAN = range(5)
+
+CardChangeCallback = CFUNCTYPE(None, c_int, c_char_p, c_char_p, CardPtr, c_int, c_void_p)
+
+openCardWatcher = VCAPI.openCardWatcher
+openCardWatcher.argtypes = [c_char_p, CardChangeCallback, c_void_p, POINTER(c_void_p)]
+openCardWatcher.restype = c_int
+
+processCardChanges = VCAPI.processCardChanges
+processCardChanges.argtypes = [c_void_p, c_int]
+processCardChanges.restype = c_int
+
+closeCardWatcher = VCAPI.closeCardWatcher
+closeCardWatcher.argtypes = [c_void_p]
+closeCardWatcher.restype = None
+
+createContactStore = VCAPI.createContactStore
+createContactStore.argtypes = [POINTER(c_void_p)]
+createContactStore.restype = c_int
+
+storeContact = VCAPI.storeContact
+storeContact.argtypes = [c_void_p, c_char_p, CardPtr]
+storeContact.restype = c_int
+
+unstoreContact = VCAPI.unstoreContact
+unstoreContact.argtypes = [c_void_p, c_char_p]
+unstoreContact.restype = c_bool
+
+renameStoredContact = VCAPI.renameStoredContact
+renameStoredContact.argtypes = [c_void_p, c_char_p, c_char_p]
+renameStoredContact.restype = c_bool
+
+queryContactsByName = VCAPI.queryContactsByName
+queryContactsByName.argtypes = [c_void_p, c_int, c_int, POINTER(Contact), POINTER(c_int)]
+queryContactsByName.restype = c_int
+
+queryContactsByBirthday = VCAPI.queryContactsByBirthday
+queryContactsByBirthday.argtypes = [c_void_p, c_int, c_int, c_int, c_int, POINTER(Contact), POINTER(c_int)]
+queryContactsByBirthday.restype = c_int
+
+searchContacts = VCAPI.searchContacts
+searchContacts.argtypes = [c_void_p, c_char_p, c_int, POINTER(Contact)]
+searchContacts.restype = c_int
+
+findDuplicateCards = VCAPI.findDuplicateCards
+findDuplicateCards.argtypes = [POINTER(CardPtr), c_int, c_double, POINTER(POINTER(DuplicateReport))]
+findDuplicateCards.restype = c_int
+
+freeDuplicateReport = VCAPI.freeDuplicateReport
+freeDuplicateReport.argtypes = [POINTER(DuplicateReport)]
+freeDuplicateReport.restype = None
+
+getCardHash = VCAPI.getCardHash
+getCardHash.argtypes = [CardPtr]
+getCardHash.restype = c_uint64
+
+deleteCard = VCAPI.deleteCard
+deleteCard.argtypes = [CardPtr]
+deleteCard.restype = None
+
+# Files handed to loadCardBatch per call
+LOAD_BATCH_SIZE = 1024
+
+# Parse results of cards/ kept across restarts, inside the directory (only .vcf files are cards)
+CARD_CACHE_FILE = "cards.cache"
+
+# Contacts fetched from the store per query call
+QUERY_PAGE_SIZE = 256
+
+# Contacts listed for a search, best matches first
+SEARCH_LIMIT = 256
+
+# Lowest score of two cards reported as the same contact, see findDuplicateCards
+DUPLICATE_THRESHOLD = 0.7
+
 class ContactModel:
     def __init__(self, db_connection):
         self.contacts = []
         self.cardPtrs = []
         self.current_id = None
         self.db = db_connection
+        self.watcher = c_void_p()
+        # Set when the watcher lost events, see rescan_contacts
+        self.rescan_needed = False
+        # Answers the DB view queries; the database only receives copies
+        self.store = c_void_p()
+        createContactStore(byref(self.store))
+        # ctypes only keeps the C callback alive while Python holds it
+        self._card_change_callback = CardChangeCallback(self._on_card_change)
         self.load_contacts()
 
     def load_contacts(self):
@@ -73,32 +191,188 @@ class ContactModel:
         if not os.path.exists(card_dir):
             os.makedirs(card_dir)
             
+        # Watch before listing, so nothing changed during the load is missed
+        if not self.watcher:
+            openCardWatcher(card_dir.encode('utf-8'), self._card_change_callback, None, byref(self.watcher))
+
         vcf_files = [f for f in os.listdir(card_dir) if f.endswith(".vcf")]
 
-        for file in vcf_files:
-            full_path = self.get_full_path(file)
-            card_ptr = CardPtr()
+        # Unchanged files come from the cache instead of being parsed again
+        cache = c_void_p()
+        openCardCache(os.path.join(card_dir, CARD_CACHE_FILE).encode('utf-8'), byref(cache))
 
-            err = createCard(full_path, byref(card_ptr))
-            if err != 0:
-                err_str = errorToString(err)
-                continue
+        for start in range(0, len(vcf_files), LOAD_BATCH_SIZE):
+            batch = vcf_files[start:start + LOAD_BATCH_SIZE]
+            count = len(batch)
 
-            err = validateCard(card_ptr)
+            paths = (c_char_p * count)(*[self.get_full_path(file) for file in batch])
+            cards = (CardPtr * count)()
+            errors = (c_int * count)()
+            contacts = (Contact * count)()
 
-            if err != 0:
-                err_str = errorToString(err)
-                continue
-                
-            contact = getContact(file.encode('utf-8'), card_ptr)
-            contact.birthday = decodeDate(contact.birthday) if contact.birthday else b""
-            contact.anniversary = decodeDate(contact.anniversary) if contact.anniversary else b""
-            
-            self.contacts.append(contact)
-            self.cardPtrs.append(card_ptr)
-            
+            # One call parses, validates and summarizes the whole batch
+            loadCardBatchCached(cache, paths, count, 0, cards, errors, contacts)
+
+            for i, file in enumerate(batch):
+                if errors[i] != 0:
+                    continue
+
+                card_ptr = cards[i]
+                contact = self.decode_dates(contacts[i])
+
+                self.contacts.append(contact)
+                self.cardPtrs.append(card_ptr)
+                storeContact(self.store, file.encode('utf-8'), card_ptr)
+
+                if self.db:
+                    self.update_contact_db(file, contact, commit=False)
+
+            # One commit per batch instead of one per contact
             if self.db:
-                self.insert_contact_db(file, contact)
+                self.db.commit()
+
+        saveCardCache(cache)
+        closeCardCache(cache)
+
+    @staticmethod
+    def decode_dates(contact):
+        contact.birthday = decodeDate(contact.birthday) if contact.birthday else b""
+        contact.anniversary = decodeDate(contact.anniversary) if contact.anniversary else b""
+        return contact
+
+    def apply_card_changes(self):
+        # Picks up what other tools did to cards/, reparsing only the files that changed
+        if self.watcher and processCardChanges(self.watcher, 0) < 0:
+            # cards/ itself went away or the watch failed; a new watcher starts with the rescan
+            closeCardWatcher(self.watcher)
+            self.watcher = c_void_p()
+            self.rescan_needed = True
+
+        if self.rescan_needed:
+            self.rescan_contacts()
+
+    def rescan_contacts(self):
+        # Changes were missed, so reload every card in cards/ (unchanged ones from the cache)
+        self.rescan_needed = False
+        current = self.contacts[self.current_id].file_name if self.current_id is not None else None
+        old_files = [contact.file_name for contact in self.contacts]
+
+        for card_ptr in self.cardPtrs:
+            deleteCard(card_ptr)
+        for file_name in old_files:
+            unstoreContact(self.store, file_name)
+        self.contacts = []
+        self.cardPtrs = []
+
+        self.load_contacts()
+
+        self.current_id = self.find_contact(current) if current is not None else None
+        if self.db:
+            loaded = {contact.file_name for contact in self.contacts}
+            for file_name in old_files:
+                if file_name not in loaded:
+                    self.delete_contact_db(file_name.decode('utf-8'))
+
+    def query_store(self, query, *args):
+        # Fetches every match of a ContactStore query, one page at a time
+        rows = []
+        page = (Contact * QUERY_PAGE_SIZE)()
+        total = c_int(0)
+        while True:
+            count = query(self.store, *args, len(rows), QUERY_PAGE_SIZE, page, byref(total))
+            rows.extend(self.decode_dates(Contact.from_buffer_copy(page[i])) for i in range(count))
+            if count == 0 or len(rows) >= total.value:
+                return rows
+
+    def search_contacts(self, text):
+        # Contacts whose name or email contains text, from the store's search index
+        page = (Contact * SEARCH_LIMIT)()
+        count = searchContacts(self.store, text.encode('utf-8'), SEARCH_LIMIT, page)
+        return [Contact.from_buffer_copy(page[i]) for i in range(count)]
+
+    def find_duplicates(self, threshold=DUPLICATE_THRESHOLD):
+        # Clusters of contacts that are likely the same person, as (score, contacts)
+        cards = (CardPtr * len(self.cardPtrs))(*self.cardPtrs)
+        report = POINTER(DuplicateReport)()
+        if findDuplicateCards(cards, len(self.cardPtrs), threshold, byref(report)) != 0:
+            return []
+
+        clusters = []
+        for i in range(report.contents.cluster_count):
+            cluster = report.contents.clusters[i]
+            members = [self.contacts[report.contents.members[cluster.first + j]] for j in range(cluster.count)]
+            clusters.append((cluster.score, members))
+
+        freeDuplicateReport(report)
+        return clusters
+
+    def find_contact(self, filename):
+        for id, contact in enumerate(self.contacts):
+            if contact.file_name == filename:
+                return id
+        return None
+
+    def remove_contact(self, id):
+        # The contact's file was deleted, replaced by a rename or is no longer a card
+        deleteCard(self.cardPtrs[id])
+        if self.db:
+            self.delete_contact_db(self.contacts[id].file_name.decode('utf-8'))
+        del self.contacts[id]
+        del self.cardPtrs[id]
+        if self.current_id == id:
+            self.current_id = None
+        elif self.current_id is not None and self.current_id > id:
+            self.current_id -= 1
+
+    def _on_card_change(self, change, filename, old_filename, card_ptr, err, user_data):
+        if change == CARD_RESCAN:
+            # Reloading here would run inside processCardChanges, so apply_card_changes does it
+            self.rescan_needed = True
+            return
+
+        if not filename.endswith(b".vcf"):
+            return
+
+        id = self.find_contact(filename)
+
+        if change == CARD_RENAMED:
+            old_id = self.find_contact(old_filename)
+            if old_id is None:
+                return
+            if id is not None:
+                self.remove_contact(id)
+                old_id = self.find_contact(old_filename)
+            self.contacts[old_id].file_name = filename
+            renameStoredContact(self.store, old_filename, filename)
+            if self.db:
+                self.rename_contact_db(old_filename.decode('utf-8'), filename.decode('utf-8'))
+        elif change == CARD_DELETED:
+            if id is not None:
+                self.remove_contact(id)
+            unstoreContact(self.store, filename)
+        elif err != 0 or not card_ptr:
+            # The file is no longer a valid card
+            if id is not None:
+                self.remove_contact(id)
+            unstoreContact(self.store, filename)
+        else:
+            if id is not None and getCardHash(self.cardPtrs[id]) == getCardHash(card_ptr):
+                # Saved without changes, e.g. touched or rewritten by a sync tool
+                deleteCard(card_ptr)
+                return
+            storeContact(self.store, filename, card_ptr)
+            contact = self.decode_dates(getContact(filename, card_ptr))
+            if id is None:
+                self.contacts.append(contact)
+                self.cardPtrs.append(card_ptr)
+                if self.db:
+                    self.insert_contact_db(filename.decode('utf-8'), contact)
+            else:
+                deleteCard(self.cardPtrs[id])
+                self.contacts[id] = contact
+                self.cardPtrs[id] = card_ptr
+                if self.db:
+                    self.update_contact_db(filename.decode('utf-8'), contact)
 
     def update_current_contact(self, contact_data):
         filename = contact_data["file_name"].strip()
@@ -134,6 +408,7 @@ class ContactModel:
         
         self.contacts.append(contact)
         self.cardPtrs.append(card_ptr)
+        storeContact(self.store, filename.encode('utf-8'), card_ptr)
         
         if self.db:
             self.insert_contact_db(filename, contact)
@@ -151,11 +426,12 @@ class ContactModel:
             return
         
         contact.name = new_name.encode('utf-8')
+        storeContact(self.store, filename.encode('utf-8'), self.cardPtrs[self.current_id])
         
         if self.db:
             self.update_name_db(filename, old_name, new_name)
         
-    def insert_contact_db(self, filename, contact):
+    def insert_contact_db(self, filename, contact, commit=True):
         cursor = None
         try:
             cursor = self.db.cursor()
@@ -182,6 +458,45 @@ class ContactModel:
                     file_id
                 ))
                 
+                if commit:
+                    self.db.commit()
+        except Exception as e:
+            self.db.rollback()
+            raise e
+        finally:
+            if cursor:
+                cursor.close()
+
+    def update_contact_db(self, filename, contact, commit=True):
+        cursor = None
+        try:
+            cursor = self.db.cursor()
+
+            cursor.execute("SELECT file_id FROM FILE WHERE file_name = %s", (filename,))
+            results = cursor.fetchall()
+            if not results:
+                cursor.close()
+                cursor = None
+                self.insert_contact_db(filename, contact, commit)
+                return
+            file_id = results[0][0]
+
+            cursor.execute("""
+                UPDATE CONTACT SET name = %s, birthday = NULLIF(%s, ''), anniversary = NULLIF(%s, '')
+                WHERE file_id = %s
+            """, (
+                contact.name.decode('utf-8'),
+                contact.birthday.decode('utf-8') if contact.birthday else '',
+                contact.anniversary.decode('utf-8') if contact.anniversary else '',
+                file_id
+            ))
+
+            cursor.execute("""
+                UPDATE FILE SET last_modified = NOW()
+                WHERE file_id = %s
+            """, (file_id,))
+
+            if commit:
                 self.db.commit()
         except Exception as e:
             self.db.rollback()
@@ -190,6 +505,42 @@ class ContactModel:
             if cursor:
                 cursor.close()
 
+    def rename_contact_db(self, old_filename, filename):
+        cursor = None
+        try:
+            cursor = self.db.cursor()
+
+            # A file renamed over another replaces it
+            cursor.execute("DELETE FROM FILE WHERE file_name = %s", (filename,))
+            cursor.execute("""
+                UPDATE FILE SET file_name = %s, last_modified = NOW()
+                WHERE file_name = %s
+            """, (filename, old_filename))
+
+            self.db.commit()
+        except Exception as e:
+            self.db.rollback()
+            raise e
+        finally:
+            if cursor:
+                cursor.close()
+
+    def delete_contact_db(self, filename):
+        cursor = None
+        try:
+            cursor = self.db.cursor()
+
+            # The CONTACT rows go with their FILE row, see ON DELETE CASCADE
+            cursor.execute("DELETE FROM FILE WHERE file_name = %s", (filename,))
+
+            self.db.commit()
+        except Exception as e:
+            self.db.rollback()
+            raise e
+        finally:
+            if cursor:
+                cursor.close()
+
     def update_name_db(self, filename, old_name, new_name):
         cursor = None
         try:
@@ -216,7 +567,12 @@ class ContactModel:
             if cursor:
                 cursor.close()
 
-    def get_summary(self):
+    def get_summary(self, search=""):
+        if search:
+            ids = {contact.file_name: id for id, contact in enumerate(self.contacts)}
+            matches = (c.file_name for c in self.search_contacts(search))
+            return [(name.decode('utf-8'), ids[name]) for name in matches if name in ids]
+
         summary = []
         for id, contact in enumerate(self.contacts):
             display_str = contact.file_name.decode('utf-8')
@@ -353,9 +709,11 @@ class ListView(Frame):
         
         self._edit_button = Button("Edit", self._edit)
         self._db_button = Button("DB queries", self._db_queries)
+        self._search = Text("Search:", "search", on_change=self._on_search)
         
         layout = Layout([100], fill_frame=True)
         self.add_layout(layout)
+        layout.add_widget(self._search)
         layout.add_widget(self._list_view)
         layout.add_widget(Divider())
         
@@ -378,8 +736,13 @@ class ListView(Frame):
     def _on_pick(self):
         self._edit_button.disabled = self._list_view.value is None
 
+    def _on_search(self):
+        self._list_view.options = self._model.get_summary(self._search.value)
+        self._on_pick()
+
     def _reload_list(self, new_value=None):
-        self._list_view.options = self._model.get_summary()
+        self._model.apply_card_changes()
+        self._list_view.options = self._model.get_summary(self._search.value)
         self._list_view.value = new_value
 
     def _add(self):
@@ -465,11 +828,12 @@ class DBView(Frame):
         self.add_layout(layout)
         layout.add_widget(self._results)
         
-        layout2 = Layout([1, 1, 1])
+        layout2 = Layout([1, 1, 1, 1])
         self.add_layout(layout2)
         layout2.add_widget(Button("Display all", self._display_all), 0)
         layout2.add_widget(Button("Find June birthdays", self._find_june), 1)
-        layout2.add_widget(Button("Cancel", self._cancel), 2)
+        layout2.add_widget(Button("Find duplicates", self._find_duplicates), 2)
+        layout2.add_widget(Button("Cancel", self._cancel), 3)
         
         self.fix()
 
@@ -484,42 +848,40 @@ class DBView(Frame):
         self._results.value = "Run a query to see results here"
         self.save()
 
+    @staticmethod
+    def _text(value):
+        return value.decode('utf-8') if value else None
+
     def _display_all(self):
-        if not self._model.db:
-            return
-            
-        cursor = self._model.db.cursor()
-        cursor.execute("""
-            SELECT DISTINCT c.name, c.birthday, c.anniversary, f.file_name
-            FROM CONTACT c
-            JOIN FILE f ON c.file_id = f.file_id
-            ORDER BY c.name
-        """)
-        
-        results = cursor.fetchall()
+        contacts = self._model.query_store(queryContactsByName)
+
+        results = [(self._text(c.name), self._text(c.birthday), self._text(c.anniversary), self._text(c.file_name))
+                   for c in contacts]
         headers = ["Name", "Birthday", "Anniversary", "File"]
         self._results.value = "All Contacts:\n" + self._format_as_table(headers, results)
 
-        cursor.close()
-
     def _find_june(self):
-        if not self._model.db:
-            return
-            
-        cursor = self._model.db.cursor()
-        cursor.execute("""
-            SELECT c.name, c.birthday
-            FROM CONTACT c
-            JOIN FILE f ON c.file_id = f.file_id
-            WHERE MONTH(c.birthday) = 6
-            ORDER BY (DATEDIFF(f.last_modified, c.birthday) / 365) DESC
-        """)
-        
-        results = cursor.fetchall()
+        contacts = self._model.query_store(queryContactsByBirthday, 6, 0)
+
+        # Oldest first, as the age ordering of the SQL version; birthdays without a year last
+        contacts.sort(key=lambda c: (not c.birthday[:1].isdigit(), c.birthday))
+
+        results = [(self._text(c.name), self._text(c.birthday)) for c in contacts]
         headers = ["Name", "Birthday"]
         self._results.value = "June Birthdays:\n" + self._format_as_table(headers, results)
 
-        cursor.close()
+    def _find_duplicates(self):
+        clusters = self._model.find_duplicates()
+
+        # Most certain first
+        clusters.sort(key=lambda cluster: -cluster[0])
+
+        results = [("%.2f" % score,
+                    ", ".join(self._text(c.name) or "" for c in members),
+                    ", ".join(self._text(c.file_name) for c in members))
+                   for score, members in clusters]
+        headers = ["Score", "Names", "Files"]
+        self._results.value = "Likely Duplicates:\n" + self._format_as_table(headers, results)
 
     def _format_as_table(self, headers, rows):
         if not rows:
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+
+# Times loading cards through ctypes the way load_contacts in A3main.py does: three calls
+# per file (createCard, validateCard, getContact) against one loadCardBatch call per
+# LOAD_BATCH_SIZE files, on one thread.
+# Run from ContactMS with make bench, or: LD_LIBRARY_PATH=bin/ python3 bin/LoadBenchmark.py [count...]
+
+import os
+import shutil
+import sys
+import tempfile
+import time
+from ctypes import *
+
+
+class Card(Structure):
+    pass
+CardPtr = POINTER(Card)
+
+class Contact(Structure):
+    _fields_ = [
+        ("file_name", c_char * 60),
+        ("name", c_char * 256),
+        ("birthday", c_char * 256),
+        ("anniversary", c_char * 256),
+        ("prop_count", c_int)
+    ]
+
+VCAPI = CDLL("libvcparser.so")
+
+createCard = VCAPI.createCard
+createCard.argtypes = [c_char_p, POINTER(CardPtr)]
+createCard.restype = c_int
+
+validateCard = VCAPI.validateCard
+validateCard.argtypes = [CardPtr]
+validateCard.restype = c_int
+
+getContact = VCAPI.getContact
+getContact.argtypes = [c_char_p, CardPtr]
+getContact.restype = Contact
+
+deleteCard = VCAPI.deleteCard
+deleteCard.argtypes = [CardPtr]
+deleteCard.restype = None
+
+loadCardBatch = VCAPI.loadCardBatch
+loadCardBatch.argtypes = [POINTER(c_char_p), c_int, c_int, POINTER(CardPtr), POINTER(c_int), POINTER(Contact)]
+loadCardBatch.restype = c_int
+
+# Same chunk size as A3main.py
+LOAD_BATCH_SIZE = 1024
+
+CARD_COUNTS = [10000, 100000]
+
+
+def write_cards(card_dir, count):
+    files = []
+    for i in range(count):
+        file = "card%06d.vcf" % i
+        with open(os.path.join(card_dir, file), "w", newline="") as f:
+            f.write("BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Contact %d\r\nN:Contact;%d;;;\r\n" % (i, i))
+            f.write("TEL;TYPE=cell:+1-555-%03d-%04d\r\nEMAIL:contact%d@example.com\r\n" % (i % 1000, i % 10000, i))
+            f.write("BDAY:19%02d%02d%02d\r\nNOTE:Generated for\r\n  the load benchmark\r\nEND:VCARD\r\n" % (i % 100, i % 12 + 1, i % 28 + 1))
+        files.append(file)
+    return files
+
+
+def load_per_file(card_dir, files):
+    loaded = 0
+    for file in files:
+        card_ptr = CardPtr()
+        if createCard(os.path.join(card_dir, file).encode('utf-8'), byref(card_ptr)) != 0:
+            continue
+        if validateCard(card_ptr) == 0:
+            getContact(file.encode('utf-8'), card_ptr)
+            loaded += 1
+        deleteCard(card_ptr)
+    return loaded
+
+
+def load_batched(card_dir, files):
+    loaded = 0
+    for start in range(0, len(files), LOAD_BATCH_SIZE):
+        batch = files[start:start + LOAD_BATCH_SIZE]
+        count = len(batch)
+
+        paths = (c_char_p * count)(*[os.path.join(card_dir, file).encode('utf-8') for file in batch])
+        cards = (CardPtr * count)()
+        errors = (c_int * count)()
+        contacts = (Contact * count)()
+
+        loaded += loadCardBatch(paths, count, 1, cards, errors, contacts)
+        for i in range(count):
+            if cards[i]:
+                deleteCard(cards[i])
+    return loaded
+
+
+def main():
+    counts = [int(arg) for arg in sys.argv[1:]] or CARD_COUNTS
+    for count in counts:
+        card_dir = tempfile.mkdtemp(prefix="vcLoadBenchmark")
+        try:
+            files = write_cards(card_dir, count)
+
+            # Once untimed, so both runs find the files in the page cache
+            load_batched(card_dir, files)
+
+            start = time.perf_counter()
+            per_file = load_per_file(card_dir, files)
+            per_file_ms = (time.perf_counter() - start) * 1000
+
+            start = time.perf_counter()
+            batched = load_batched(card_dir, files)
+            batched_ms = (time.perf_counter() - start) * 1000
+
+            if per_file != count or batched != count:
+                print("load: only %d and %d of %d cards loaded" % (per_file, batched, count))
+            print("load: %d cards, per file %.0f ms, loadCardBatch %.0f ms" % (count, per_file_ms, batched_ms))
+        finally:
+            shutil.rmtree(card_dir)
+
+
+if __name__ == "__main__":
+    main()
@@ -24,6 +24,35 @@ typedef struct listNode{
     struct listNode* next;
 } Node;
 
+/**
+ * Optional allocator for the Node structs (and the List struct itself) of a list, e.g. an arena or a pool.
+ * release may be NULL if the memory is reclaimed all at once by whoever owns context.
+ **/
+typedef struct listAllocator{
+    void* (*alloc)(void* context, size_t size);
+    void (*release)(void* context, void* ptr);
+    void* context;
+} ListAllocator;
+
+/**
+ * Pool of Node structs carved out of slabs that double in size. Released nodes go on a free list
+ * and are handed out again, so a warm pool serves inserts and deletes without malloc or free.
+ * A pool may be shared by several lists, but it is not thread safe: every list drawing from it
+ * must be used by one thread at a time.
+ **/
+typedef struct nodeSlab{
+    struct nodeSlab* next;
+    int size;
+    int used;
+    Node nodes[];
+} NodeSlab;
+
+typedef struct nodePool{
+    NodeSlab* slabs;
+    Node* freeNodes;
+    int nextSlabSize;
+} NodePool;
+
 /**
  * Metadata head of the list. 
  * Contains no actual data but contains
@@ -37,6 +66,17 @@ typedef struct listHead{
     void (*deleteData)(void* toBeDeleted);
     int (*compare)(const void* first,const void* second);
     char* (*printData)(void* toBePrinted);
+    const ListAllocator* allocator;
+
+    //Changed by every insert, delete and clear, so whatever caches the contents can tell they changed
+    unsigned int modifications;
+
+    //Array-backed lists only (see initializeArrayList): the elements in order, head = tail = NULL
+    void** items;
+    int capacity;
+
+    //Where the nodes come from when it is not NULL; see initializeListWithPool
+    NodePool* pool;
 } List;
 
 
@@ -47,6 +87,10 @@ typedef struct listHead{
  **/
 typedef struct iter{
     Node* current;
+
+    //Position and end of an array-backed list, NULL for a linked one
+    void** item;
+    void** end;
 } ListIterator;
 
 
@@ -63,6 +107,55 @@ typedef struct iter{
 List* initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
 
 
+/** Same as initializeList, but the List struct and all of its nodes come from allocator instead of malloc.
+*@pre function pointer arguments must not be NULL. allocator must outlive the list.
+*@post List structure has been allocated and initialized
+*@return On success returns newly allocated List struct. Returns NULL if the allocation fails
+*@param allocator - the allocator used for the List and its Node structs
+**/
+List* initializeListWithAllocator(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second), const ListAllocator* allocator);
+
+
+/** Same as initializeList, but the nodes come from a NodePool. clearList and freeList give all of
+* the list's nodes back to the pool at once instead of freeing them one by one.
+*@pre function pointer arguments must not be NULL. A shared pool must outlive the list.
+*@post List structure has been allocated and initialized
+*@return On success returns newly allocated List struct. Returns NULL if malloc fails
+*@param pool - the pool to share with other lists, or NULL to give the list a pool of its own,
+*              allocated with the List struct and freed by freeList
+**/
+List* initializeListWithPool(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second), NodePool* pool);
+
+
+/** Creates an empty NodePool for lists to share.
+*@return the new pool, NULL if malloc fails
+*@param initialNodes - number of nodes in the first slab, later slabs double up to a limit
+**/
+NodePool* createNodePool(int initialNodes);
+
+
+/** Frees a NodePool and every node it handed out.
+*@pre every list using the pool has been freed, or will not be used again
+*@param pool - the pool to free, may be NULL
+**/
+void freeNodePool(NodePool* pool);
+
+
+/** Same as initializeList, but the elements are kept in a contiguous array instead of nodes.
+* Every list function works on it the same way. insertBack is amortized O(1) and iterating
+* reads consecutive pointers; insertFront, insertSorted and deleteDataFromList shift the
+* elements after the insertion point. The first capacity slots are allocated with the List
+* struct, so a list that never grows past them costs one allocation; on the heap that holds only
+* while the two fit in 128 bytes, larger arrays get an allocation of their own.
+*@pre function pointer arguments must not be NULL
+*@post List structure has been allocated and initialized
+*@return On success returns newly allocated List struct. Returns NULL if the allocation fails
+*@param capacity - number of elements to make room for up front, at least 1 is used
+*@param allocator - the allocator used for the List and its array, NULL for malloc
+**/
+List* initializeArrayList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second), int capacity, const ListAllocator* allocator);
+
+
 
 /**Function for creating a node for the linked list. 
 * This node contains abstracted (void *) data as well as previous and next
@@ -118,6 +211,7 @@ void clearList(List* list);
 /** Uses the comparison function pointer to place the element in the 
 * appropriate position in the list.
 * should be used as the only insert function if a sorted list is required.  
+* Each insert walks the list; a large sorted collection belongs in an OrderedList (OrderedListAPI.h).
 *@pre List exists and has memory allocated to it. Node to be added is valid.
 *@post The node to be added will be placed immediately before or after the first occurrence of a related node
 *@param list - a pointer to the List struct
@@ -141,6 +235,17 @@ void* deleteDataFromList(List* list, void* toBeDeleted);
 
 
 
+/** Removes the element whose data is the pointer data, without calling compare or deleteData.
+ *@pre List must exist and have memory allocated to it
+ *@post the element is no longer in the list; its data is not freed
+ *@param list - a pointer to the List struct
+ *@param data - the data pointer stored in the list
+ *@return data if it was in the list, NULL otherwise
+ **/
+void* removeFromList(List* list, const void* data);
+
+
+
 /**Returns a pointer to the data at the front of the list. Does not alter list structure.
  *@pre The list exists and has memory allocated to it
  *@param list - a pointer to the List struct
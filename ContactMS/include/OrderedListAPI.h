@@ -0,0 +1,166 @@
+/**
+ * @file OrderedListAPI.h
+ * @brief Function definitions of a sorted list with O(log n) insert, delete and lookup
+ */
+
+#ifndef _ORDERED_LIST_API_
+#define _ORDERED_LIST_API_
+
+#include <stdint.h>
+
+#include "LinkedListAPI.h"
+
+//Levels of the skip list, enough for 4^16 elements with a fan-out of 4
+#define ORDERED_LIST_MAX_LEVEL 16
+
+/**
+ * Link of a skip list node on one of the levels above the bottom one.
+ * width is the number of elements the link steps over, which makes positions O(log n) too.
+ **/
+typedef struct skipLink{
+    struct skipNode* next;
+    int width;
+} SkipLink;
+
+/**
+ * Node of a skip list. The bottom level is an ordinary doubly linked Node, so the elements can be
+ * walked with a ListIterator. A node is on its first height levels; on average it is on 4/3.
+ **/
+typedef struct skipNode{
+    Node node;
+    int height;
+    SkipLink links[];   //levels 1 to height - 1
+} SkipNode;
+
+/**
+ * Metadata head of an ordered list, a skip list kept sorted by compare.
+ * head, tail and length mean the same as in List; header is the node before head on every level,
+ * allocated with the OrderedList struct.
+ **/
+typedef struct orderedList{
+    Node* head;
+    Node* tail;
+    int length;
+    void (*deleteData)(void* toBeDeleted);
+    int (*compare)(const void* first,const void* second);
+    char* (*printData)(void* toBePrinted);
+
+    SkipNode* header;
+    int level;
+    uint32_t seed;
+} OrderedList;
+
+
+/** Function to initialize an empty ordered list with the appropriate function pointers.
+*@pre function pointer arguments must not be NULL
+*@post OrderedList structure has been allocated and initialized
+*@return On success returns newly allocated OrderedList struct. Returns NULL if malloc fails
+*@param printFunction - function pointer to print a single element of the list
+*@param deleteFunction - function pointer to delete a single piece of data from the list
+*@param compareFunction - function pointer that orders the elements, the same as qsort's
+**/
+OrderedList* initializeOrderedList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
+
+
+/** Deletes the entire list, freeing all memory associated with it, including the OrderedList struct itself.
+* Uses the supplied function pointer to release allocated memory for the data.
+*@param list - pointer to the OrderedList struct, may be NULL
+**/
+void freeOrderedList(OrderedList* list);
+
+
+/** Frees the contents of the list without deleting the OrderedList struct.
+*@post list head = list tail = NULL, list length = 0
+*@param list - pointer to the OrderedList struct
+**/
+void clearOrderedList(OrderedList* list);
+
+
+/** Inserts an element in O(log n). It goes where insertSorted would put it in a sorted List:
+* before the first element that compares greater than or equal to it.
+*@param list - pointer to the OrderedList struct
+*@param toBeAdded - a pointer to data that is to be added to the list
+**/
+void insertOrdered(OrderedList* list, void* toBeAdded);
+
+
+/** Removes the first element that compares equal to toBeDeleted, in O(log n).
+*@post the element is no longer in the list; its data is not freed
+*@return on success: the data of the removed element. on failure: NULL
+*@param list - pointer to the OrderedList struct
+*@param toBeDeleted - a pointer to data equal to the element to remove
+**/
+void* deleteDataFromOrdered(OrderedList* list, void* toBeDeleted);
+
+
+/** Removes the element whose data is the pointer data, without calling deleteData. O(log n) plus
+* the number of elements that compare equal to it.
+*@return data if it was in the list, NULL otherwise
+*@param list - pointer to the OrderedList struct
+*@param data - the data pointer stored in the list
+**/
+void* removeFromOrdered(OrderedList* list, const void* data);
+
+
+/** Finds the first element that compares equal to searchRecord, in O(log n).
+*@return the data of that element, NULL if there is none
+*@param list - pointer to the OrderedList struct
+*@param searchRecord - compared with the elements using the list's compare function
+**/
+void* findOrdered(OrderedList* list, const void* searchRecord);
+
+
+/** Returns the data of the element at a position in sorted order, in O(log n).
+*@return the data, NULL if index is out of range
+*@param list - pointer to the OrderedList struct
+*@param index - position of the element, 0 for the first
+**/
+void* getOrderedAt(OrderedList* list, int index);
+
+
+/** Counts the elements that compare less than searchRecord, in O(log n). This is the position
+* orderedIteratorFrom starts at, so the elements in a range of keys are between two ranks.
+*@return the number of elements before the first one >= searchRecord
+*@param list - pointer to the OrderedList struct
+*@param searchRecord - compared with the elements using the list's compare function
+**/
+int orderedRank(OrderedList* list, const void* searchRecord);
+
+
+void* getOrderedFront(OrderedList* list);
+void* getOrderedBack(OrderedList* list);
+int getOrderedLength(OrderedList* list);
+
+
+/** Returns a string made of printData of every element in order, like toString.
+*@return on success: char * that must be freed after use. on failure: NULL
+*@param list - pointer to the OrderedList struct
+**/
+char* orderedToString(OrderedList* list);
+
+
+/** Creates an iterator over the whole list in order. Use it with nextElement.
+*@pre the list is not changed while the iterator is in use
+*@param list - pointer to the OrderedList struct
+**/
+ListIterator createOrderedIterator(OrderedList* list);
+
+
+/** Creates an iterator that starts at the first element that compares greater than or equal to
+* searchRecord, found in O(log n). Use it with nextElement.
+*@pre the list is not changed while the iterator is in use
+*@param list - pointer to the OrderedList struct
+*@param searchRecord - compared with the elements using the list's compare function
+**/
+ListIterator orderedIteratorFrom(OrderedList* list, const void* searchRecord);
+
+
+/** Creates an iterator that starts at the element at a position, found in O(log n).
+* An index past the end gives an iterator with no elements.
+*@pre the list is not changed while the iterator is in use
+*@param list - pointer to the OrderedList struct
+*@param index - position of the first element, 0 for the first
+**/
+ListIterator orderedIteratorAt(OrderedList* list, int index);
+
+#endif
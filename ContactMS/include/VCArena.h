@@ -0,0 +1,46 @@
+#ifndef VCARENA_H
+#define VCARENA_H
+
+#include <stddef.h>
+
+#include "LinkedListAPI.h"
+
+/*  Bump allocator that owns everything reachable from one Card.
+    Memory is handed out from chunks that double in size; nothing is freed
+    individually, freeArena releases it all at once.
+*/
+typedef struct arenaChunk {
+    struct arenaChunk*  next;
+    size_t              size;
+    size_t              used;
+    _Alignas(max_align_t) char data[];
+} ArenaChunk;
+
+typedef struct cardArena {
+    ArenaChunk*     chunks;
+
+    //Lets List heads and nodes come from the arena too
+    ListAllocator   listAllocator;
+} CardArena;
+
+/** Creates an arena. The CardArena struct is stored in the first chunk,
+ *  so a card that fits in initialSize bytes costs a single malloc and a single free.
+ *@return the new arena, NULL if malloc fails
+ *@param initialSize - usable size of the first chunk
+ **/
+CardArena* createArena(size_t initialSize);
+
+/** Returns size bytes of memory aligned for any type. The memory lives until freeArena.
+ *@return pointer to the memory, NULL if a new chunk cannot be allocated
+ **/
+void* arenaAlloc(CardArena* arena, size_t size);
+
+/** Bytes that arenaAlloc(size) takes from a chunk, for sizing an arena up front. **/
+size_t arenaSizeFor(size_t size);
+
+/** Frees every chunk of the arena, including the CardArena struct itself.
+ *@param arena - the arena to free, may be NULL
+ **/
+void freeArena(CardArena* arena);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef VCBINARY_H
+#define VCBINARY_H
+
+#include <stddef.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+
+/*  Binary card format, for reloading cards without parsing vCard text.
+
+    Header fields are 32 bit little endian. In the payload, counts and string lengths
+    are LEB128 varints and a string is its length, its bytes and a NUL, so the reader
+    can use the strings where they lie. There are no pointers or offsets, so a file
+    can be read straight out of a mapping.
+
+        header      "VCBN", version, payload length, property count, parameter count,
+                    value count, flags (1 = birthday, 2 = anniversary)
+        payload     fn property, the optional properties in order, then the birthday
+                    and anniversary if their flags are set
+        property    group, name, parameter count, (name, value) per parameter,
+                    value count, values
+        date        flags (1 = UTC, 2 = text), date, time, text
+
+    The counts in the header are totals over the whole card and let the reader size
+    its arena before it starts.
+*/
+
+#define BINARY_CARD_VERSION 1
+
+/** Writes a card in the binary format, with a single write.
+ *@return OK, or WRITE_ERROR if the card has no FN or NULL fields, or the file cannot be written
+ *@param fileName - the file to create, any extension
+ *       obj - the card to write
+ **/
+VCardErrorCode writeCardBinary(const char* fileName, const Card* obj);
+
+/** Same as writeCardBinary, into a new malloc'd buffer.
+ *@return OK, WRITE_ERROR if the card has no FN or NULL fields, OTHER_ERROR if malloc fails
+ *@param data - set to the encoded card, free it with free()
+ *       len - set to its size in bytes
+ **/
+VCardErrorCode encodeCardBinary(const Card* obj, void** data, size_t* len);
+
+/** Reads a card written by writeCardBinary. The card lives in one arena sized from the
+ *  header, holding a single copy of the payload that all of its strings point into,
+ *  so there is no malloc or copy per field; deleteCard frees it.
+ *@return OK, INV_FILE if the file cannot be read or is not a binary card of this version,
+ *        INV_CARD if it is truncated or inconsistent, OTHER_ERROR if memory runs out
+ *@param fileName - the file to read
+ *       obj - set to the new Card, NULL on error
+ **/
+VCardErrorCode readCardBinary(const char* fileName, Card** obj);
+
+/** Same as readCardBinary, for a binary card already in memory, e.g. mapped from a file.
+ *@param data - the binary card, len bytes
+ **/
+VCardErrorCode readCardBinaryFromBuffer(const void* data, size_t len, Card** obj);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef VCBUFFER_H
+#define VCBUFFER_H
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+
+/*  Splits a buffer into unfolded lines without copying it.
+    Lines that are not folded point straight into the buffer. Folded lines are the
+    only ones assembled, into scratch.
+*/
+typedef struct bufferReader {
+    const char* pos;
+    const char* end;
+
+    char*       scratch;
+    size_t      scratchSize;
+} BufferReader;
+
+void initBufferReader(BufferReader* reader, const char* data, size_t len);
+bool nextBufferLine(BufferReader* reader, const char** line, size_t* len);
+void freeBufferReader(BufferReader* reader);
+
+/** Creates a Card from a vCard held in memory. The same rules as createCard apply.
+ *@pre data points to len readable bytes, it does not have to be NUL terminated
+ *@return the error code indicating success or the error encountered when parsing the card
+ *@param data - the vCard text
+ *       len - the number of bytes in data
+ *       obj - set to the new Card, NULL on error
+ **/
+VCardErrorCode createCardFromBuffer(const char* data, size_t len, Card** obj);
+
+/** Same as createCard, but the file is memory mapped and parsed in place.
+ *@return the error code indicating success or the error encountered when parsing the card
+ *@param fileName - the name of the file, must have a .vcf or .vcard extension
+ *       obj - set to the new Card, NULL on error
+ **/
+VCardErrorCode createCardFromMappedFile(const char* fileName, Card** obj);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef VCCACHE_H
+#define VCCACHE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+
+/*  On-disk cache of parsed and validated cards, so a restart only parses the files
+    that changed. Each entry holds a file's path, inode, mtime and size, its
+    createCard/validateCard result and, for good cards, the card in the binary
+    format of VCBinary.h. An entry is used only if all of the file metadata still
+    matches.
+
+    The cache file has a checksum; a missing, truncated or corrupt cache is treated as
+    empty. Files modified in the last CACHE_RACY_SECONDS before they were read are not
+    cached, since a second change within the same mtime tick would go unnoticed.
+    saveCardCache writes only the entries looked up since openCardCache, so files that
+    disappeared drop out.
+
+    Lookups and stores may run on several threads at once.
+*/
+
+#define CACHE_RACY_SECONDS 2
+
+typedef struct cacheEntry {
+    char*           path;
+    uint64_t        inode;
+    int64_t         mtimeSec;
+    uint32_t        mtimeNsec;
+    uint64_t        size;
+
+    VCardErrorCode  err;
+
+    //Binary card, NULL unless err == OK
+    const void*     blob;
+    size_t          blobLen;
+
+    //path and blob were malloc'd for this entry, rather than pointing into the cache file
+    bool            owned;
+} CacheEntry;
+
+typedef struct cardCache {
+    char*           fileName;
+
+    //Contents of the cache file as read, the entries of old point into it
+    unsigned char*  data;
+    CacheEntry*     old;
+    size_t          oldCount;
+
+    //Open addressing index over old, each slot holds an index + 1, 0 when empty
+    size_t*         slots;
+    size_t          slotCount;
+
+    //Entries looked up or stored since open, what saveCardCache writes
+    CacheEntry*     fresh;
+    size_t          freshCount;
+    size_t          freshCapacity;
+    pthread_mutex_t freshLock;
+
+    atomic_long     hits;
+    atomic_long     misses;
+} CardCache;
+
+/** Opens a cache file. A missing or unusable file gives an empty cache.
+ *@return OK, or OTHER_ERROR if memory runs out
+ *@param fileName - the cache file, created by saveCardCache
+ *       cache - set to the new cache, NULL on error
+ **/
+VCardErrorCode openCardCache(const char* fileName, CardCache** cache);
+
+/** Looks up the result for path, given its current stat. Counts a hit or a miss.
+ *@return true on a hit: *err is the cached result and *card, when *err is OK, a new card
+ *        built from the cache (delete it with deleteCard). false if the file must be parsed.
+ **/
+bool cardCacheLookup(CardCache* cache, const char* path, const struct stat* info, VCardErrorCode* err, Card** card);
+
+/** Records the result of parsing and validating path, card may be NULL unless err is OK. **/
+void cardCacheStore(CardCache* cache, const char* path, const struct stat* info, VCardErrorCode err, const Card* card);
+
+/** Writes the cache to a temporary file and renames it over the cache file.
+ *@return OK, or WRITE_ERROR
+ **/
+VCardErrorCode saveCardCache(CardCache* cache);
+
+/** Hits and misses since openCardCache. **/
+void cardCacheStats(CardCache* cache, long* hits, long* misses);
+
+/** Frees the cache without saving it. May be NULL. **/
+void closeCardCache(CardCache* cache);
+
+#endif
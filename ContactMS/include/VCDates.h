@@ -0,0 +1,93 @@
+#ifndef VCDATES_H
+#define VCDATES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+
+/*  A DateTime packed into two integers, parsed once so queries never look at strings.
+
+    The date is year << 9 | month << 5 | day, with 0 for every part the date does not
+    have, so packed dates with a year compare like the dates themselves. Text dates and
+    missing dates pack to 0. The time is the seconds since midnight plus the flags below.
+*/
+#define DATE_HAS_TIME   (1u << 17)
+#define DATE_UTC        (1u << 18)
+#define DATE_IS_TEXT    (1u << 19)
+#define DATE_PRESENT    (1u << 20)
+#define DATE_SECONDS(time)  ((time) & 0x1FFFF)
+
+#define PACK_DATE(year, month, day) (((uint32_t)(year) << 9) | ((uint32_t)(month) << 5) | (uint32_t)(day))
+#define DATE_YEAR(date)     ((int)((date) >> 9))
+#define DATE_MONTH(date)    ((int)(((date) >> 5) & 0xF))
+#define DATE_DAY(date)      ((int)((date) & 0x1F))
+
+/** Packs the date part of a DateTime: YYYYMMDD, --MMDD, --MM, ---DD and YYYY as in vCard 4.0,
+ *  and YYYY-MM-DD and YYYY-MM as some writers produce.
+ *@return the packed date, 0 for NULL, text or unparsable dates
+ **/
+uint32_t packDate(const DateTime* date);
+
+/** Packs the time part and the flags of a DateTime.
+ *@return 0 for NULL, otherwise DATE_PRESENT and the other flags that apply
+ **/
+uint32_t packTime(const DateTime* date);
+
+typedef enum dateField {DATE_BIRTHDAY, DATE_ANNIVERSARY} DateField;
+
+/*  Birthdays and anniversaries of a set of contacts in columns, one row per contact,
+    so a query is a scan of one array of 4-byte dates (SSE2 or AVX2 where the CPU has it).
+    Rows are numbered by the caller, e.g. positions in a CardDirectory.
+*/
+typedef struct dateColumns {
+    size_t      count;
+    size_t      capacity;
+
+    //Indexed by DateField
+    uint32_t*   dates[2];
+    uint32_t*   times[2];
+} DateColumns;
+
+/** Creates empty columns.
+ *@return OK, or OTHER_ERROR if memory runs out
+ *@param capacity - rows to make room for up front
+ *       columns - set to the new columns, NULL on error
+ **/
+VCardErrorCode createDateColumns(size_t capacity, DateColumns** columns);
+
+/** Columns with row i for cards[i]; NULL cards get empty rows.
+ *@return OK, or OTHER_ERROR if memory runs out
+ **/
+VCardErrorCode buildDateColumns(Card** cards, size_t count, DateColumns** columns);
+
+void freeDateColumns(DateColumns* columns);
+
+/** Sets the dates of a row from a card, or clears them if card is NULL. Rows between
+ *  the old count and row are added empty.
+ *@return OK, or OTHER_ERROR if memory runs out
+ **/
+VCardErrorCode setDateRow(DateColumns* columns, size_t row, const Card* card);
+
+/*  The queries write the numbers of the matching rows, in increasing order, to rows.
+    Like scanDelimiters they return the number of matches, which may exceed capacity;
+    only the first capacity are written.
+*/
+
+//Rows whose date is in month, 1 to 12
+size_t queryDateMonth(const DateColumns* columns, DateField field, int month, uint32_t* rows, size_t capacity);
+
+/** Rows whose date falls, in any year, on one of days days starting at month/day, e.g.
+ *  the next 30 days from today. The window may wrap past December 31; February has
+ *  29 days so leap-day dates are found. Dates without a day do not match.
+ **/
+size_t queryDateWithin(const DateColumns* columns, DateField field, int month, int day, int days, uint32_t* rows, size_t capacity);
+
+/** Rows whose packed date is between from and to, inclusive, e.g. born between
+ *  PACK_DATE(1980, 1, 1) and PACK_DATE(1989, 12, 31). Missing parts count as 0, and
+ *  dates without a year never match when from has one.
+ **/
+size_t queryDateBetween(const DateColumns* columns, DateField field, uint32_t from, uint32_t to, uint32_t* rows, size_t capacity);
+
+#endif
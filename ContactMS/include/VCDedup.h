@@ -0,0 +1,55 @@
+#ifndef VCDEDUP_H
+#define VCDEDUP_H
+
+#include <stdint.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+
+//Neighbours each card is scored against in a block of cards sharing a key
+#define DEDUP_WINDOW 16
+
+//Cards that are likely the same contact: members[first] to members[first + count - 1]
+typedef struct duplicateCluster {
+    int     first;
+    int     count;
+
+    //Every member is linked to the others through pairs scoring at least this
+    double  score;
+} DuplicateCluster;
+
+/*  Result of findDuplicateCards. members holds indexes into the cards searched, in
+    increasing order within each cluster; clusters are sorted by their first member.
+*/
+typedef struct duplicateReport {
+    int                 clusterCount;
+    DuplicateCluster*   clusters;
+
+    int                 memberCount;
+    int*                members;
+} DuplicateReport;
+
+/** Finds cards that describe the same contact, without comparing every pair.
+ *
+ *  Each card is reduced to hashes of normalized values: its name words (from FN and N,
+ *  lower case, words of one letter left out), its EMAIL addresses (lower case, without
+ *  mailto:) and its TEL numbers (the last 10 digits, if there are at least 7). Cards
+ *  sharing an email, a phone number or the same set of name words form a block, and
+ *  each card is scored against the next DEDUP_WINDOW cards of its blocks, so the work
+ *  grows with the number of cards, not with its square.
+ *
+ *  A pair scores the Jaccard similarity of the name words, averaged with 1 or 0 for
+ *  a shared email if both cards have one, and with half weight for a shared phone
+ *  number if both have one. Pairs scoring at least threshold join their clusters.
+ *
+ *@return OK, or OTHER_ERROR if memory runs out
+ *@param cards - the cards to search; NULL entries are skipped
+ *       count - number of cards
+ *       threshold - lowest score of a duplicate pair, 0 to 1
+ *       report - set to the clusters found, NULL on error
+ **/
+VCardErrorCode findDuplicateCards(Card** cards, int count, double threshold, DuplicateReport** report);
+
+void freeDuplicateReport(DuplicateReport* report);
+
+#endif
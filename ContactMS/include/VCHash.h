@@ -0,0 +1,31 @@
+#ifndef VCHASH_H
+#define VCHASH_H
+
+#include <stdint.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+
+/** 64-bit hash of everything cardToString shows: fn, then the optional properties
+ *  in order with their names, groups, parameters and values in order, then the
+ *  birthday and anniversary. Cards with equal hashes are the same card, with a
+ *  chance of 2^-64 of a collision between two unrelated cards.
+ *
+ *  The hash is the same on every run and every little-endian machine, so it can be
+ *  kept, e.g. next to a database row. It does not allocate and reads each byte once.
+ *  It is not a cryptographic hash: do not rely on it against crafted input.
+ *@return the hash, never 0
+ **/
+uint64_t cardHash(const Card* obj);
+
+/** cardHash, kept on the card so later calls cost nothing until the card changes.
+ *  addProperty, removeProperty and updateName reset it; other changes need
+ *  invalidateCardHash.
+ *@return the hash, 0 if obj is NULL
+ **/
+uint64_t getCardHash(Card* obj);
+
+//Makes the next getCardHash compute the hash again
+void invalidateCardHash(Card* obj);
+
+#endif
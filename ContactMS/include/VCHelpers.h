@@ -4,15 +4,55 @@
 #include "LinkedListAPI.h"
 #include "VCParser.h"
 #include "VCValidate.h"
+#include "VCArena.h"
+#include "VCScan.h"
+#include "VCIntern.h"
+#include "VCKind.h"
 
-VCardErrorCode createProperty(Property* property, const char* propString);
-VCardErrorCode createDateTime(DateTime* dateTime, const char* dateTimeString);
+//Usable size of the first arena chunk of an arena card, enough for a typical contact
+#define CARD_ARENA_SIZE 4096
 
-VCardErrorCode createParameterList(List* parameterss, const char* paramsSting);
-VCardErrorCode createValueList(List* values, const char* valueString);
+//Optional properties a card's list has room for before its array has to grow
+#define CARD_PROPERTY_CAPACITY 16
 
-char* bdayText(DateTime* date);
-char* annText(DateTime* date);
+//Where a card parser is within the BEGIN/VERSION/.../END:VCARD structure
+typedef enum cps {EXPECT_BEGIN, EXPECT_VERSION, IN_CARD, AFTER_END} CardParseState;
+
+/*  Single-pass card parser. Lines are fed in one at a time (already unfolded),
+    structure is checked as the Card is built so the file never has to be re-read.
+*/
+typedef struct cardParser {
+    Card*           card;
+    CardParseState  state;
+
+    //First property/date error seen, reported only if the card structure is valid
+    VCardErrorCode  propErr;
+} CardParser;
+
+VCardErrorCode createProperty(Property* property, const char* propString, size_t len, CardArena* arena);
+VCardErrorCode createDateTime(DateTime* dateTime, const char* dateTimeString, size_t len, CardArena* arena);
+
+VCardErrorCode createParameterList(List* parameterss, const char* paramsSting, size_t len, CardArena* arena);
+VCardErrorCode createValueList(List* values, const char* valueString, size_t len, CardArena* arena);
+
+Card* initializeCard(bool useArena);
+Card* initializeCardWithArena(CardArena* arena);
+void* cardAlloc(Card* card, size_t size);
+
+//Building blocks for cards; memory comes from arena, or malloc when it is NULL.
+//Card lists are array-backed, with room for capacity elements up front
+List* createCardList(CardArena* arena, int capacity, char* (*printFunction)(void*), void (*deleteFunction)(void*), int (*compareFunction)(const void*, const void*));
+char* copySpan(CardArena* arena, const char* start, size_t len);
+char* internSpan(CardArena* arena, const char* start, size_t len);
+
+void initCardParser(CardParser* parser, Card* card);
+VCardErrorCode parseCardLine(CardParser* parser, const char* line, size_t len);
+VCardErrorCode finishCardParser(CardParser* parser);
+
+//Structural lines such as BEGIN:VCARD, compared ignoring case; prefix is upper case
+bool hasPrefix(const char* line, size_t len, const char* prefix);
+
+bool readFoldedLine(FILE* fptr, char** line, size_t* size);
 
 int checkNextChar(FILE* fptr);
 VCardErrorCode removeCRLF(char* string);
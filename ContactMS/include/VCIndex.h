@@ -0,0 +1,83 @@
+#ifndef VCINDEX_H
+#define VCINDEX_H
+
+#include <stdint.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+
+#define PROPERTY_KIND_COUNT (PROP_CALURI + 1)
+
+//The properties of a card with one name, in card order
+typedef struct propertyBucket {
+    Property**  items;
+    int         count;
+    int         capacity;
+} PropertyBucket;
+
+//Bucket for a name outside PropertyKind, keyed by its upper-cased copy
+typedef struct otherPropertySlot {
+    char*           name;
+    uint64_t        hash;
+    PropertyBucket  bucket;
+} OtherPropertySlot;
+
+/*  Per-card index from property name to properties, so a lookup costs one hash
+    however many properties the card has. vCard 4.0 names go straight to a bucket
+    by PropertyKind; other names (X- extensions) are in an open addressing table.
+
+    The index is built on the first lookup and kept current by addProperty and
+    removeProperty. Changes made to optionalProperties directly are noticed through
+    the list's modification count, as are changes of the card's fn, and the index is
+    rebuilt. It lives on the heap even for arena cards; deleteCard frees it.
+
+    Building is not thread safe: call buildPropertyIndex first before looking up
+    properties of one card from several threads.
+*/
+typedef struct propertyIndex {
+    PropertyBucket      kinds[PROPERTY_KIND_COUNT];
+
+    OtherPropertySlot*  others;
+    int                 otherCount;
+    int                 otherCapacity;
+
+    //What the index was built from, to detect changes made behind its back
+    const Property*     indexedFn;
+    unsigned int        indexedModifications;
+} PropertyIndex;
+
+/** Finds every property of a card with a name, ignoring case. fn comes first, then
+ *  the optional properties in list order.
+ *@return the number of properties found, 0 if there are none or memory runs out
+ *@param card - the card to search
+ *       name - property name without group, e.g. "TEL"
+ *       props - set to the matches, an array owned by the index that is valid until
+ *               the card is changed; NULL when nothing is found. May be NULL
+ **/
+int getProperties(Card* card, const char* name, Property* const** props);
+
+/** First property of a card with a name, ignoring case.
+ *@return the property, NULL if the card has none
+ **/
+Property* getFirstProperty(Card* card, const char* name);
+
+/** Appends a property to optionalProperties and to the index, if there is one.
+ *@pre prop is allocated like the rest of the card: with cardAlloc for arena cards
+ *@return OK, INV_PROP if prop has no name, OTHER_ERROR if memory runs out
+ **/
+VCardErrorCode addProperty(Card* card, Property* prop);
+
+/** Removes a property from optionalProperties and from the index, without deleting it.
+ *@return prop, or NULL if it is not one of the card's optional properties
+ **/
+Property* removeProperty(Card* card, Property* prop);
+
+/** Builds the index of a card now instead of on its first lookup.
+ *@return OK, or OTHER_ERROR if memory runs out
+ **/
+VCardErrorCode buildPropertyIndex(Card* card);
+
+/** Frees the index of a card, if it has one. The next lookup builds it again. **/
+void freePropertyIndex(Card* card);
+
+#endif
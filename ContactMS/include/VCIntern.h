@@ -0,0 +1,39 @@
+#ifndef VCINTERN_H
+#define VCINTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*  Process-wide table of shared strings for property names, group names, parameter
+    names and common parameter values ("TEL", "TYPE", "work", ...). Every card that
+    uses one of these points at the same copy.
+
+    Interned strings are read-only and live until the process exits. They sit in one
+    reserved address range, so isInterned is a bounds check and needs no lock.
+    Lookups take a read lock, only new strings take the write lock.
+
+    The 64 MB range is reserved on first use and never released, and nothing is ever
+    removed from it. Any name the input uses is interned, arbitrary X- names included,
+    so a process reading untrusted cards can fill it; after that internString returns
+    NULL and callers fall back to private copies.
+*/
+
+//Longer strings are not worth sharing
+#define INTERN_MAX_LENGTH 64
+
+/** Returns the shared copy of str[0, len), adding it on first use.
+ *@return the interned string, or NULL if it is too long or the table is full;
+ *        the caller then makes its own copy
+ **/
+const char* internString(const char* str, size_t len);
+
+/** Whether str points into the intern table (and so must not be freed or modified). **/
+bool isInterned(const char* str);
+
+/** String equality that is a pointer compare when both strings are interned. **/
+bool internEquals(const char* first, const char* second);
+
+/** free() for strings that may be interned: interned ones are left alone. **/
+void freeUnlessInterned(char* str);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef VCKIND_H
+#define VCKIND_H
+
+#include <stddef.h>
+
+#include "VCParser.h"
+
+/** Looks up a property name, ignoring case, with a single probe of a perfect hash table.
+ *@return the PropertyKind for name[0, len), PROP_OTHER if it is not a vCard 4.0 property
+ *@param name - property name without group or parameters, need not be NUL terminated
+ **/
+PropertyKind propertyKind(const char* name, size_t len);
+
+#endif
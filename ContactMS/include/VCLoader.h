@@ -0,0 +1,71 @@
+#ifndef VCLOADER_H
+#define VCLOADER_H
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCAPIHelpers.h"
+#include "VCCache.h"
+
+/*  Result of loading every card file of a directory.
+    All arrays have count entries and are sorted by file name, so the order does
+    not depend on the number of threads or on readdir.
+*/
+typedef struct cardDirectory {
+    int             count;
+
+    //File names relative to the directory
+    char**          fileNames;
+
+    //Parsed and validated cards, NULL where errors[i] != OK
+    Card**          cards;
+
+    //Contact summary of each card, zeroed where errors[i] != OK
+    Contact*        contacts;
+
+    //Result of createCard, or of validateCard if the file parsed
+    VCardErrorCode* errors;
+} CardDirectory;
+
+/** Parses and validates every .vcf/.vcard file of a directory on a pool of threads.
+ *@return OK, INV_FILE if the directory cannot be read, OTHER_ERROR if memory runs out.
+ *        Per-file results are in (*result)->errors.
+ *@param dirName - the directory to load
+ *       threads - number of worker threads, 0 or less uses one per online CPU
+ *       result - set to the new CardDirectory, NULL on error
+ **/
+VCardErrorCode loadCardDirectory(const char* dirName, int threads, CardDirectory** result);
+
+/** Batched createCard + validateCard + getContact, so a caller going through an FFI makes
+ *  one call per chunk of files instead of several per file.
+ *  Results are written to caller-provided arrays of count entries, in the order of fileNames.
+ *@return the number of files that parsed and validated
+ *@param fileNames - paths of the files to load; contacts get the part after the last '/'
+ *       count - number of paths
+ *       threads - number of worker threads, 0 or less uses one per online CPU
+ *       cards - receives each Card, NULL where errors[i] != OK
+ *       errors - receives each result code
+ *       contacts - receives each Contact, zeroed where errors[i] != OK
+ **/
+int loadCardBatch(char** fileNames, int count, int threads, Card** cards, VCardErrorCode* errors, Contact* contacts);
+
+/** loadCardBatch that takes results from cache for files whose inode, mtime and size
+ *  are unchanged, and records the rest in it. Call saveCardCache to keep them.
+ *@param cache - from openCardCache, NULL behaves like loadCardBatch
+ **/
+int loadCardBatchCached(CardCache* cache, char** fileNames, int count, int threads, Card** cards, VCardErrorCode* errors, Contact* contacts);
+
+/** validateCard for each card of a batch, spread over a pool of threads.
+ *@param cards - the cards to validate; NULL entries give INV_CARD like validateCard
+ *       n - number of cards
+ *       out - receives validateCard(cards[i]) for each card, n entries
+ *       threads - number of worker threads, 0 or less uses one per online CPU
+ **/
+void validateCards(Card** cards, size_t n, VCardErrorCode* out, int threads);
+
+/** Frees a CardDirectory.
+ *@param dir - the directory to free, may be NULL
+ *       deleteCards - also delete the cards; pass false if the caller kept them
+ **/
+void freeCardDirectory(CardDirectory* dir, bool deleteCards);
+
+#endif
@@ -2,6 +2,7 @@
 #define _CARDPARSER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,21 +39,41 @@ typedef struct dt {
 
 //Represents a generic vCard parameter
 typedef struct param {
-	//Parameter name.  Must not be empty string.  Must not be NULL.
+	/*	Parameter name.  Must not be empty string.  Must not be NULL.
+		May point into the shared intern table (VCIntern.h): never free, realloc or edit it in
+		place, free it with freeUnlessInterned and replace it with a new string to change it.
+	*/
 	char* 	name; 
 
-	//Property description.  Must not be empty string.  Must not be NULL.
+	//Property description.  Must not be empty string.  Must not be NULL.  May be interned, as name
 	char*	value; 
 
 } Parameter;
 
 
+/*	The vCard 4.0 properties (RFC 6350), so code can switch on a property instead of
+	comparing names. Names outside this list, including X- extensions, are PROP_OTHER.
+*/
+typedef enum propKind {
+	PROP_OTHER, PROP_BEGIN, PROP_END, PROP_SOURCE, PROP_KIND, PROP_XML, PROP_FN, PROP_N,
+	PROP_NICKNAME, PROP_PHOTO, PROP_BDAY, PROP_ANNIVERSARY, PROP_GENDER, PROP_ADR, PROP_TEL,
+	PROP_EMAIL, PROP_IMPP, PROP_LANG, PROP_TZ, PROP_GEO, PROP_TITLE, PROP_ROLE, PROP_LOGO,
+	PROP_ORG, PROP_MEMBER, PROP_RELATED, PROP_CATEGORIES, PROP_NOTE, PROP_PRODID, PROP_REV,
+	PROP_SOUND, PROP_UID, PROP_CLIENTPIDMAP, PROP_URL, PROP_VERSION, PROP_KEY, PROP_FBURL,
+	PROP_CALADRURI, PROP_CALURI
+} PropertyKind;
+
+
 //Represents a generic vCard property
 typedef struct prop {
-	//Property name.  Must not be empty string.  Must not be NULL.
+	/*	Property name.  Must not be empty string.  Must not be NULL.
+		May point into the shared intern table (VCIntern.h), which every card in the process
+		uses: never free, realloc or edit it in place. Check with isInterned, free it with
+		freeUnlessInterned and replace it with a new string to change it.
+	*/
 	char* 		name; 
 
-	//Group name.  Groups are optional, so this may be an empty string.  Must not be NULL.
+	//Group name.  Groups are optional, so this may be an empty string.  Must not be NULL.  May be interned, as name
 	char* 		group;
 
 	/* 	List of property parameters.  All objects in the list will be of type Parameter.
@@ -66,6 +87,9 @@ typedef struct prop {
 	*/
 	List*		values; 
 
+	//Which property name is, ignoring case.  Must agree with name, see propertyKind in VCKind.h
+	PropertyKind	kind;
+
 } Property;
 
 
@@ -96,6 +120,21 @@ typedef struct vCard {
 	*/
 	DateTime* 	anniversary;
 
+	/*	Arena that owns everything reachable from this card, see createCardInArena.
+		NULL for cards built with malloc.
+	*/
+	struct cardArena* arena;
+
+	/*	Lookup index over fn and optionalProperties, see VCIndex.h.
+		NULL until the first getProperties call, always on the heap.
+	*/
+	struct propertyIndex* index;
+
+	/*	cardHash of the card as getCardHash last computed it, 0 if it has not, see VCHash.h.
+		Code that changes a card other than through the VCIndex and VCAPIHelpers functions
+		must call invalidateCardHash.
+	*/
+	uint64_t	hash;
 
 } Card;
 
@@ -147,4 +186,15 @@ char* dateToString(void* date);
   **/
  VCardErrorCode validateCard(const Card* obj);
 
+// ************* Arena-backed cards ***************
+
+/** Same as createCard, but every allocation reachable from the Card comes from one arena,
+ *  so deleteCard releases the whole card at once.
+ *  Strings or properties added to the card afterwards must be allocated with cardAlloc.
+ *@return the error code indicating success or the error encountered when parsing the card
+ *@param fileName - the name of the file to read
+ *       obj - set to the new Card, NULL on error
+ **/
+VCardErrorCode createCardInArena(char* fileName, Card** obj);
+
 #endif	
\ No newline at end of file
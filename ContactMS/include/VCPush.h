@@ -0,0 +1,63 @@
+#ifndef VCPUSH_H
+#define VCPUSH_H
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+
+/*  Called once per card, as soon as its END:VCARD (or the end of the input) is seen.
+    On OK, card is a new Card owned by the callback. Otherwise card is NULL and err
+    says why that card was rejected; parsing continues with the next BEGIN:VCARD.
+*/
+typedef void (*CardCallback)(Card* card, VCardErrorCode err, void* userData);
+
+/*  Push parser for vCard data that arrives in pieces, e.g. from a pipe or socket.
+    Bytes can be split anywhere, including inside a CRLF or a folded line.
+*/
+typedef struct vcardParser {
+    CardCallback    onCard;
+    void*           userData;
+
+    //Bytes of a physical line whose '\n' has not arrived yet
+    char*           partial;
+    size_t          partialLen;
+    size_t          partialSize;
+
+    //Current logical line, held until the first byte of the next line shows it is not folded
+    char*           logical;
+    size_t          logicalLen;
+    size_t          logicalSize;
+    bool            haveLogical;
+
+    //The last line was END:VCARD and went out without waiting, continuations of it are dropped
+    bool            endDispatched;
+
+    Card*           card;
+    CardParser      parser;
+
+    //Last card was bad, skip ahead to the next BEGIN:VCARD
+    bool            resync;
+
+    //Build cards in their own arena (see createCardInArena), false by default
+    bool            useArena;
+} VCardParser;
+
+/** Creates a push parser.
+ *@return the new parser, NULL if malloc fails
+ *@param onCard - called for every card, good or bad
+ *       userData - passed through to onCard
+ **/
+VCardParser* vcardParserNew(CardCallback onCard, void* userData);
+
+/** Parses the next len bytes of input. onCard runs for every card that closes in them.
+ *@return OK, or OTHER_ERROR if memory runs out (the parser should then be finished)
+ **/
+VCardErrorCode vcardParserFeed(VCardParser* ctx, const char* bytes, size_t len);
+
+/** Ends the input: a last line without a newline is parsed, an unterminated card is
+ *  reported to onCard as an error. Frees the parser.
+ *@return OK, or OTHER_ERROR if memory ran out
+ **/
+VCardErrorCode vcardParserFinish(VCardParser* ctx);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef VCSCAN_H
+#define VCSCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//Delimiter positions kept inside a DelimiterScan before it needs the heap
+#define SCAN_INLINE_POSITIONS 64
+
+/*  Offsets of every ':' ';' '.' '=' and '"' in one property line, found in a
+    single vectorized pass. The tokenizer walks these offsets instead of
+    rescanning the line with strchr for each delimiter.
+*/
+typedef struct delimiterScan {
+    const char* str;
+    size_t      count;
+    uint32_t*   positions;
+
+    uint32_t    inlinePositions[SCAN_INLINE_POSITIONS];
+} DelimiterScan;
+
+/** Writes the offsets of the delimiters of str[0, len) into positions, in order.
+ *  Uses AVX2 when the CPU has it, SSE2 otherwise (scalar on other architectures).
+ *@return the number of delimiters in the line; only the first capacity are written
+ **/
+size_t scanDelimiters(const char* str, size_t len, uint32_t* positions, size_t capacity);
+
+/** Same as scanDelimiters with the portable byte loop, for testing and benchmarks. **/
+size_t scanDelimitersScalar(const char* str, size_t len, uint32_t* positions, size_t capacity);
+
+/** Scans a line into scan, spilling to the heap for lines with many delimiters.
+ *@return false if memory runs out
+ **/
+bool scanLine(DelimiterScan* scan, const char* str, size_t len);
+
+/** Frees the heap positions of a scan, if any. **/
+void freeScan(DelimiterScan* scan);
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef VCSEARCH_H
+#define VCSEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "LinkedListAPI.h"
+#include "OrderedListAPI.h"
+#include "VCParser.h"
+
+struct searchEntry;
+
+//A term of an entry, case folded
+typedef struct searchTerm {
+    const char*         text;
+    struct searchEntry* entry;
+} SearchTerm;
+
+/*  Everything indexed for one item, in one allocation: the terms, then their text.
+    item is what queries return and may be changed; the rest belongs to the index.
+*/
+typedef struct searchEntry {
+    void*       item;
+    int         id;
+    uint32_t    stamp;
+    int         termCount;
+    SearchTerm  terms[];
+} SearchEntry;
+
+//Ids of the entries with a trigram in one of their terms, increasing; gram 0 is an empty slot
+typedef struct gramPostings {
+    uint32_t    gram;
+    uint32_t    count;
+    uint32_t    capacity;
+    uint32_t*   ids;
+} GramPostings;
+
+/*  Case-folded prefix and substring search over the terms of a set of items, e.g. the
+    names and email addresses of contacts. Folding is ASCII only; other bytes must match.
+
+    Prefix matches come from every term in one OrderedList, so they cost O(log n) plus
+    the results. Substring matches come from postings of the trigrams of the terms:
+    the postings of the query's trigrams are intersected, shortest first, until enough
+    entries with the query in one of their terms are found.
+
+    Ids are given in increasing order, so postings stay sorted by appending. Removed
+    entries leave their id and postings behind until they are half of all ids; then
+    the ids are renumbered and the postings compacted.
+
+    Not thread safe, queries included: a search index is used by one thread at a time.
+*/
+typedef struct searchIndex {
+    //Indexed by id, NULL for removed entries
+    SearchEntry**   entries;
+    int             entryCount;
+    int             entryCapacity;
+    int             removedCount;
+
+    OrderedList*    terms;
+
+    //Open addressing table, at most 3/4 full
+    GramPostings*   grams;
+    size_t          gramCount;
+    size_t          gramCapacity;
+
+    //Marks the entries already returned by the current query
+    uint32_t        stamp;
+} SearchIndex;
+
+/** Creates an empty index.
+ *@return OK, or OTHER_ERROR if memory runs out
+ *@param index - set to the new index, NULL on error
+ **/
+VCardErrorCode createSearchIndex(SearchIndex** index);
+
+void freeSearchIndex(SearchIndex* index);
+
+/** Indexes an item under terms. Empty terms and repeats are left out.
+ *@return OK, or OTHER_ERROR if memory runs out, in which case nothing was added
+ *@param item - returned by queries; the index does not own it
+ *       terms - count strings, copied
+ *       entry - set to the entry of the item, to remove it with
+ **/
+VCardErrorCode addSearchEntry(SearchIndex* index, void* item, const char* const* terms, int count, SearchEntry** entry);
+
+/** Removes and frees an entry. Does nothing if entry is NULL. **/
+void removeSearchEntry(SearchIndex* index, SearchEntry* entry);
+
+/** Finds up to limit items with a term containing text, ignoring case. Items with a term
+ *  starting with text come first, in the order of that term; the other matches follow in
+ *  no particular order. Text shorter than 3 bytes only matches at the start of terms.
+ *@return the number of items written to items, each once
+ **/
+int querySearchIndex(SearchIndex* index, const char* text, void** items, int limit);
+
+#endif
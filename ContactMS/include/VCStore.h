@@ -0,0 +1,101 @@
+#ifndef VCSTORE_H
+#define VCSTORE_H
+
+#include "LinkedListAPI.h"
+#include "OrderedListAPI.h"
+#include "VCParser.h"
+#include "VCAPIHelpers.h"
+#include "VCSearch.h"
+
+/*  Summary of one card file as kept by a ContactStore. The strings are copies in the
+    same allocation as the struct, so the store does not depend on the Card staying alive.
+    Months are 1 to 12 and days 1 to 31; 0 means the date has no such part, or is text.
+*/
+typedef struct storedContact {
+    char*   fileName;
+    char*   name;
+    char*   birthday;
+    char*   anniversary;
+    int     propCount;
+
+    int     birthdayMonth;
+    int     birthdayDay;
+    int     anniversaryMonth;
+    int     anniversaryDay;
+
+    //Entry in the store's search index, NULL if the contact is not in it
+    SearchEntry*    search;
+} StoredContact;
+
+/*  In-memory table of the contacts of a card directory, with sorted indexes so the
+    queries of the UI take O(log n) plus the size of the page they return.
+
+    byFile owns the StoredContacts and has one per file name. byName is sorted by
+    name ignoring case, then by file name. byBirthday and byAnniversary hold the
+    contacts whose date has a month, sorted by month, day, then like byName.
+    search has the FN, N and EMAIL values of every contact.
+
+    Not thread safe: a store is used by one thread at a time.
+*/
+typedef struct contactStore {
+    OrderedList*    byFile;
+    OrderedList*    byName;
+    OrderedList*    byBirthday;
+    OrderedList*    byAnniversary;
+    SearchIndex*    search;
+} ContactStore;
+
+/** Creates an empty store.
+ *@return OK, or OTHER_ERROR if memory runs out
+ *@param store - set to the new store, NULL on error
+ **/
+VCardErrorCode createContactStore(ContactStore** store);
+
+void freeContactStore(ContactStore* store);
+
+/** Adds the contact of a card file, or replaces it if the store already has fileName.
+ *@return OK, INV_CARD if the card has no FN, OTHER_ERROR if memory runs out
+ *@param fileName - file name of the card, as shown to the user
+ *       card - the parsed card; the store keeps copies of what it needs
+ **/
+VCardErrorCode storeContact(ContactStore* store, const char* fileName, const Card* card);
+
+/** Removes the contact of a file.
+ *@return true if the store had it
+ **/
+bool unstoreContact(ContactStore* store, const char* fileName);
+
+/** Moves a contact to a new file name, replacing any contact the store had under it.
+ *@return true if the store had oldFileName
+ **/
+bool renameStoredContact(ContactStore* store, const char* oldFileName, const char* newFileName);
+
+int getStoredContactCount(ContactStore* store);
+
+/** Looks a contact up by file name.
+ *@return true and fills out if the store has fileName, false otherwise
+ **/
+bool findStoredContact(ContactStore* store, const char* fileName, Contact* out);
+
+/*  The queries write one page of results to out, a caller-provided array of limit
+    entries, as Contact summaries like getContact gives. They return the number of
+    entries written and set total, if it is not NULL, to the number of matches in
+    all pages.
+*/
+
+//Every contact, sorted by name
+int queryContactsByName(ContactStore* store, int offset, int limit, Contact* out, int* total);
+
+//Contacts with a birthday in month, or on month/day if day is not 0, sorted by day then name
+int queryContactsByBirthday(ContactStore* store, int month, int day, int offset, int limit, Contact* out, int* total);
+
+//Same as queryContactsByBirthday, for anniversaries
+int queryContactsByAnniversary(ContactStore* store, int month, int day, int offset, int limit, Contact* out, int* total);
+
+/** Up to limit contacts with an FN, N component or EMAIL containing text, ignoring case.
+ *  Contacts with one starting with text come first, sorted by it; see querySearchIndex.
+ *@return the number of contacts written to out
+ **/
+int searchContacts(ContactStore* store, const char* text, int limit, Contact* out);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef VCSTREAM_H
+#define VCSTREAM_H
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+
+/*  Reads the cards of a multi-card .vcf file one at a time.
+    Only the current card and one line buffer are held in memory, so the size of
+    the file does not matter.
+*/
+typedef struct cardStream {
+    FILE*   fptr;
+
+    //Reused line buffer
+    char*   line;
+    size_t  size;
+
+    //line holds a BEGIN:VCARD that has been read but not consumed yet
+    bool    pending;
+
+    //Last card was bad, skip ahead to the next BEGIN:VCARD
+    bool    resync;
+
+    //Number of cards returned so far, good or bad
+    int     count;
+
+    //Build cards in their own arena (see createCardInArena), false by default
+    bool    useArena;
+} CardStream;
+
+/** Opens a vCard file that may contain any number of BEGIN:VCARD ... END:VCARD blocks.
+ *@pre fileName is not NULL and has a .vcf or .vcard extension
+ *@return OK, or INV_FILE if the file name is invalid or the file cannot be opened
+ *@param fileName - the name of the file to read
+ *       stream - set to the newly allocated stream, NULL on error
+ **/
+VCardErrorCode openCardStream(const char* fileName, CardStream** stream);
+
+/** Parses the next card of the stream.
+ *  A bad card returns its error code and the stream skips to the following BEGIN:VCARD,
+ *  so the caller can keep calling nextCard after an error.
+ *@return OK with *obj set to the card, OK with *obj set to NULL at the end of the stream,
+ *        or the error code of the bad card (*obj is NULL)
+ *@param stream - a stream from openCardStream
+ *       obj - set to the parsed card, owned by the caller
+ **/
+VCardErrorCode nextCard(CardStream* stream, Card** obj);
+
+/** Closes the file and frees the stream. Cards returned by nextCard are not affected.
+ *@param stream - a stream from openCardStream, may be NULL
+ **/
+void closeCardStream(CardStream* stream);
+
+#endif
@@ -1,16 +1,21 @@
 #ifndef VCVALIDATE_H
 #define VCVALIDATE_H
 
+#include <stdint.h>
+
 #include "LinkedListAPI.h"
 #include "VCParser.h"
 #include "VCHelpers.h"
 
 VCardErrorCode validateFileName(const char* fileName);
-VCardErrorCode validateFileCard(FILE* fptr, Card* obj);
 
 VCardErrorCode validateDateTime(const DateTime* date);
 VCardErrorCode validateProperty(const Property* prop);
-VCardErrorCode cardnalityCheck(const char* name);
+/** Checks one more property of a card against the at-most-once rules.
+ *@param seen - bit (1 << kind) for each property of the card checked so far; start from 0
+ *              for each card. Keeping it per call makes validateCard reentrant.
+ **/
+VCardErrorCode cardnalityCheck(PropertyKind kind, uint64_t* seen);
 VCardErrorCode validateParameter(const Parameter* param);
 
 #endif
\ No newline at end of file
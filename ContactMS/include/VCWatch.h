@@ -0,0 +1,67 @@
+#ifndef VCWATCH_H
+#define VCWATCH_H
+
+#include <stdint.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+
+/*  Watches a card directory with inotify and reports changes to its .vcf/.vcard files
+    one file at a time, so a resident contact list can be kept current without
+    rescanning the directory.
+*/
+typedef enum cardChange {CARD_CREATED, CARD_MODIFIED, CARD_RENAMED, CARD_DELETED, CARD_RESCAN} CardChange;
+
+/*  Called once per change.
+    CARD_CREATED, CARD_MODIFIED: the file was reparsed; on OK card is a new, validated
+        Card owned by the callback, otherwise card is NULL and err says why.
+        A file renamed into place over an existing one (how atomic writers save) is
+        reported as CARD_CREATED, so treat a created name that is already known as a
+        replacement.
+    CARD_RENAMED: fileName was oldFileName, the content is unchanged and card is NULL.
+    CARD_DELETED: fileName was deleted or moved out of the directory, card is NULL.
+    CARD_RESCAN: the kernel's event queue overflowed and changes were lost, so any file
+        may have changed; reread the directory. fileName and card are NULL.
+    File names are relative to the directory; oldFileName is NULL except for renames.
+*/
+typedef void (*CardChangeCallback)(CardChange change, const char* fileName, const char* oldFileName, Card* card, VCardErrorCode err, void* userData);
+
+typedef struct cardWatcher {
+    int                 fd;
+    int                 wd;
+    char*               dirName;
+
+    CardChangeCallback  onChange;
+    void*               userData;
+
+    //Card files created but not yet closed, their first close is reported as CARD_CREATED
+    char**              created;
+    size_t              createdCount;
+    size_t              createdCapacity;
+
+    //IN_MOVED_FROM waiting for its IN_MOVED_TO, moveFrom is NULL when there is none
+    uint32_t            moveCookie;
+    char*               moveFrom;
+} CardWatcher;
+
+/** Starts watching a directory.
+ *@return OK, INV_FILE if the directory cannot be watched, OTHER_ERROR if memory runs out
+ *@param dirName - the card directory
+ *       onChange - called from processCardChanges for every change
+ *       userData - passed through to onChange
+ *       watcher - set to the new watcher, NULL on error
+ **/
+VCardErrorCode openCardWatcher(const char* dirName, CardChangeCallback onChange, void* userData, CardWatcher** watcher);
+
+/** Waits up to timeoutMs (0 to poll, -1 to block) for changes and reports all that are pending.
+ *  Only the files named in the events are reparsed.
+ *@return the number of changes reported, 0 if none arrived or a signal interrupted the wait,
+ *        -1 if the directory itself was deleted or moved (or waiting for or reading the
+ *        events failed), after which the watcher only needs closing
+ **/
+int processCardChanges(CardWatcher* watcher, int timeoutMs);
+
+/** Stops watching and frees the watcher. May be NULL. **/
+void closeCardWatcher(CardWatcher* watcher);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef VCWRITER_H
+#define VCWRITER_H
+
+#include <stddef.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+
+//Options for writeCardWithFlags
+#define CARD_WRITE_FSYNC 1
+
+//A write buffer that grew past this is released afterwards instead of kept for reuse
+#define WRITE_BUFFER_KEEP (64 * 1024)
+
+/*  Growable text buffer. Capacity doubles, so building a string of n bytes is O(n)
+    however many pieces it is made of. A failed allocation sets failed and turns
+    later appends into no-ops, so callers check once at the end.
+
+    A measuring buffer only counts: run the same appends once to measure, call
+    allocateMeasured, then run them again to fill a string allocated exactly once.
+*/
+typedef struct textBuffer {
+    char*   data;
+    size_t  len;
+    size_t  capacity;
+    bool    failed;
+    bool    measuring;
+} TextBuffer;
+
+void initTextBuffer(TextBuffer* buf);
+void initMeasuringBuffer(TextBuffer* buf);
+bool allocateMeasured(TextBuffer* buf);
+void appendText(TextBuffer* buf, const char* text, size_t len);
+void appendString(TextBuffer* buf, const char* str);
+void freeTextBuffer(TextBuffer* buf);
+
+//Same text as propertyToString/dateToString, appended to buf
+void appendProperty(TextBuffer* buf, const Property* prop);
+void appendDate(TextBuffer* buf, const DateTime* date);
+
+//Same text as cardToString: FN, the optional properties, birthday and anniversary, unseparated
+void appendCardSummary(TextBuffer* buf, const Card* obj);
+
+/** Appends a card in vCard format, exactly as writeCard writes it.
+ *@return false if the card has no FN, buf is left unchanged past its old length
+ **/
+bool appendCard(TextBuffer* buf, const Card* obj);
+
+/** writeCard with options. The card is rendered into a per-thread buffer that is kept
+ *  between calls, written to a temporary file next to fileName with a single write and
+ *  renamed over fileName, so readers see either the old or the new card, never a torn one.
+ *  A replaced file keeps its permissions, and its owner and group where the process is
+ *  allowed to set them. If fileName is a symbolic link, the file it points to is replaced
+ *  and the link kept.
+ *@return OK, or WRITE_ERROR if the card or file name is invalid or the file cannot be written
+ *@param fileName - the file to replace, must have a .vcf or .vcard extension
+ *       obj - the card to write
+ *       flags - CARD_WRITE_FSYNC to flush the file and its directory to disk before
+ *               returning, so the new card also survives a power loss
+ **/
+VCardErrorCode writeCardWithFlags(const char* fileName, const Card* obj, int flags);
+
+#endif
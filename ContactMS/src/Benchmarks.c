@@ -0,0 +1,554 @@
+#define _DEFAULT_SOURCE
+
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+#include "VCScan.h"
+#include "VCBuffer.h"
+
+/*  The benchmarks behind the numbers quoted in the change history. Run all of them
+    with make bench, or some with ./benchmarks <name>... from ContactMS.
+    The library is built without optimization by default. For numbers quoted as -O2, rebuild
+    it with make clean; make bench CFLAGS="-Wall -std=c11 -O2 -fPIC"
+*/
+
+/*  Counts allocations made anywhere in the process, the library included, by standing in
+    for glibc's malloc, calloc and realloc. The benchmarks are single threaded.
+*/
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static unsigned long mallocCalls = 0;
+
+void* malloc(size_t size)
+{
+    mallocCalls++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    mallocCalls++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    mallocCalls++;
+    return __libc_realloc(ptr, size);
+}
+
+//Synthetic cards are written here, and removed at the end
+static char tempDir[] = "/tmp/vcBenchmarksXXXXXX";
+
+//Same cards on every run
+static uint32_t randomState = 2463534242u;
+
+static uint32_t nextRandom(void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static double nowMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static const char* const givenNames[] = {"Ann", "Bob", "Carla", "Dmitri", "Eve", "Farid", "Grace", "Hiro"};
+static const char* const familyNames[] = {"Smith", "Nguyen", "Okafor", "Larsen", "Moreau", "Tanaka", "Silva"};
+
+static void freePaths(char** paths, int count)
+{
+    if (paths == NULL) return;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (paths[i] != NULL) unlink(paths[i]);
+        free(paths[i]);
+    }
+    free(paths);
+}
+
+//Prints card number i, 8-12 properties: names, phones, email, address, dates, a folded note
+static void printCard(FILE* fptr, int i)
+{
+    const char* given = givenNames[nextRandom() % 8];
+    const char* family = familyNames[nextRandom() % 7];
+
+    fprintf(fptr, "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:%s %s %d\r\nN:%s;%s;;;\r\n", given, family, i, family, given);
+    fprintf(fptr, "TEL;VALUE=uri;TYPE=\"work,voice\";PREF=1:tel:+1-555-%03u-%04u\r\n",
+            nextRandom() % 1000, nextRandom() % 10000);
+    if (nextRandom() % 2) fprintf(fptr, "TEL;TYPE=cell:+1-555-%03u-%04u\r\n", nextRandom() % 1000, nextRandom() % 10000);
+    fprintf(fptr, "EMAIL;TYPE=work:%s.%s%d@example.com\r\n", given, family, i);
+    fprintf(fptr, "ADR;TYPE=home:;;%u Main Street;Springfield;IL;%05u;USA\r\n", nextRandom() % 9999, nextRandom() % 100000);
+    fprintf(fptr, "ORG:Example Corp\r\nGENDER:%s\r\n", (nextRandom() % 2) ? "F" : "M");
+    fprintf(fptr, "BDAY:19%02u%02u%02u\r\n", nextRandom() % 100, nextRandom() % 12 + 1, nextRandom() % 28 + 1);
+    if (nextRandom() % 3 == 0) fprintf(fptr, "ANNIVERSARY:20%02u%02u%02uT1430-0500\r\n", nextRandom() % 20, nextRandom() % 12 + 1, nextRandom() % 28 + 1);
+    fprintf(fptr, "NOTE:Met at the %u conference\\, talked about\r\n  parsers and file formats\r\nEND:VCARD\r\n", 2000 + nextRandom() % 25);
+}
+
+/*  Writes count cards from printCard to tempDir/card<i>.vcf.
+    Returns a malloc'd array of the paths, or NULL if a file cannot be written.
+*/
+static char** writeCards(int count)
+{
+    char** paths = (char**)calloc((size_t)count, sizeof(char*));
+    if (paths == NULL) return NULL;
+
+    for (int i = 0; i < count; i++)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/card%06d.vcf", tempDir, i);
+        paths[i] = strdup(path);
+
+        FILE* fptr = fopen(path, "wb");
+        if (fptr == NULL)
+        {
+            printf("could not write %s\n", path);
+            freePaths(paths, i + 1);
+            return NULL;
+        }
+
+        printCard(fptr, i);
+        fclose(fptr);
+    }
+
+    return paths;
+}
+
+//read(2) calls made by this process so far, from /proc/self/io; -1 if unavailable
+static long readCalls(void)
+{
+    FILE* fptr = fopen("/proc/self/io", "r");
+    if (fptr == NULL) return -1;
+
+    long calls = -1;
+    char line[128];
+    while (fgets(line, sizeof(line), fptr) != NULL)
+    {
+        if (sscanf(line, "syscr: %ld", &calls) == 1) break;
+    }
+
+    fclose(fptr);
+    return calls;
+}
+
+// ************* Parsing ***************
+
+#define PARSE_CARDS 10000
+
+//createCard over synthetic card files: read(2) calls per file and total time
+static void benchParse(void)
+{
+    char** paths = writeCards(PARSE_CARDS);
+    if (paths == NULL) return;
+
+    //Reading /proc/self/io makes read calls of its own, counted here to leave them out
+    long overhead = -readCalls();
+    overhead += readCalls();
+
+    int bad = 0;
+    long before = readCalls();
+    double start = nowMs();
+
+    for (int i = 0; i < PARSE_CARDS; i++)
+    {
+        Card* card = NULL;
+        if (createCard(paths[i], &card) != OK) bad++;
+        deleteCard(card);
+    }
+
+    double elapsed = nowMs() - start;
+    long after = readCalls();
+
+    printf("parse: %d cards in %.0f ms", PARSE_CARDS, elapsed);
+    if (before >= 0 && after >= 0) printf(", %.2f read calls per file", (double)(after - before - overhead) / PARSE_CARDS);
+    printf("%s\n", (bad > 0) ? " (some cards failed to parse)" : "");
+
+    freePaths(paths, PARSE_CARDS);
+}
+
+// ************* Delimiter scan ***************
+
+#define SCAN_LINES 4000000
+#define PROPERTY_LINES 1000000
+#define LINE_TEMPLATES 4
+
+//Property lines of the kinds cards are made of, unfolded and without CRLF
+static const char* const lineTemplates[LINE_TEMPLATES] = {
+    "TEL;VALUE=uri;TYPE=\"work,voice\";PREF=1:tel:+1-418-656-9254;ext=102",
+    "EMAIL;TYPE=work:simon.perreault@viagenie.ca",
+    "ADR;TYPE=work:;Suite D2-630;2875 Laurier;Quebec;QC;G1V 2M2;Canada",
+    "NOTE:Met at the 2019 conference\\, talked about parsers and file formats; follow up in June",
+};
+
+//scanDelimiters (AVX2 or SSE2) against the byte loop, then createProperty on the same lines
+static void benchScan(void)
+{
+    size_t lens[LINE_TEMPLATES];
+    for (int i = 0; i < LINE_TEMPLATES; i++) lens[i] = strlen(lineTemplates[i]);
+
+    uint32_t positions[SCAN_INLINE_POSITIONS];
+    size_t scalarTotal = 0;
+    size_t vectorTotal = 0;
+
+    double start = nowMs();
+    for (int i = 0; i < SCAN_LINES; i++)
+    {
+        int line = i % LINE_TEMPLATES;
+        scalarTotal += scanDelimitersScalar(lineTemplates[line], lens[line], positions, SCAN_INLINE_POSITIONS);
+    }
+    double scalarMs = nowMs() - start;
+
+    start = nowMs();
+    for (int i = 0; i < SCAN_LINES; i++)
+    {
+        int line = i % LINE_TEMPLATES;
+        vectorTotal += scanDelimiters(lineTemplates[line], lens[line], positions, SCAN_INLINE_POSITIONS);
+    }
+    double vectorMs = nowMs() - start;
+
+    printf("scan: %d lines, scalar %.0f ms, vectorized %.0f ms%s\n", SCAN_LINES, scalarMs, vectorMs,
+           (scalarTotal != vectorTotal) ? " (the scanners disagree)" : "");
+
+    int bad = 0;
+    start = nowMs();
+    for (int i = 0; i < PROPERTY_LINES; i++)
+    {
+        int line = i % LINE_TEMPLATES;
+        Property* prop = (Property*)malloc(sizeof(Property));
+        if (createProperty(prop, lineTemplates[line], lens[line], NULL) == OK) deleteProperty(prop);
+        else
+        {
+            free(prop);
+            bad++;
+        }
+    }
+
+    printf("scan: createProperty on %d lines %.0f ms%s\n", PROPERTY_LINES, nowMs() - start,
+           (bad > 0) ? " (some lines failed to parse)" : "");
+}
+
+// ************* Lists ***************
+
+#define SHAPED_CARDS 100000
+#define SHAPED_LISTS 21
+#define LIST_ROUNDS 5
+
+typedef enum listKind {LINKED_LISTS, POOL_PER_LIST, POOL_PER_CARD, ARRAY_LISTS} ListKind;
+
+static const char* const listKindNames[] = {"linked lists", "pool per list", "pool per card", "array lists"};
+
+//The lists hold pointers to this, so only list memory is measured
+static int element;
+
+static char* printNothing(void* toBePrinted)
+{
+    return NULL;
+}
+
+static void deleteNothing(void* toBeDeleted)
+{
+}
+
+static int compareNothing(const void* first, const void* second)
+{
+    return 0;
+}
+
+static List* newShapedList(ListKind kind, NodePool* pool)
+{
+    if (kind == ARRAY_LISTS) return initializeArrayList(&printNothing, &deleteNothing, &compareNothing, 4, NULL);
+    if (kind == POOL_PER_LIST || kind == POOL_PER_CARD) return initializeListWithPool(&printNothing, &deleteNothing, &compareNothing, pool);
+
+    return initializeList(&printNothing, &deleteNothing, &compareNothing);
+}
+
+/*  Lists shaped like those of a parsed card: one of 20 elements (the properties),
+    then 10 of one element and 10 of two (their parameters and values).
+    pool is shared by the lists of a POOL_PER_CARD card and NULL otherwise.
+*/
+static void buildShapedCard(ListKind kind, List** lists, NodePool* pool)
+{
+    lists[0] = newShapedList(kind, pool);
+    for (int i = 0; i < 20; i++) insertBack(lists[0], &element);
+
+    for (int i = 1; i < SHAPED_LISTS; i++)
+    {
+        lists[i] = newShapedList(kind, pool);
+        insertBack(lists[i], &element);
+        if (i > 10) insertBack(lists[i], &element);
+    }
+}
+
+//Elements visited, so the loop is not optimized away
+static long iterateShapedCards(List** lists)
+{
+    long visited = 0;
+    for (int i = 0; i < SHAPED_CARDS * SHAPED_LISTS; i++)
+    {
+        ListIterator iter = createIterator(lists[i]);
+        while (nextElement(&iter) != NULL) visited++;
+    }
+
+    return visited;
+}
+
+/*  SHAPED_CARDS cards of shaped lists built and freed LIST_ROUNDS times with linked
+    and with array lists, then real cards parsed and deleted as many times, to show
+    whether repeated loads slow down as the heap fragments.
+*/
+static void benchLists(void)
+{
+    List** lists = (List**)malloc(sizeof(List*) * SHAPED_CARDS * SHAPED_LISTS);
+    if (lists == NULL) return;
+
+    for (int kind = LINKED_LISTS; kind <= ARRAY_LISTS; kind += ARRAY_LISTS - LINKED_LISTS)
+    {
+        printf("lists: %s, %d cards, build/iterate/free ms per round:", listKindNames[kind], SHAPED_CARDS);
+        for (int round = 0; round < LIST_ROUNDS; round++)
+        {
+            double start = nowMs();
+            for (int card = 0; card < SHAPED_CARDS; card++) buildShapedCard((ListKind)kind, lists + card * SHAPED_LISTS, NULL);
+            double built = nowMs();
+            long visited = iterateShapedCards(lists);
+            double iterated = nowMs();
+            for (int i = 0; i < SHAPED_CARDS * SHAPED_LISTS; i++) freeList(lists[i]);
+            double freed = nowMs();
+
+            printf(" %.0f/%.0f/%.0f", built - start, iterated - built, freed - iterated);
+            if (visited != (long)SHAPED_CARDS * 50) printf(" (wrong count %ld)", visited);
+        }
+        printf("\n");
+    }
+
+    free(lists);
+
+    //Real cards, from memory so only parsing and freeing are timed
+    char** texts = (char**)calloc(SHAPED_CARDS, sizeof(char*));
+    size_t* lens = (size_t*)calloc(SHAPED_CARDS, sizeof(size_t));
+    Card** cards = (Card**)calloc(SHAPED_CARDS, sizeof(Card*));
+
+    for (int i = 0; texts != NULL && lens != NULL && i < SHAPED_CARDS; i++)
+    {
+        FILE* fptr = open_memstream(&texts[i], &lens[i]);
+        if (fptr == NULL) break;
+        printCard(fptr, i);
+        fclose(fptr);
+    }
+
+    if (texts != NULL && lens != NULL && cards != NULL && texts[SHAPED_CARDS - 1] != NULL)
+    {
+        printf("lists: parsed cards, %d cards, parse/delete ms per round:", SHAPED_CARDS);
+        for (int round = 0; round < LIST_ROUNDS; round++)
+        {
+            int bad = 0;
+            double start = nowMs();
+            for (int i = 0; i < SHAPED_CARDS; i++)
+            {
+                if (createCardFromBuffer(texts[i], lens[i], &cards[i]) != OK) bad++;
+            }
+            double parsed = nowMs();
+            for (int i = 0; i < SHAPED_CARDS; i++) deleteCard(cards[i]);
+            double deleted = nowMs();
+
+            printf(" %.0f/%.0f", parsed - start, deleted - parsed);
+            if (bad > 0) printf(" (%d failed)", bad);
+        }
+        printf("\n");
+    }
+
+    for (int i = 0; texts != NULL && i < SHAPED_CARDS; i++) free(texts[i]);
+    free(texts);
+    free(lens);
+    free(cards);
+}
+
+// ************* Node pools ***************
+
+#define POOL_RUNS 7
+#define POOL_PARSED_CARDS 1000
+
+typedef struct poolResult {
+    double          buildMs;
+    double          iterateMs;
+    double          freeMs;
+    unsigned long   mallocs;
+} PoolResult;
+
+//One build, iterate and free of SHAPED_CARDS shaped cards
+static bool runShapedCards(ListKind kind, PoolResult* result)
+{
+    List** lists = (List**)malloc(sizeof(List*) * SHAPED_CARDS * SHAPED_LISTS);
+    NodePool** pools = (NodePool**)calloc(SHAPED_CARDS, sizeof(NodePool*));
+    if (lists == NULL || pools == NULL)
+    {
+        free(lists);
+        free(pools);
+        return false;
+    }
+
+    unsigned long mallocsBefore = mallocCalls;
+    double start = nowMs();
+    for (int card = 0; card < SHAPED_CARDS; card++)
+    {
+        if (kind == POOL_PER_CARD) pools[card] = createNodePool(50);
+        buildShapedCard(kind, lists + card * SHAPED_LISTS, pools[card]);
+    }
+    double built = nowMs();
+    result->mallocs = mallocCalls - mallocsBefore;
+
+    long visited = iterateShapedCards(lists);
+    double iterated = nowMs();
+
+    for (int card = 0; card < SHAPED_CARDS; card++)
+    {
+        for (int i = 0; i < SHAPED_LISTS; i++) freeList(lists[card * SHAPED_LISTS + i]);
+        freeNodePool(pools[card]);
+    }
+    double freed = nowMs();
+
+    result->buildMs = built - start;
+    result->iterateMs = iterated - built;
+    result->freeMs = freed - iterated;
+
+    free(lists);
+    free(pools);
+    return visited == (long)SHAPED_CARDS * 50;
+}
+
+/*  The shaped cards with malloc'd nodes, a pool per list, a pool per card and array
+    lists. Each run is a fresh process, so no run inherits the heap of another; the best
+    of POOL_RUNS runs is reported. Then the mallocs per parsed card, for comparison.
+*/
+static void benchPool(void)
+{
+    printf("pool: %d cards, best of %d, build ms (mallocs), iterate ms, free ms\n", SHAPED_CARDS, POOL_RUNS);
+
+    for (int kind = LINKED_LISTS; kind <= ARRAY_LISTS; kind++)
+    {
+        PoolResult best = {0};
+        int runs = 0;
+
+        for (int run = 0; run < POOL_RUNS; run++)
+        {
+            int fds[2];
+            if (pipe(fds) != 0) break;
+
+            fflush(stdout);
+            pid_t child = fork();
+            if (child == 0)
+            {
+                PoolResult result;
+                bool ok = runShapedCards((ListKind)kind, &result);
+                if (ok && write(fds[1], &result, sizeof(result)) != sizeof(result)) ok = false;
+                _exit(ok ? 0 : 1);
+            }
+
+            close(fds[1]);
+            PoolResult result;
+            bool ok = (child > 0 && read(fds[0], &result, sizeof(result)) == sizeof(result));
+            close(fds[0]);
+            if (child > 0) waitpid(child, NULL, 0);
+            if (!ok) continue;
+
+            if (runs == 0 || result.buildMs < best.buildMs) best.buildMs = result.buildMs;
+            if (runs == 0 || result.iterateMs < best.iterateMs) best.iterateMs = result.iterateMs;
+            if (runs == 0 || result.freeMs < best.freeMs) best.freeMs = result.freeMs;
+            best.mallocs = result.mallocs;
+            runs++;
+        }
+
+        if (runs == 0) printf("pool: %s failed\n", listKindNames[kind]);
+        else printf("pool: %-14s %4.0f (%.1fM) %4.0f %4.0f\n", listKindNames[kind], best.buildMs,
+                    best.mallocs / 1e6, best.iterateMs, best.freeMs);
+    }
+
+    //Mallocs per card, averaged as cards differ in their properties
+    unsigned long mallocs = 0;
+    int parsed = 0;
+    for (int i = 0; i < POOL_PARSED_CARDS; i++)
+    {
+        char* text = NULL;
+        size_t len = 0;
+        FILE* fptr = open_memstream(&text, &len);
+        if (fptr == NULL) break;
+        printCard(fptr, i);
+        fclose(fptr);
+
+        Card* card = NULL;
+        unsigned long mallocsBefore = mallocCalls;
+        if (createCardFromBuffer(text, len, &card) == OK)
+        {
+            mallocs += mallocCalls - mallocsBefore;
+            parsed++;
+        }
+        deleteCard(card);
+        free(text);
+    }
+
+    if (parsed > 0) printf("pool: %.1f mallocs per parsed card\n", (double)mallocs / parsed);
+}
+
+typedef struct benchmark {
+    const char* name;
+    void (*run)(void);
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    {"parse", benchParse},
+    {"scan", benchScan},
+    {"lists", benchLists},
+    {"pool", benchPool},
+};
+
+#define BENCHMARK_COUNT ((int)(sizeof(benchmarks) / sizeof(benchmarks[0])))
+
+int main(int argc, char** argv)
+{
+    if (mkdtemp(tempDir) == NULL)
+    {
+        printf("could not create a directory for the cards\n");
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = 0; i < BENCHMARK_COUNT; i++)
+    {
+        bool selected = (argc < 2);
+        for (int arg = 1; arg < argc; arg++)
+        {
+            if (strcmp(argv[arg], benchmarks[i].name) == 0) selected = true;
+        }
+
+        if (selected) benchmarks[i].run();
+    }
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        bool known = false;
+        for (int i = 0; i < BENCHMARK_COUNT; i++)
+        {
+            if (strcmp(argv[arg], benchmarks[i].name) == 0) known = true;
+        }
+
+        if (!known)
+        {
+            printf("unknown benchmark %s\n", argv[arg]);
+            status = 1;
+        }
+    }
+
+    rmdir(tempDir);
+    return status;
+}
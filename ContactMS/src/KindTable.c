@@ -0,0 +1,92 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*  Generates the perfect hash table of VCKind.c: finds the first seed for which every
+    name lands in its own slot, and prints KIND_HASH_SEED and kindTable to paste over
+    the ones there. Build and run with make kindtable.
+
+    To add a property, add it to PropertyKind in VCParser.h and to names below in the
+    same order, rerun this and paste the output. If no seed is found, double KIND_SLOTS
+    here and in VCKind.c and use hash >> 25 there.
+*/
+
+#define KIND_SLOTS 64
+#define KIND_MAX_LENGTH 12
+
+//Same order as PropertyKind, without PROP_OTHER
+static const char* const names[] = {
+    "BEGIN", "END", "SOURCE", "KIND", "XML", "FN", "N",
+    "NICKNAME", "PHOTO", "BDAY", "ANNIVERSARY", "GENDER", "ADR", "TEL",
+    "EMAIL", "IMPP", "LANG", "TZ", "GEO", "TITLE", "ROLE", "LOGO",
+    "ORG", "MEMBER", "RELATED", "CATEGORIES", "NOTE", "PRODID", "REV",
+    "SOUND", "UID", "CLIENTPIDMAP", "URL", "VERSION", "KEY", "FBURL",
+    "CALADRURI", "CALURI",
+};
+
+#define NAME_COUNT ((int)(sizeof(names) / sizeof(names[0])))
+
+//The slot of a name for a seed, as propertyKind computes it
+static int slotOf(const char* name, uint32_t seed)
+{
+    uint32_t hash = seed;
+    for (const char* ch = name; *ch != '\0'; ch++)
+    {
+        hash = (hash ^ (unsigned char)*ch) * 16777619u;
+    }
+
+    return (int)(hash >> 26);
+}
+
+static bool isPerfect(uint32_t seed, int* slots)
+{
+    uint64_t used = 0;
+
+    for (int i = 0; i < NAME_COUNT; i++)
+    {
+        slots[i] = slotOf(names[i], seed);
+        if (used & ((uint64_t)1 << slots[i])) return false;
+        used |= (uint64_t)1 << slots[i];
+    }
+
+    return true;
+}
+
+int main(void)
+{
+    for (int i = 0; i < NAME_COUNT; i++)
+    {
+        if (strlen(names[i]) > KIND_MAX_LENGTH)
+        {
+            printf("%s is longer than KIND_MAX_LENGTH\n", names[i]);
+            return 1;
+        }
+    }
+
+    int slots[NAME_COUNT];
+    uint32_t seed = 0;
+    while (!isPerfect(seed, slots))
+    {
+        seed++;
+        if (seed == 0)
+        {
+            printf("no seed puts every name in its own slot, see the comment at the top\n");
+            return 1;
+        }
+    }
+
+    printf("#define KIND_HASH_SEED %uu\n\n", seed);
+    printf("static const KindEntry kindTable[KIND_SLOTS] = {\n");
+
+    for (int slot = 0; slot < KIND_SLOTS; slot++)
+    {
+        for (int i = 0; i < NAME_COUNT; i++)
+        {
+            if (slots[i] == slot) printf("    [%d] = {\"%s\", PROP_%s},\n", slot, names[i], names[i]);
+        }
+    }
+
+    printf("};\n");
+    return 0;
+}
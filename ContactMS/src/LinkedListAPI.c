@@ -19,14 +19,283 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 	tmpList->tail = NULL;
 
 	tmpList->length = 0;
+	tmpList->modifications = 0;
 
 	tmpList->deleteData = deleteFunction;
 	tmpList->compare = compareFunction;
 	tmpList->printData = printFunction;
+	tmpList->allocator = NULL;
+
+	tmpList->items = NULL;
+	tmpList->capacity = 0;
+	tmpList->pool = NULL;
 	
 	return tmpList;
 }
 
+List * initializeListWithAllocator(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second), const ListAllocator* allocator){
+    assert(printFunction != NULL);
+    assert(deleteFunction != NULL);
+    assert(compareFunction != NULL);
+    assert(allocator != NULL && allocator->alloc != NULL);
+
+    List * tmpList = allocator->alloc(allocator->context, sizeof(List));
+	if (tmpList == NULL){
+		return NULL;
+	}
+
+	tmpList->head = NULL;
+	tmpList->tail = NULL;
+
+	tmpList->length = 0;
+	tmpList->modifications = 0;
+
+	tmpList->deleteData = deleteFunction;
+	tmpList->compare = compareFunction;
+	tmpList->printData = printFunction;
+	tmpList->allocator = allocator;
+
+	tmpList->items = NULL;
+	tmpList->capacity = 0;
+	tmpList->pool = NULL;
+
+	return tmpList;
+}
+
+//Largest heap allocation an array list makes for its List struct and first slots together
+#define MAX_INLINE_LIST_BYTES 128
+
+List * initializeArrayList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second), int capacity, const ListAllocator* allocator){
+    assert(printFunction != NULL);
+    assert(deleteFunction != NULL);
+    assert(compareFunction != NULL);
+    assert(allocator == NULL || allocator->alloc != NULL);
+
+	if (capacity < 1){
+		capacity = 1;
+	}
+
+	//The first array lives right after the List struct, unless that would take a heap list out of malloc's small bins
+	int inlineCapacity = capacity;
+	if (allocator == NULL && sizeof(List) + (size_t)capacity * sizeof(void*) > MAX_INLINE_LIST_BYTES){
+		inlineCapacity = 1;
+		if (sizeof(List) < MAX_INLINE_LIST_BYTES){
+			inlineCapacity = (int)((MAX_INLINE_LIST_BYTES - sizeof(List)) / sizeof(void*));
+		}
+	}
+
+	size_t size = sizeof(List) + (size_t)inlineCapacity * sizeof(void*);
+	List * tmpList = (allocator == NULL) ? malloc(size) : allocator->alloc(allocator->context, size);
+	if (tmpList == NULL){
+		return NULL;
+	}
+
+	void** items = (void**)(tmpList + 1);
+	if (inlineCapacity < capacity){
+		items = malloc((size_t)capacity * sizeof(void*));
+		if (items == NULL){
+			free(tmpList);
+			return NULL;
+		}
+	}
+
+	tmpList->head = NULL;
+	tmpList->tail = NULL;
+
+	tmpList->length = 0;
+	tmpList->modifications = 0;
+
+	tmpList->deleteData = deleteFunction;
+	tmpList->compare = compareFunction;
+	tmpList->printData = printFunction;
+	tmpList->allocator = allocator;
+
+	tmpList->items = items;
+	tmpList->capacity = capacity;
+	tmpList->pool = NULL;
+
+	return tmpList;
+}
+
+//Slab sizes of a list's own pool, and the cap for every pool
+#define LIST_POOL_NODES 4
+#define MAX_SLAB_NODES 4096
+
+static void initNodePool(NodePool* pool, int initialNodes){
+	pool->slabs = NULL;
+	pool->freeNodes = NULL;
+	pool->nextSlabSize = (initialNodes < 1) ? 1 : (initialNodes > MAX_SLAB_NODES ? MAX_SLAB_NODES : initialNodes);
+}
+
+static void releaseSlabs(NodePool* pool){
+	while (pool->slabs != NULL){
+		NodeSlab* next = pool->slabs->next;
+		free(pool->slabs);
+		pool->slabs = next;
+	}
+
+	pool->freeNodes = NULL;
+}
+
+NodePool* createNodePool(int initialNodes){
+	NodePool* pool = malloc(sizeof(NodePool));
+	if (pool == NULL){
+		return NULL;
+	}
+
+	initNodePool(pool, initialNodes);
+	return pool;
+}
+
+void freeNodePool(NodePool* pool){
+	if (pool == NULL){
+		return;
+	}
+
+	releaseSlabs(pool);
+	free(pool);
+}
+
+List * initializeListWithPool(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second), NodePool* pool){
+    assert(printFunction != NULL);
+    assert(deleteFunction != NULL);
+    assert(compareFunction != NULL);
+
+	//A list's own pool lives right after the List struct
+	List * tmpList = malloc(sizeof(List) + ((pool == NULL) ? sizeof(NodePool) : 0));
+	if (tmpList == NULL){
+		return NULL;
+	}
+
+	if (pool == NULL){
+		pool = (NodePool*)(tmpList + 1);
+		initNodePool(pool, LIST_POOL_NODES);
+	}
+
+	tmpList->head = NULL;
+	tmpList->tail = NULL;
+
+	tmpList->length = 0;
+	tmpList->modifications = 0;
+
+	tmpList->deleteData = deleteFunction;
+	tmpList->compare = compareFunction;
+	tmpList->printData = printFunction;
+	tmpList->allocator = NULL;
+
+	tmpList->items = NULL;
+	tmpList->capacity = 0;
+	tmpList->pool = pool;
+
+	return tmpList;
+}
+
+static bool ownsPool(List* list){
+	return list->pool == (NodePool*)(list + 1);
+}
+
+static Node* poolNode(NodePool* pool){
+	if (pool->freeNodes != NULL){
+		Node* node = pool->freeNodes;
+		pool->freeNodes = node->next;
+		return node;
+	}
+
+	if (pool->slabs == NULL || pool->slabs->used == pool->slabs->size){
+		NodeSlab* slab = malloc(sizeof(NodeSlab) + (size_t)pool->nextSlabSize * sizeof(Node));
+		if (slab == NULL){
+			return NULL;
+		}
+
+		slab->size = pool->nextSlabSize;
+		slab->used = 0;
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+
+		if (pool->nextSlabSize < MAX_SLAB_NODES){
+			pool->nextSlabSize *= 2;
+		}
+	}
+
+	return &pool->slabs->nodes[(pool->slabs->used)++];
+}
+
+//Gives memory back to the list's allocator, or to free() if it has none
+static void releaseMemory(const ListAllocator* allocator, void* ptr){
+	if (allocator == NULL){
+		free(ptr);
+	}else if (allocator->release != NULL){
+		allocator->release(allocator->context, ptr);
+	}
+}
+
+//The array allocated along with the List struct, which is not freed on its own
+static bool isInlineArray(List* list){
+	return list->items == (void**)(list + 1);
+}
+
+//Makes room for one more element in an array-backed list
+static bool reserveItem(List* list){
+	if (list->length < list->capacity){
+		return true;
+	}
+
+	int capacity = list->capacity * 2;
+	size_t size = (size_t)capacity * sizeof(void*);
+	void** items = (list->allocator == NULL) ? malloc(size) : list->allocator->alloc(list->allocator->context, size);
+	if (items == NULL){
+		return false;
+	}
+
+	memcpy(items, list->items, (size_t)list->length * sizeof(void*));
+	if (!isInlineArray(list)){
+		releaseMemory(list->allocator, list->items);
+	}
+
+	list->items = items;
+	list->capacity = capacity;
+	return true;
+}
+
+//Inserts data at index of an array-backed list, shifting the elements after it
+static void insertItem(List* list, int index, void* data){
+	if (!reserveItem(list)){
+		return;
+	}
+
+	memmove(list->items + index + 1, list->items + index, (size_t)(list->length - index) * sizeof(void*));
+	list->items[index] = data;
+	(list->length)++;
+	(list->modifications)++;
+}
+
+static void releaseNode(List* list, Node* node){
+	if (list->pool != NULL){
+		node->next = list->pool->freeNodes;
+		list->pool->freeNodes = node;
+	}else{
+		releaseMemory(list->allocator, node);
+	}
+}
+
+static Node* allocateNode(List* list, void* data){
+	if (list->allocator == NULL && list->pool == NULL){
+		return initializeNode(data);
+	}
+
+	Node* tmpNode = (list->pool != NULL) ? poolNode(list->pool) : list->allocator->alloc(list->allocator->context, sizeof(Node));
+
+	if (tmpNode == NULL){
+		return NULL;
+	}
+
+	tmpNode->data = data;
+	tmpNode->previous = NULL;
+	tmpNode->next = NULL;
+
+	return tmpNode;
+}
+
 
 /** Deletes the entire linked list, freeing all memory.
 * uses the supplied function pointer to release allocated memory for the data
@@ -36,8 +305,19 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 **/
 void freeList(List* list){	
 
+    if (list == NULL){
+		return;
+	}
+
     clearList(list);
-	free(list);
+
+	if (list->items != NULL && !isInlineArray(list)){
+		releaseMemory(list->allocator, list->items);
+	}
+	if (list->pool != NULL && ownsPool(list)){
+		releaseSlabs(list->pool);
+	}
+	releaseMemory(list->allocator, list);
 }
 
 /** Clears the list: frees the contents of the list - Node structs and data stored in them - 
@@ -52,10 +332,35 @@ void clearList(List* list){
     if (list == NULL){
 		return;
 	}
+
+	(list->modifications)++;
+
+	if (list->items != NULL){
+		for (int i = 0; i < list->length; i++){
+			list->deleteData(list->items[i]);
+		}
+		list->length = 0;
+		return;
+	}
 	
 	if (list->head == NULL && list->tail == NULL){
 		return;
 	}
+
+	if (list->pool != NULL){
+		for (Node* node = list->head; node != NULL; node = node->next){
+			list->deleteData(node->data);
+		}
+
+		//The nodes are still chained, so the whole chain goes back in one splice
+		list->tail->next = list->pool->freeNodes;
+		list->pool->freeNodes = list->head;
+
+		list->head = NULL;
+		list->tail = NULL;
+		list->length = 0;
+		return;
+	}
 	
 	Node* tmp;
 	
@@ -63,7 +368,7 @@ void clearList(List* list){
 		list->deleteData(list->head->data);
 		tmp = list->head;
 		list->head = list->head->next;
-		free(tmp);
+		releaseMemory(list->allocator, tmp);
 	}
 	
 	list->head = NULL;
@@ -104,10 +409,22 @@ void insertBack(List* list, void* toBeAdded){
 	if (list == NULL || toBeAdded == NULL){
 		return;
 	}
+
+	if (list->items != NULL){
+		if (reserveItem(list)){
+			list->items[(list->length)++] = toBeAdded;
+			(list->modifications)++;
+		}
+		return;
+	}
 	
-	(list->length)++;
+	Node* newNode = allocateNode(list, toBeAdded);
+	if (newNode == NULL){
+		return;
+	}
 
-	Node* newNode = initializeNode(toBeAdded);
+	(list->length)++;
+	(list->modifications)++;
 	
     if (list->head == NULL && list->tail == NULL){
         list->head = newNode;
@@ -129,10 +446,19 @@ void insertFront(List* list, void* toBeAdded){
 	if (list == NULL || toBeAdded == NULL){
 		return;
 	}
+
+	if (list->items != NULL){
+		insertItem(list, 0, toBeAdded);
+		return;
+	}
 	
-	(list->length)++;
+	Node* newNode = allocateNode(list, toBeAdded);
+	if (newNode == NULL){
+		return;
+	}
 
-	Node* newNode = initializeNode(toBeAdded);
+	(list->length)++;
+	(list->modifications)++;
 	
     if (list->head == NULL && list->tail == NULL){
         list->head = newNode;
@@ -150,6 +476,10 @@ void insertFront(List* list, void* toBeAdded){
  *@return pointer to the data located at the head of the list
  **/
 void* getFromFront(List * list){
+	if (list->items != NULL){
+		return (list->length > 0) ? list->items[0] : NULL;
+	}
+
 	if (list->head == NULL){
 		return NULL;
 	}
@@ -163,6 +493,10 @@ void* getFromFront(List * list){
  *@return pointer to the data located at the tail of the list
  **/
 void* getFromBack(List * list){
+	if (list->items != NULL){
+		return (list->length > 0) ? list->items[list->length - 1] : NULL;
+	}
+
 	if (list->tail == NULL){
 		return NULL;
 	}
@@ -174,6 +508,22 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 	if (list == NULL || toBeDeleted == NULL){
 		return NULL;
 	}
+
+	if (list->items != NULL){
+		for (int i = 0; i < list->length; i++){
+			if (list->compare(toBeDeleted, list->items[i]) == 0){
+				void* data = list->items[i];
+
+				memmove(list->items + i, list->items + i + 1, (size_t)(list->length - i - 1) * sizeof(void*));
+				(list->length)--;
+				(list->modifications)++;
+
+				return data;
+			}
+		}
+
+		return NULL;
+	}
 	
 	Node* tmp = list->head;
 	
@@ -195,9 +545,10 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 			}
 			
 			void* data = delNode->data;
-			free(delNode);
+			releaseNode(list, delNode);
 			
 			(list->length)--;
+			(list->modifications)++;
 
 			return data;
 			
@@ -210,6 +561,51 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 }
 
 
+void* removeFromList(List* list, const void* data){
+	if (list == NULL || data == NULL){
+		return NULL;
+	}
+
+	if (list->items != NULL){
+		for (int i = 0; i < list->length; i++){
+			if (list->items[i] == data){
+				memmove(list->items + i, list->items + i + 1, (size_t)(list->length - i - 1) * sizeof(void*));
+				(list->length)--;
+				(list->modifications)++;
+
+				return (void*)data;
+			}
+		}
+
+		return NULL;
+	}
+
+	for (Node* node = list->head; node != NULL; node = node->next){
+		if (node->data == data){
+			if (node->previous != NULL){
+				node->previous->next = node->next;
+			}else{
+				list->head = node->next;
+			}
+
+			if (node->next != NULL){
+				node->next->previous = node->previous;
+			}else{
+				list->tail = node->previous;
+			}
+
+			releaseNode(list, node);
+			(list->length)--;
+			(list->modifications)++;
+
+			return (void*)data;
+		}
+	}
+
+	return NULL;
+}
+
+
 /** Uses the comparison function pointer to place the element in the 
 * appropriate position in the list.
 * should be used as the only insert function if a sorted list is required.  
@@ -224,6 +620,23 @@ void insertSorted(List *list, void *toBeAdded){
 		return;
 	}
 
+	if (list->items != NULL){
+		//Same placement as the linked version, which checks the head and tail before walking
+		int index = 0;
+		if (list->length > 0 && list->compare(toBeAdded, list->items[0]) > 0){
+			index = list->length;
+			if (list->compare(toBeAdded, list->items[list->length - 1]) <= 0){
+				index = 1;
+				while (list->compare(toBeAdded, list->items[index]) > 0){
+					index++;
+				}
+			}
+		}
+
+		insertItem(list, index, toBeAdded);
+		return;
+	}
+
 	if (list->head == NULL){
 		insertBack(list, toBeAdded);
 		return;
@@ -243,21 +656,16 @@ void insertSorted(List *list, void *toBeAdded){
 	
 	while (currNode != NULL){
 		if (list->compare(toBeAdded, currNode->data) <= 0){
-		
-			char* currDescr = list->printData(currNode->data); 
-			char* newDescr = list->printData(toBeAdded); 
-		
-			//printf("Inserting %s before %s\n", newDescr, currDescr);
-
-			free(currDescr);
-			free(newDescr);
-		
-			Node* newNode = initializeNode(toBeAdded);
+			Node* newNode = allocateNode(list, toBeAdded);
+			if (newNode == NULL){
+				return;
+			}
 			newNode->next = currNode;
 			newNode->previous = currNode->previous;
 			currNode->previous->next = newNode;
 			currNode->previous = newNode;
 			(list->length)++;
+			(list->modifications)++;
 
 			return;
 		}
@@ -277,18 +685,40 @@ returned string must be freed by the calling function.
  **/
 char* toString(List * list){
 	ListIterator iter = createIterator(list);
-	char* str;
-		
-	str = (char*)malloc(sizeof(char));
-	strcpy(str, "");
+
+	//Capacity doubles, so the whole string is copied O(1) times on average
+	size_t len = 0;
+	size_t capacity = 64;
+	char* str = (char*)malloc(capacity);
+	if (str == NULL){
+		return NULL;
+	}
+	str[0] = '\0';
 	
 	void* elem;
 	while((elem = nextElement(&iter)) != NULL){
 		char* currDescr = list->printData(elem);
-		int newLen = strlen(str)+50+strlen(currDescr);
-		str = (char*)realloc(str, newLen);
-		//strcat(str, "\n");
-		strcat(str, currDescr);
+		if (currDescr == NULL){
+			continue;
+		}
+
+		size_t currLen = strlen(currDescr);
+		if (len + currLen >= capacity){
+			while (len + currLen >= capacity){
+				capacity *= 2;
+			}
+
+			char* tmp = (char*)realloc(str, capacity);
+			if (tmp == NULL){
+				free(currDescr);
+				free(str);
+				return NULL;
+			}
+			str = tmp;
+		}
+
+		memcpy(str + len, currDescr, currLen + 1);
+		len += currLen;
 		
 		free(currDescr);
 	}
@@ -300,11 +730,17 @@ ListIterator createIterator(List* list){
     ListIterator iter;
 
     iter.current = list->head;
+    iter.item = list->items;
+    iter.end = (list->items != NULL) ? list->items + list->length : NULL;
     
     return iter;
 }
 
 void* nextElement(ListIterator* iter){
+    if (iter->item != NULL){
+        return (iter->item < iter->end) ? *(iter->item)++ : NULL;
+    }
+
     Node* tmp = iter->current;
     
     if (tmp != NULL){
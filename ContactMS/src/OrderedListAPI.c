@@ -0,0 +1,385 @@
+#include "OrderedListAPI.h"
+
+/*  Skip list with a fan-out of 4: a node is on level i + 1 with probability 1/4 if it is on
+    level i. Searches go down from the top level, so every operation compares O(log n) elements.
+
+    The header is at position 0 and the elements at 1 to length. A link's width is the
+    difference of the positions at its two ends, with NULL at length + 1; on the bottom level
+    every width is 1 and is not stored.
+*/
+
+static SkipNode* nextAt(SkipNode* x, int level){
+	return (level == 0) ? (SkipNode*)x->node.next : x->links[level - 1].next;
+}
+
+static int widthAt(SkipNode* x, int level){
+	return (level == 0) ? 1 : x->links[level - 1].width;
+}
+
+static int randomHeight(OrderedList* list){
+	//xorshift32, so every list makes the same levels for the same inserts
+	uint32_t r = list->seed;
+	r ^= r << 13;
+	r ^= r >> 17;
+	r ^= r << 5;
+	list->seed = r;
+
+	int height = 1;
+	while (height < ORDERED_LIST_MAX_LEVEL && (r & 3) == 0){
+		height++;
+		r >>= 2;
+	}
+
+	return height;
+}
+
+//Fills update with the last node before searchRecord on every level, returns the position of update[0]
+static int findPredecessors(OrderedList* list, const void* searchRecord, SkipNode** update, int* rank){
+	SkipNode* x = list->header;
+	int pos = 0;
+
+	for (int i = list->level - 1; i >= 0; i--){
+		SkipNode* next;
+		while ((next = nextAt(x, i)) != NULL && list->compare(searchRecord, next->node.data) > 0){
+			pos += widthAt(x, i);
+			x = next;
+		}
+
+		update[i] = x;
+		if (rank != NULL){
+			rank[i] = pos;
+		}
+	}
+
+	return pos;
+}
+
+static SkipNode* nodeAt(OrderedList* list, int index){
+	if (index < 0 || index >= list->length){
+		return NULL;
+	}
+
+	SkipNode* x = list->header;
+	int pos = 0;
+
+	for (int i = list->level - 1; i >= 0; i--){
+		SkipNode* next;
+		while ((next = nextAt(x, i)) != NULL && pos + widthAt(x, i) <= index + 1){
+			pos += widthAt(x, i);
+			x = next;
+		}
+	}
+
+	return x;
+}
+
+static void unlinkNode(OrderedList* list, SkipNode* node, SkipNode** update){
+	for (int i = 1; i < list->level; i++){
+		SkipLink* link = &update[i]->links[i - 1];
+
+		if (link->next == node){
+			link->next = node->links[i - 1].next;
+			link->width += node->links[i - 1].width - 1;
+		}else{
+			link->width--;
+		}
+	}
+
+	Node* prev = node->node.previous;
+	Node* next = node->node.next;
+
+	update[0]->node.next = next;
+	if (next != NULL){
+		next->previous = prev;
+	}else{
+		list->tail = prev;
+	}
+	if (prev == NULL){
+		list->head = next;
+	}
+
+	while (list->level > 1 && list->header->links[list->level - 2].next == NULL){
+		list->level--;
+	}
+
+	(list->length)--;
+	free(node);
+}
+
+//The bottom level as a List, for the functions of LinkedListAPI that only walk it
+static List bottomList(OrderedList* list){
+	List view;
+
+	memset(&view, 0, sizeof(List));
+	view.head = list->head;
+	view.tail = list->tail;
+	view.length = list->length;
+	view.deleteData = list->deleteData;
+	view.compare = list->compare;
+	view.printData = list->printData;
+
+	return view;
+}
+
+OrderedList* initializeOrderedList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second)){
+	assert(printFunction != NULL);
+	assert(deleteFunction != NULL);
+	assert(compareFunction != NULL);
+
+	//The header is on every level, so it is allocated at full height with the list
+	OrderedList* tmpList = malloc(sizeof(OrderedList) + sizeof(SkipNode) + (ORDERED_LIST_MAX_LEVEL - 1) * sizeof(SkipLink));
+	if (tmpList == NULL){
+		return NULL;
+	}
+
+	tmpList->head = NULL;
+	tmpList->tail = NULL;
+	tmpList->length = 0;
+
+	tmpList->deleteData = deleteFunction;
+	tmpList->compare = compareFunction;
+	tmpList->printData = printFunction;
+
+	tmpList->header = (SkipNode*)(tmpList + 1);
+	tmpList->header->node.data = NULL;
+	tmpList->header->node.previous = NULL;
+	tmpList->header->node.next = NULL;
+	tmpList->header->height = ORDERED_LIST_MAX_LEVEL;
+
+	tmpList->level = 1;
+	tmpList->seed = 2463534242u;
+
+	return tmpList;
+}
+
+void freeOrderedList(OrderedList* list){
+	if (list == NULL){
+		return;
+	}
+
+	clearOrderedList(list);
+	free(list);
+}
+
+void clearOrderedList(OrderedList* list){
+	if (list == NULL){
+		return;
+	}
+
+	Node* node = list->head;
+	while (node != NULL){
+		Node* next = node->next;
+
+		list->deleteData(node->data);
+		free(node);
+
+		node = next;
+	}
+
+	list->head = NULL;
+	list->tail = NULL;
+	list->length = 0;
+
+	list->header->node.next = NULL;
+	list->level = 1;
+}
+
+void insertOrdered(OrderedList* list, void* toBeAdded){
+	if (list == NULL || toBeAdded == NULL){
+		return;
+	}
+
+	SkipNode* update[ORDERED_LIST_MAX_LEVEL];
+	int rank[ORDERED_LIST_MAX_LEVEL];
+	int position = findPredecessors(list, toBeAdded, update, rank) + 1;
+
+	int height = randomHeight(list);
+	SkipNode* newNode = malloc(sizeof(SkipNode) + (size_t)(height - 1) * sizeof(SkipLink));
+	if (newNode == NULL){
+		return;
+	}
+
+	for (int i = list->level; i < height; i++){
+		update[i] = list->header;
+		rank[i] = 0;
+		list->header->links[i - 1].next = NULL;
+		list->header->links[i - 1].width = list->length + 1;
+	}
+	if (height > list->level){
+		list->level = height;
+	}
+
+	newNode->height = height;
+	newNode->node.data = toBeAdded;
+
+	//Bottom level: an ordinary doubly linked list with no node before head
+	Node* prev = (update[0] == list->header) ? NULL : &update[0]->node;
+	Node* next = update[0]->node.next;
+
+	newNode->node.previous = prev;
+	newNode->node.next = next;
+	update[0]->node.next = &newNode->node;
+
+	if (next != NULL){
+		next->previous = &newNode->node;
+	}else{
+		list->tail = &newNode->node;
+	}
+	if (prev == NULL){
+		list->head = &newNode->node;
+	}
+
+	for (int i = 1; i < height; i++){
+		SkipLink* link = &update[i]->links[i - 1];
+
+		newNode->links[i - 1].next = link->next;
+		newNode->links[i - 1].width = link->width - (position - rank[i]) + 1;
+
+		link->next = newNode;
+		link->width = position - rank[i];
+	}
+
+	for (int i = height; i < list->level; i++){
+		update[i]->links[i - 1].width++;
+	}
+
+	(list->length)++;
+}
+
+void* deleteDataFromOrdered(OrderedList* list, void* toBeDeleted){
+	if (list == NULL || toBeDeleted == NULL){
+		return NULL;
+	}
+
+	SkipNode* update[ORDERED_LIST_MAX_LEVEL];
+	findPredecessors(list, toBeDeleted, update, NULL);
+
+	SkipNode* node = nextAt(update[0], 0);
+	if (node == NULL || list->compare(toBeDeleted, node->node.data) != 0){
+		return NULL;
+	}
+
+	void* data = node->node.data;
+	unlinkNode(list, node, update);
+
+	return data;
+}
+
+void* removeFromOrdered(OrderedList* list, const void* data){
+	if (list == NULL || data == NULL){
+		return NULL;
+	}
+
+	SkipNode* update[ORDERED_LIST_MAX_LEVEL];
+	findPredecessors(list, data, update, NULL);
+
+	//data is somewhere in the run of elements equal to it; the nodes passed become the predecessors
+	SkipNode* node = nextAt(update[0], 0);
+	while (node != NULL && node->node.data != data){
+		if (list->compare(data, node->node.data) != 0){
+			return NULL;
+		}
+
+		for (int i = 0; i < node->height; i++){
+			update[i] = node;
+		}
+		node = nextAt(node, 0);
+	}
+
+	if (node == NULL){
+		return NULL;
+	}
+
+	unlinkNode(list, node, update);
+
+	return (void*)data;
+}
+
+void* findOrdered(OrderedList* list, const void* searchRecord){
+	if (list == NULL || searchRecord == NULL){
+		return NULL;
+	}
+
+	SkipNode* update[ORDERED_LIST_MAX_LEVEL];
+	findPredecessors(list, searchRecord, update, NULL);
+
+	SkipNode* node = nextAt(update[0], 0);
+	if (node == NULL || list->compare(searchRecord, node->node.data) != 0){
+		return NULL;
+	}
+
+	return node->node.data;
+}
+
+void* getOrderedAt(OrderedList* list, int index){
+	if (list == NULL){
+		return NULL;
+	}
+
+	SkipNode* node = nodeAt(list, index);
+
+	return (node != NULL) ? node->node.data : NULL;
+}
+
+int orderedRank(OrderedList* list, const void* searchRecord){
+	if (list == NULL || searchRecord == NULL){
+		return 0;
+	}
+
+	SkipNode* update[ORDERED_LIST_MAX_LEVEL];
+
+	return findPredecessors(list, searchRecord, update, NULL);
+}
+
+void* getOrderedFront(OrderedList* list){
+	if (list == NULL || list->head == NULL){
+		return NULL;
+	}
+
+	return list->head->data;
+}
+
+void* getOrderedBack(OrderedList* list){
+	if (list == NULL || list->tail == NULL){
+		return NULL;
+	}
+
+	return list->tail->data;
+}
+
+int getOrderedLength(OrderedList* list){
+	return list->length;
+}
+
+char* orderedToString(OrderedList* list){
+	List view = bottomList(list);
+
+	return toString(&view);
+}
+
+ListIterator createOrderedIterator(OrderedList* list){
+	List view = bottomList(list);
+
+	return createIterator(&view);
+}
+
+ListIterator orderedIteratorFrom(OrderedList* list, const void* searchRecord){
+	SkipNode* update[ORDERED_LIST_MAX_LEVEL];
+	findPredecessors(list, searchRecord, update, NULL);
+
+	ListIterator iter = createOrderedIterator(list);
+	iter.current = update[0]->node.next;
+
+	return iter;
+}
+
+ListIterator orderedIteratorAt(OrderedList* list, int index){
+	ListIterator iter = createOrderedIterator(list);
+
+	if (index > 0){
+		SkipNode* node = nodeAt(list, index);
+		iter.current = (node != NULL) ? &node->node : NULL;
+	}
+
+	return iter;
+}
@@ -1,50 +1,2417 @@
+#define _DEFAULT_SOURCE
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "LinkedListAPI.h"
+#include "OrderedListAPI.h"
 #include "VCParser.h"
 #include "VCHelpers.h"
 #include "VCValidate.h"
 #include "VCAPIHelpers.h"
+#include "VCStream.h"
+#include "VCBuffer.h"
+#include "VCPush.h"
+#include "VCBinary.h"
+#include "VCIndex.h"
+#include "VCDates.h"
+#include "VCSearch.h"
+#include "VCStore.h"
+#include "VCDedup.h"
+#include "VCHash.h"
+#include "VCWriter.h"
+#include "VCWatch.h"
+#include "VCScan.h"
+#include "VCLoader.h"
+#include "VCIntern.h"
+#include "VCKind.h"
 
-// testFiles/invCard/testCard .vcf
-// testFiles/invProp/testCard .vcf
-// testFiles/valid/testCard .vcf
+/*  Behaviour tests for the parser library. Each test checks results against fixed
+    expectations or against a brute force version of the same computation, and
+    prints the failed checks. Run from ContactMS with make test.
+*/
 
-int main(void)
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(cond) \
+    do \
+    { \
+        checks++; \
+        if (!(cond)) \
+        { \
+            failures++; \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+//Fixture files are written here, and removed at the end
+static char tempDir[] = "/tmp/vcUnitTestsXXXXXX";
+
+static char* writeFixture(const char* name, const char* text)
+{
+    char* path = (char*)malloc(strlen(tempDir) + strlen(name) + 2);
+    sprintf(path, "%s/%s", tempDir, name);
+
+    FILE* fptr = fopen(path, "wb");
+    if (fptr != NULL)
+    {
+        fputs(text, fptr);
+        fclose(fptr);
+    }
+
+    return path;
+}
+
+static void removeFixtures(void)
+{
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", tempDir);
+    if (system(cmd) != 0) printf("could not remove %s\n", tempDir);
+}
+
+//Same sequence on every run, so a failure can be reproduced
+static uint32_t randomState = 12345;
+
+static uint32_t nextRandom(void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static int randomBelow(int n)
+{
+    return (int)(nextRandom() % (uint32_t)n);
+}
+
+// ************* Card fixtures ***************
+
+//Cards and the results of createCard, cardToString and validateCard in the baseline parser
+typedef struct cardFixture {
+    const char*     name;
+    const char*     text;
+    VCardErrorCode  err;
+    const char*     summary;
+    VCardErrorCode  valid;
+} CardFixture;
+
+static const CardFixture fixtures[] = {
+    {"baddt.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\nBDAY:\r\nEND:VCARD\r\n", INV_PROP, NULL, OK},
+    {"badparam.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\nTEL;TYPE:123\r\nEND:VCARD\r\n", INV_PROP, NULL, OK},
+    {"badprop.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\nBADPROP\r\nEND:VCARD\r\n", INV_PROP, NULL, OK},
+    {"badprop2.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nBADPROP\r\nFN:Jane\r\nEND:VCARD\r\n", INV_PROP, NULL, OK},
+    {"empty.vcf", "", INV_CARD, NULL, OK},
+    {"fold.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\n Doe\r\nBDAY:19540203T123012Z\r\nEND:VCARD\r\n",
+        OK, "FN:JaneDoeBDAY:19540203T123012Z", OK},
+    {"full.vcf",
+        "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Simon Perreault\r\nN:Perreault;Simon;;;ing. jr,M.Sc.\r\n"
+        "BDAY:--0203\r\nANNIVERSARY:20090808T1430-0500\r\nGENDER:M\r\nLANG;PREF=1:fr\r\nLANG;PREF=2:en\r\n"
+        "ORG;TYPE=work:Viagenie\r\nADR;TYPE=work:;Suite D2-630;2875 Laurier;\r\n Quebec;QC;G1V 2M2;Canada\r\n"
+        "TEL;VALUE=uri;TYPE=\"work,voice\";PREF=1:tel:+1-418-656-9254;ext=102\r\n"
+        "TEL;VALUE=uri;TYPE=\"work,cell,voice,video,text\":tel:+1-418-262-6501\r\n"
+        "EMAIL;TYPE=work:simon.perreault@viagenie.ca\r\nitem1.GEO;TYPE=work:geo:46.772673,-71.282945\r\n"
+        "KEY;TYPE=work;VALUE=uri:\r\n http://www.viagenie.ca/simon.perreault/simon.asc\r\nTZ:-0500\r\n"
+        "URL;TYPE=home:http://nomis80.org\r\nEND:VCARD\r\n",
+        OK,
+        "FN:Simon PerreaultN:Perreault;Simon;;;ing. jr,M.Sc.GENDER:MLANG;PREF=1:frLANG;PREF=2:en"
+        "ORG;TYPE=work:ViagenieADR;TYPE=work:;Suite D2-630;2875 Laurier;Quebec;QC;G1V 2M2;Canada"
+        "TEL;VALUE=uri;TYPE=\"work,voice\";PREF=1:tel:+1-418-656-9254;ext=102"
+        "TEL;VALUE=uri;TYPE=\"work,cell,voice,video,text\":tel:+1-418-262-6501"
+        "EMAIL;TYPE=work:simon.perreault@viagenie.caitem1.GEO;TYPE=work:geo:46.772673,-71.282945"
+        "KEY;TYPE=work;VALUE=uri:http://www.viagenie.ca/simon.perreault/simon.ascTZ:-0500"
+        "URL;TYPE=home:http://nomis80.orgBDAY:--0203ANNIVERSARY:20090808T1430-0500",
+        OK},
+    {"lf.vcf", "BEGIN:VCARD\nVERSION:4.0\nFN:Unix\nEMAIL:a@b.c\nEND:VCARD\n", OK, "FN:UnixEMAIL:a@b.c", OK},
+    {"nobegin.vcf", "VERSION:4.0\r\nFN:Jane\r\nEND:VCARD\r\n", INV_CARD, NULL, OK},
+    {"noend.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\n", INV_CARD, NULL, OK},
+    {"nofn.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nN:x;y\r\nEND:VCARD\r\n", INV_PROP, NULL, OK},
+    {"trail.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\nEND:VCARD\r\nX:1\r\n", INV_CARD, NULL, OK},
+    //The baseline rejected a CRLF blank line after END:VCARD but accepted an LF one; both are accepted now
+    {"trailblank.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\nBDAY:circa 1800\r\nEND:VCARD\r\n\r\n",
+        OK, "FN:JaneBDAY:circa 1800", OK},
+    {"twoN.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\nN:a;b;;;\r\nN:c;d;;;\r\nEND:VCARD\r\n",
+        OK, "FN:JaneN:a;b;;N:c;d;;", INV_PROP},
+    {"twofn.vcf", "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\nFN:Second\r\nNOTE:hello;world\r\nEND:VCARD\r\n",
+        OK, "FN:JaneNOTE:hello;world", OK},
+    {"ver.vcf", "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Jane\r\nEND:VCARD\r\n", INV_CARD, NULL, OK},
+    {"lower.vcf", "begin:vcard\r\nversion:4.0\r\nfn:Low\r\nend:vcard\r\n", OK, "fn:Low", OK},
+};
+
+#define FIXTURE_COUNT ((int)(sizeof(fixtures) / sizeof(fixtures[0])))
+
+static const CardFixture* findFixture(const char* name)
+{
+    for (int i = 0; i < FIXTURE_COUNT; i++)
+    {
+        if (strcmp(fixtures[i].name, name) == 0) return &fixtures[i];
+    }
+
+    return NULL;
+}
+
+//Checks a card against what its fixture expects; card may be NULL on error
+static void checkFixtureCard(const CardFixture* fixture, VCardErrorCode err, Card* card)
+{
+    CHECK(err == fixture->err);
+    if (err != fixture->err)
+    {
+        printf("  %s: got %d, expected %d\n", fixture->name, err, fixture->err);
+    }
+
+    if (err != OK)
+    {
+        CHECK(card == NULL);
+        return;
+    }
+
+    CHECK(card != NULL);
+    if (card == NULL) return;
+
+    char* summary = cardToString(card);
+    CHECK(summary != NULL && strcmp(summary, fixture->summary) == 0);
+    free(summary);
+
+    CHECK(validateCard(card) == fixture->valid);
+}
+
+// ************* Parsers ***************
+
+static void testCreateCard(void)
+{
+    for (int i = 0; i < FIXTURE_COUNT; i++)
+    {
+        char* path = writeFixture(fixtures[i].name, fixtures[i].text);
+        Card* card = NULL;
+
+        VCardErrorCode err = createCard(path, &card);
+        checkFixtureCard(&fixtures[i], err, card);
+        deleteCard(card);
+
+        card = NULL;
+        err = createCardInArena(path, &card);
+        checkFixtureCard(&fixtures[i], err, card);
+        deleteCard(card);
+
+        card = NULL;
+        err = createCardFromMappedFile(path, &card);
+        checkFixtureCard(&fixtures[i], err, card);
+        deleteCard(card);
+
+        card = NULL;
+        err = createCardFromBuffer(fixtures[i].text, strlen(fixtures[i].text), &card);
+        checkFixtureCard(&fixtures[i], err, card);
+        deleteCard(card);
+
+        free(path);
+    }
+
+    Card* card = NULL;
+    char* path = writeFixture("notvcf.txt", findFixture("full.vcf")->text);
+    CHECK(createCard(path, &card) == INV_FILE && card == NULL);
+    CHECK(createCard(NULL, &card) == INV_FILE);
+    free(path);
+}
+
+static void testCardStream(void)
+{
+    //Good, bad property, missing END, folded, lower case after a bad card, good
+    const char* text =
+        "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:One\r\nEND:VCARD\r\n"
+        "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Two\r\nBADPROP\r\nEND:VCARD\r\n"
+        "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Three\r\n"
+        "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Four\r\n Folded\r\nEND:VCARD\r\n"
+        "\r\n"
+        "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Old\r\nEND:VCARD\r\n"
+        "begin:vcard\r\nVERSION:4.0\r\nFN:Lower\r\nend:vcard\r\n"
+        "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Five\r\nEND:VCARD\r\n";
+
+    const VCardErrorCode expectedErr[] = {OK, INV_PROP, INV_CARD, OK, INV_CARD, OK, OK};
+    const char* expectedFn[] = {"FN:One", NULL, NULL, "FN:FourFolded", NULL, "FN:Lower", "FN:Five"};
+
+    char* path = writeFixture("stream.vcf", text);
+    CardStream* stream = NULL;
+    CHECK(openCardStream(path, &stream) == OK);
+    free(path);
+    if (stream == NULL) return;
+
+    for (int i = 0; i < 7; i++)
+    {
+        Card* card = NULL;
+        VCardErrorCode err = nextCard(stream, &card);
+
+        CHECK(err == expectedErr[i]);
+        CHECK((card != NULL) == (expectedFn[i] != NULL));
+
+        if (card != NULL && expectedFn[i] != NULL)
+        {
+            char* summary = cardToString(card);
+            CHECK(strcmp(summary, expectedFn[i]) == 0);
+            free(summary);
+        }
+        deleteCard(card);
+    }
+
+    Card* card = NULL;
+    CHECK(nextCard(stream, &card) == OK && card == NULL);
+    closeCardStream(stream);
+}
+
+//What a push parser reported, as one string to compare
+typedef struct pushLog {
+    char    text[4096];
+    int     cards;
+} PushLog;
+
+static void logCard(Card* card, VCardErrorCode err, void* userData)
+{
+    PushLog* log = (PushLog*)userData;
+    size_t used = strlen(log->text);
+
+    if (card == NULL)
+    {
+        snprintf(log->text + used, sizeof(log->text) - used, "[err %d]", err);
+    }
+    else
+    {
+        char* summary = cardToString(card);
+        snprintf(log->text + used, sizeof(log->text) - used, "[%s]", summary);
+        free(summary);
+        deleteCard(card);
+    }
+
+    log->cards++;
+}
+
+static const char* pushInput =
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\n Doe\r\nBDAY:19540203T123012Z\r\nEND:VCARD\r\n"
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Bad\r\nBADPROP\r\nEND:VCARD\r\n"
+    "junk between cards\r\n"
+    "BEGIN:VCARD\nVERSION:4.0\nFN:Unix\nEMAIL:a@b.c\nEND:VCARD\n"
+    "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Last\r\nNOTE:no newline at the end\r\nEND:VCARD";
+
+static void pushAll(const char* text, size_t len, const size_t* splits, int splitCount, PushLog* log)
 {
-    char * filename = "./bin/cards/juneTest1.vcf";
-    Card * obj;
+    memset(log, 0, sizeof(PushLog));
+
+    VCardParser* parser = vcardParserNew(logCard, log);
+    size_t start = 0;
+
+    for (int i = 0; i <= splitCount; i++)
+    {
+        size_t end = (i < splitCount) ? splits[i] : len;
+        CHECK(vcardParserFeed(parser, text + start, end - start) == OK);
+        start = end;
+    }
+
+    CHECK(vcardParserFinish(parser) == OK);
+}
+
+static void testPushParser(void)
+{
+    size_t len = strlen(pushInput);
+
+    PushLog whole;
+    pushAll(pushInput, len, NULL, 0, &whole);
+    CHECK(whole.cards == 4);
+    CHECK(strcmp(whole.text, "[FN:JaneDoeBDAY:19540203T123012Z][err 3][FN:UnixEMAIL:a@b.c][FN:LastNOTE:no newline at the end]") == 0);
+
+    //Split in two at every offset, then at every pair of offsets a few bytes apart
+    PushLog split;
+    for (size_t i = 0; i <= len; i++)
+    {
+        size_t splits[1] = {i};
+        pushAll(pushInput, len, splits, 1, &split);
+        CHECK(strcmp(split.text, whole.text) == 0);
+    }
+
+    for (size_t i = 0; i + 3 <= len; i++)
+    {
+        size_t splits[2] = {i, i + 1 + i % 3};
+        pushAll(pushInput, len, splits, 2, &split);
+        CHECK(strcmp(split.text, whole.text) == 0);
+    }
+
+    //One byte at a time
+    size_t* bytes = (size_t*)malloc(len * sizeof(size_t));
+    for (size_t i = 0; i < len; i++) bytes[i] = i;
+    pushAll(pushInput, len, bytes, (int)len, &split);
+    CHECK(strcmp(split.text, whole.text) == 0);
+    free(bytes);
+}
+
+//Cards are reported when END:VCARD arrives, without waiting for more input
+static void testPushParserLatency(void)
+{
+    PushLog log;
+    memset(&log, 0, sizeof(log));
+    VCardParser* parser = vcardParserNew(logCard, &log);
+
+    const char* card = "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\n Doe\r\nEND:VCARD\r\n";
+    CHECK(vcardParserFeed(parser, card, strlen(card)) == OK);
+    CHECK(log.cards == 1);
+
+    //Without the line end, and with END folded, lower case and a bad card before it
+    const char* bad = "BEGIN:VCARD\r\nVERSION:4.0\r\nBADPROP\r\nFN:Bad\r\nEND:VCARD\r\n";
+    CHECK(vcardParserFeed(parser, bad, strlen(bad)) == OK);
+    CHECK(log.cards == 2);
+
+    const char* lower = "begin:vcard\nversion:4.0\nfn:Low\nEN\n D:VCARD";
+    CHECK(vcardParserFeed(parser, lower, strlen(lower)) == OK);
+    CHECK(log.cards == 2);
+    CHECK(vcardParserFeed(parser, "\n", 1) == OK);
+    CHECK(log.cards == 3);
+
+    //A fold of an END:VCARD already reported changes nothing
+    const char* fold = " more\r\n";
+    CHECK(vcardParserFeed(parser, fold, strlen(fold)) == OK);
+
+    CHECK(vcardParserFinish(parser) == OK);
+    CHECK(log.cards == 3);
+    CHECK(strcmp(log.text, "[FN:JaneDoe][err 3][fn:Low]") == 0);
+}
+
+// ************* Delimiter scan ***************
+
+static void testDelimiterScan(void)
+{
+    static const char alphabet[] = ":;.=\"abcXYZ019 \\,\t\x80\xff";
+    char buf[300];
+    uint32_t fast[300];
+    uint32_t slow[300];
+
+    //Random lines at every alignment, mostly delimiters, across the 16 and 32 byte block edges
+    for (int round = 0; round < 200000; round++)
+    {
+        size_t offset = (size_t)randomBelow(32);
+        size_t len = (size_t)randomBelow(200);
+        for (size_t i = 0; i < len; i++) buf[offset + i] = alphabet[randomBelow((int)sizeof(alphabet) - 1)];
+
+        size_t capacity = (round % 8 == 0) ? (size_t)randomBelow(8) : sizeof(fast) / sizeof(fast[0]);
+        size_t fastCount = scanDelimiters(buf + offset, len, fast, capacity);
+        size_t slowCount = scanDelimitersScalar(buf + offset, len, slow, capacity);
+
+        CHECK(fastCount == slowCount);
+        size_t written = (fastCount < capacity) ? fastCount : capacity;
+        if (fastCount == slowCount) CHECK(memcmp(fast, slow, written * sizeof(uint32_t)) == 0);
+    }
+
+    //A line with more delimiters than fit inline spills to the heap
+    char line[1000];
+    for (int i = 0; i < 999; i++) line[i] = (i % 3 == 0) ? ';' : 'x';
+    line[999] = '\0';
+
+    DelimiterScan scan;
+    CHECK(scanLine(&scan, line, 999));
+    CHECK(scan.count == 333);
+    bool inOrder = true;
+    for (size_t i = 0; i < scan.count; i++)
+    {
+        if (scan.positions[i] != i * 3) inOrder = false;
+    }
+    CHECK(inOrder);
+    freeScan(&scan);
+}
+
+// ************* Binary format ***************
+
+static void testBinaryRoundTrip(void)
+{
+    for (int i = 0; i < FIXTURE_COUNT; i++)
+    {
+        if (fixtures[i].err != OK) continue;
+
+        Card* card = NULL;
+        CHECK(createCardFromBuffer(fixtures[i].text, strlen(fixtures[i].text), &card) == OK);
+        if (card == NULL) continue;
+
+        void* data = NULL;
+        size_t len = 0;
+        CHECK(encodeCardBinary(card, &data, &len) == OK);
+
+        Card* copy = NULL;
+        CHECK(readCardBinaryFromBuffer(data, len, &copy) == OK);
+
+        if (copy != NULL)
+        {
+            char* before = cardToString(card);
+            char* after = cardToString(copy);
+            CHECK(strcmp(before, after) == 0);
+            CHECK(validateCard(copy) == fixtures[i].valid);
+            free(before);
+            free(after);
+            deleteCard(copy);
+        }
+
+        //Every truncation is rejected
+        for (size_t cut = 0; cut < len; cut++)
+        {
+            Card* bad = NULL;
+            CHECK(readCardBinaryFromBuffer(data, cut, &bad) != OK && bad == NULL);
+        }
+
+        //And a file written by writeCardBinary reads back the same
+        char* path = writeFixture("card.bin", "");
+        CHECK(writeCardBinary(path, card) == OK);
+        Card* fromFile = NULL;
+        CHECK(readCardBinary(path, &fromFile) == OK);
+        if (fromFile != NULL)
+        {
+            char* before = cardToString(card);
+            char* after = cardToString(fromFile);
+            CHECK(strcmp(before, after) == 0);
+            free(before);
+            free(after);
+            deleteCard(fromFile);
+        }
+        free(path);
+
+        free(data);
+        deleteCard(card);
+    }
+}
+
+// ************* Loader ***************
+
+//What the loader reports for a fixture: the createCard error, or else the validateCard result
+static VCardErrorCode loadResult(const CardFixture* fixture)
+{
+    return (fixture->err != OK) ? fixture->err : fixture->valid;
+}
+
+//Checks one loaded file against its fixture, and its contact against getContact
+static void checkLoadedCard(const CardFixture* fixture, const char* fileName, VCardErrorCode err, Card* card, const Contact* contact)
+{
+    CHECK(err == loadResult(fixture));
+    CHECK((card == NULL) == (err != OK));
+    if (card == NULL || err != OK) return;
+
+    char* summary = cardToString(card);
+    CHECK(strcmp(summary, fixture->summary) == 0);
+    free(summary);
+
+    Contact expected = getContact((char*)fileName, card);
+    CHECK(strcmp(contact->file_name, fileName) == 0);
+    CHECK(strcmp(contact->name, expected.name) == 0);
+    CHECK(strcmp(contact->birthday, expected.birthday) == 0);
+    CHECK(strcmp(contact->anniversary, expected.anniversary) == 0);
+    CHECK(contact->prop_count == expected.prop_count);
+}
+
+//A directory holding every fixture, a .vcard copy of full.vcf and a file that is not a card
+static char* writeCardDirectory(const char* name)
+{
+    char* dir = writeFixture(name, "");
+    unlink(dir);
+    if (mkdir(dir, 0700) != 0) return dir;
+
+    char path[512];
+    for (int i = 0; i < FIXTURE_COUNT; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", name, fixtures[i].name);
+        free(writeFixture(path, fixtures[i].text));
+    }
+
+    snprintf(path, sizeof(path), "%s/extra.vcard", name);
+    free(writeFixture(path, findFixture("full.vcf")->text));
+    snprintf(path, sizeof(path), "%s/notes.txt", name);
+    free(writeFixture(path, findFixture("full.vcf")->text));
+
+    return dir;
+}
+
+static void testLoadCardDirectory(void)
+{
+    char* dirName = writeCardDirectory("loaded");
+
+    for (int threads = 1; threads <= 4; threads += 3)
+    {
+        CardDirectory* dir = NULL;
+        CHECK(loadCardDirectory(dirName, threads, &dir) == OK);
+        if (dir == NULL) continue;
+
+        //Every card file but not notes.txt, sorted by name whatever the thread count
+        CHECK(dir->count == FIXTURE_COUNT + 1);
+        for (int i = 1; i < dir->count; i++) CHECK(strcmp(dir->fileNames[i - 1], dir->fileNames[i]) < 0);
+
+        for (int i = 0; i < dir->count; i++)
+        {
+            const CardFixture* fixture = findFixture(dir->fileNames[i]);
+            if (strcmp(dir->fileNames[i], "extra.vcard") == 0) fixture = findFixture("full.vcf");
+
+            CHECK(fixture != NULL);
+            if (fixture == NULL) continue;
+
+            checkLoadedCard(fixture, dir->fileNames[i], dir->errors[i], dir->cards[i], &dir->contacts[i]);
+        }
+
+        freeCardDirectory(dir, true);
+    }
+
+    //An empty directory loads nothing, a missing one is an error
+    char* empty = writeFixture("empty", "");
+    unlink(empty);
+    CHECK(mkdir(empty, 0700) == 0);
+
+    CardDirectory* dir = NULL;
+    CHECK(loadCardDirectory(empty, 0, &dir) == OK && dir != NULL && dir->count == 0);
+    freeCardDirectory(dir, true);
+
+    CHECK(rmdir(empty) == 0);
+    dir = NULL;
+    CHECK(loadCardDirectory(empty, 0, &dir) == INV_FILE && dir == NULL);
+    CHECK(loadCardDirectory(NULL, 0, &dir) == INV_FILE && dir == NULL);
+
+    freeCardDirectory(NULL, true);
+    free(empty);
+    free(dirName);
+}
+
+static void testLoadCardBatch(void)
+{
+    char* dirName = writeCardDirectory("batch");
+
+    //Every fixture, then a file that does not exist
+    int count = FIXTURE_COUNT + 1;
+    char** paths = (char**)malloc(count * sizeof(char*));
+    for (int i = 0; i < count; i++)
+    {
+        const char* name = (i < FIXTURE_COUNT) ? fixtures[i].name : "missing.vcf";
+        paths[i] = (char*)malloc(strlen(dirName) + strlen(name) + 2);
+        sprintf(paths[i], "%s/%s", dirName, name);
+    }
+
+    Card** cards = (Card**)malloc(count * sizeof(Card*));
+    VCardErrorCode* errors = (VCardErrorCode*)malloc(count * sizeof(VCardErrorCode));
+    Contact* contacts = (Contact*)malloc(count * sizeof(Contact));
+
+    int good = 0;
+    for (int i = 0; i < FIXTURE_COUNT; i++)
+    {
+        if (loadResult(&fixtures[i]) == OK) good++;
+    }
+
+    for (int threads = 1; threads <= 3; threads += 2)
+    {
+        CHECK(loadCardBatch(paths, count, threads, cards, errors, contacts) == good);
+
+        //Results are in the order of the paths, contacts named after the part past the last '/'
+        for (int i = 0; i < FIXTURE_COUNT; i++)
+        {
+            checkLoadedCard(&fixtures[i], fixtures[i].name, errors[i], cards[i], &contacts[i]);
+            deleteCard(cards[i]);
+        }
+
+        CHECK(errors[FIXTURE_COUNT] == INV_FILE && cards[FIXTURE_COUNT] == NULL);
+        CHECK(contacts[FIXTURE_COUNT].file_name[0] == '\0' && contacts[FIXTURE_COUNT].prop_count == 0);
+    }
+
+    CHECK(loadCardBatch(paths, 0, 1, cards, errors, contacts) == 0);
+    CHECK(loadCardBatch(NULL, count, 1, cards, errors, contacts) == 0);
+
+    for (int i = 0; i < count; i++) free(paths[i]);
+    free(paths);
+    free(cards);
+    free(errors);
+    free(contacts);
+    free(dirName);
+}
+
+#define VALIDATED_CARDS 300
+
+static void testValidateCards(void)
+{
+    //Every fixture that parses, over and over, with a NULL now and then
+    Card* parsed[FIXTURE_COUNT];
+    int parsedCount = 0;
+    for (int i = 0; i < FIXTURE_COUNT; i++)
+    {
+        Card* card = NULL;
+        if (createCardFromBuffer(fixtures[i].text, strlen(fixtures[i].text), &card) == OK) parsed[parsedCount++] = card;
+    }
+    CHECK(parsedCount > 1);
+
+    Card* cards[VALIDATED_CARDS];
+    VCardErrorCode expected[VALIDATED_CARDS];
+    bool invalid = false;
+    for (int i = 0; i < VALIDATED_CARDS; i++)
+    {
+        cards[i] = (i % 7 == 3) ? NULL : parsed[i % parsedCount];
+        expected[i] = validateCard(cards[i]);
+        if (expected[i] != OK && cards[i] != NULL) invalid = true;
+    }
+    CHECK(expected[3] == INV_CARD && invalid);
+
+    //Same results as validateCard, in order, whatever the thread count
+    static const int threadCounts[] = {1, 3, 0, 64};
+    for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++)
+    {
+        VCardErrorCode out[VALIDATED_CARDS];
+        for (int i = 0; i < VALIDATED_CARDS; i++) out[i] = (VCardErrorCode)-1;
+
+        validateCards(cards, VALIDATED_CARDS, out, threadCounts[t]);
+        CHECK(memcmp(out, expected, sizeof(out)) == 0);
+    }
+
+    //Nothing to do leaves out alone
+    VCardErrorCode untouched = (VCardErrorCode)-1;
+    validateCards(cards, 0, &untouched, 2);
+    validateCards(NULL, 1, &untouched, 2);
+    CHECK(untouched == (VCardErrorCode)-1);
+    validateCards(cards, 1, NULL, 2);
+
+    for (int i = 0; i < parsedCount; i++) deleteCard(parsed[i]);
+}
+
+// ************* Card cache ***************
+
+static void setMtime(const char* path, time_t sec, long nsec)
+{
+    struct timespec times[2] = {{sec, nsec}, {sec, nsec}};
+    CHECK(utimensat(AT_FDCWD, path, times, 0) == 0);
+}
+
+static void writeBytes(const char* path, const unsigned char* data, size_t len)
+{
+    FILE* file = fopen(path, "wb");
+    CHECK(file != NULL);
+    if (file == NULL) return;
+
+    CHECK(fwrite(data, 1, len, file) == len);
+    fclose(file);
+}
+
+/*  Loads count paths through the cache in cacheFile, checks every result against its
+    fixture and returns the hits and misses. Saves the cache afterwards if save is set.
+*/
+static void loadCached(const char* cacheFile, char** paths, const CardFixture** expected, int count, bool save, long* hits, long* misses)
+{
+    (*hits) = -1;
+    (*misses) = -1;
+
+    CardCache* cache = NULL;
+    CHECK(openCardCache(cacheFile, &cache) == OK);
+    if (cache == NULL) return;
+
+    Card** cards = (Card**)malloc(count * sizeof(Card*));
+    VCardErrorCode* errors = (VCardErrorCode*)malloc(count * sizeof(VCardErrorCode));
+    Contact* contacts = (Contact*)malloc(count * sizeof(Contact));
+
+    loadCardBatchCached(cache, paths, count, 2, cards, errors, contacts);
+    for (int i = 0; i < count; i++)
+    {
+        checkLoadedCard(expected[i], strrchr(paths[i], '/') + 1, errors[i], cards[i], &contacts[i]);
+        deleteCard(cards[i]);
+    }
+
+    cardCacheStats(cache, hits, misses);
+    if (save) CHECK(saveCardCache(cache) == OK);
+    closeCardCache(cache);
+
+    free(cards);
+    free(errors);
+    free(contacts);
+}
+
+static void testCardCache(void)
+{
+    char* dirName = writeCardDirectory("cached");
+    char* cacheFile = writeFixture("cards.cache", "");
+    unlink(cacheFile);
+
+    //Every fixture, last changed well before CACHE_RACY_SECONDS ago
+    time_t old = time(NULL) - 100;
+    int count = FIXTURE_COUNT;
+    char** paths = (char**)malloc(count * sizeof(char*));
+    const CardFixture** expected = (const CardFixture**)malloc(count * sizeof(CardFixture*));
+    for (int i = 0; i < count; i++)
+    {
+        paths[i] = (char*)malloc(strlen(dirName) + strlen(fixtures[i].name) + 2);
+        sprintf(paths[i], "%s/%s", dirName, fixtures[i].name);
+        setMtime(paths[i], old, 0);
+        expected[i] = &fixtures[i];
+    }
+
+    //A missing cache file is an empty cache, then everything is a hit, errors included
+    long hits;
+    long misses;
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == 0 && misses == count);
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == count && misses == 0);
+
+    //Stale entries: another size, another mtime nanosecond, another inode
+    int resized = (int)(findFixture("fold.vcf") - fixtures);
+    free(writeFixture("cached/fold.vcf", findFixture("full.vcf")->text));
+    setMtime(paths[resized], old, 0);
+    expected[resized] = findFixture("full.vcf");
+
+    //A second later where the file system keeps no nanoseconds
+    int touched = (int)(findFixture("lf.vcf") - fixtures);
+    struct stat info;
+    setMtime(paths[touched], old, 1);
+    if (stat(paths[touched], &info) == 0 && info.st_mtim.tv_nsec != 1) setMtime(paths[touched], old + 1, 0);
+
+    int replaced = (int)(findFixture("lower.vcf") - fixtures);
+    char* copy = writeFixture("cached/lower.tmp", fixtures[replaced].text);
+    setMtime(copy, old, 0);
+    CHECK(rename(copy, paths[replaced]) == 0);
+    free(copy);
+
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == count - 3 && misses == 3);
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == count && misses == 0);
+
+    //A file changed within the same second could change again unseen, so it is not cached
+    int recent = (int)(findFixture("full.vcf") - fixtures);
+    setMtime(paths[recent], time(NULL), 0);
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == count - 1 && misses == 1);
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == count - 1 && misses == 1);
+
+    setMtime(paths[recent], old, 0);
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == count - 1 && misses == 1);
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == count && misses == 0);
+
+    //Saving keeps only the files looked up
+    loadCached(cacheFile, paths, expected, 2, true, &hits, &misses);
+    CHECK(hits == 2 && misses == 0);
+    loadCached(cacheFile, paths, expected, count, true, &hits, &misses);
+    CHECK(hits == 2 && misses == count - 2);
+
+    //A corrupt, truncated or other version cache file is an empty cache
+    unsigned char* saved = NULL;
+    long savedLen = 0;
+    FILE* file = fopen(cacheFile, "rb");
+    CHECK(file != NULL);
+    if (file != NULL)
+    {
+        fseek(file, 0, SEEK_END);
+        savedLen = ftell(file);
+        rewind(file);
+        saved = (unsigned char*)malloc(savedLen);
+        CHECK(savedLen > 20 && fread(saved, 1, savedLen, file) == (size_t)savedLen);
+        fclose(file);
+    }
+
+    for (int damage = 0; saved != NULL && damage < 5; damage++)
+    {
+        unsigned char* bytes = (unsigned char*)malloc(savedLen);
+        memcpy(bytes, saved, savedLen);
+        size_t len = (size_t)savedLen;
+
+        switch (damage)
+        {
+            case 0: bytes[savedLen - 1] ^= 1; break;
+            case 1: bytes[savedLen / 2] ^= 0x40; break;
+            case 2: bytes[4] += 1; break;
+            case 3: bytes[0] = 'X'; break;
+            case 4: len = (size_t)savedLen - 1; break;
+        }
+
+        writeBytes(cacheFile, bytes, len);
+        loadCached(cacheFile, paths, expected, count, false, &hits, &misses);
+        CHECK(hits == 0 && misses == count);
+        free(bytes);
+    }
+
+    if (saved != NULL)
+    {
+        writeBytes(cacheFile, saved, (size_t)savedLen);
+        loadCached(cacheFile, paths, expected, count, false, &hits, &misses);
+        CHECK(hits == count && misses == 0);
+    }
+    free(saved);
+
+    CardCache* cache = NULL;
+    CHECK(openCardCache(NULL, &cache) == OTHER_ERROR && cache == NULL);
+    CHECK(saveCardCache(NULL) == WRITE_ERROR);
+    closeCardCache(NULL);
+
+    for (int i = 0; i < count; i++) free(paths[i]);
+    free(paths);
+    free(expected);
+    free(cacheFile);
+    free(dirName);
+}
+
+// ************* Writer ***************
+
+static void checkCardFile(const char* path, const char* expected)
+{
+    Card* card = NULL;
+    CHECK(createCard((char*)path, &card) == OK);
+    if (card == NULL) return;
+
+    char* text = cardToString(card);
+    CHECK(strcmp(text, expected) == 0);
+    free(text);
+    deleteCard(card);
+}
+
+static void testWriteCard(void)
+{
+    const CardFixture* fixture = findFixture("full.vcf");
+    Card* card = NULL;
+    CHECK(createCardFromBuffer(fixture->text, strlen(fixture->text), &card) == OK);
+    if (card == NULL) return;
+
+    char* expected = cardToString(card);
+
+    //A rewritten card keeps its permissions
+    char* path = writeFixture("private.vcf", "");
+    CHECK(chmod(path, 0600) == 0);
+    CHECK(writeCard(path, card) == OK);
+
+    struct stat info;
+    CHECK(stat(path, &info) == 0 && (info.st_mode & 07777) == 0600);
+    checkCardFile(path, expected);
+
+    CHECK(chmod(path, 0640) == 0);
+    CHECK(writeCardWithFlags(path, card, CARD_WRITE_FSYNC) == OK);
+    CHECK(stat(path, &info) == 0 && (info.st_mode & 07777) == 0640);
+
+    //A symbolic link stays a link, relative or absolute, and its target gets the card
+    char* link = writeFixture("link.vcf", "");
+    unlink(link);
+    CHECK(symlink("private.vcf", link) == 0);
+    CHECK(chmod(path, 0644) == 0);
+    CHECK(writeCard(link, card) == OK);
+    CHECK(lstat(link, &info) == 0 && S_ISLNK(info.st_mode));
+    CHECK(stat(path, &info) == 0 && (info.st_mode & 07777) == 0644);
+    checkCardFile(path, expected);
+
+    char* chain = writeFixture("chain.vcf", "");
+    unlink(chain);
+    CHECK(symlink(link, chain) == 0);
+    CHECK(writeCard(chain, card) == OK);
+    CHECK(lstat(chain, &info) == 0 && S_ISLNK(info.st_mode));
+    CHECK(lstat(link, &info) == 0 && S_ISLNK(info.st_mode));
+    checkCardFile(path, expected);
+
+    //A dangling link is written through, creating its target
+    char* missing = writeFixture("missing.vcf", "");
+    unlink(missing);
+    char* dangling = writeFixture("dangling.vcf", "");
+    unlink(dangling);
+    CHECK(symlink("missing.vcf", dangling) == 0);
+    CHECK(writeCard(dangling, card) == OK);
+    CHECK(lstat(dangling, &info) == 0 && S_ISLNK(info.st_mode));
+    checkCardFile(missing, expected);
+
+    //A loop of links is an error, not a hang
+    char* loop = writeFixture("loop.vcf", "");
+    unlink(loop);
+    CHECK(symlink("loop.vcf", loop) == 0);
+    CHECK(writeCard(loop, card) == WRITE_ERROR);
+
+    free(loop);
+    free(dangling);
+    free(missing);
+    free(chain);
+    free(link);
+    free(path);
+    free(expected);
+    deleteCard(card);
+}
+
+// ************* Intern table ***************
+
+#define INTERN_NAMES 5000
+#define INTERN_THREADS 4
+
+static void internName(char* buf, size_t size, int i)
+{
+    snprintf(buf, size, "X-NAME-%d", i);
+}
+
+//Interns every name and checks it gets the pointer the main thread got
+static void* internNames(void* arg)
+{
+    const char* const* expected = (const char* const*)arg;
+    long mismatches = 0;
+
+    for (int i = INTERN_NAMES - 1; i >= 0; i--)
+    {
+        char name[32];
+        internName(name, sizeof(name), i);
+        if (internString(name, strlen(name)) != expected[i]) mismatches++;
+    }
+
+    return (void*)mismatches;
+}
+
+static void testInternTable(void)
+{
+    //Same bytes, same pointer, wherever the bytes come from
+    const char* tel = internString("TEL", 3);
+    CHECK(tel != NULL && strcmp(tel, "TEL") == 0 && isInterned(tel));
+    CHECK(internString("TELEPHONE", 3) == tel);
+    CHECK(internString("TYPE=work" + 5, 4) == internString("work", 4));
+    CHECK(internString("tel", 3) != tel);
+
+    const char* empty = internString("", 0);
+    CHECK(empty != NULL && empty[0] == '\0' && internString("", 0) == empty);
+
+    //Only short strings are shared
+    char longName[INTERN_MAX_LENGTH + 2];
+    memset(longName, 'A', sizeof(longName) - 1);
+    longName[sizeof(longName) - 1] = '\0';
+    CHECK(internString(longName, INTERN_MAX_LENGTH) != NULL);
+    CHECK(internString(longName, INTERN_MAX_LENGTH + 1) == NULL);
+    CHECK(internString(NULL, 0) == NULL);
+
+    char* copy = strdup("TEL");
+    char local[] = "TEL";
+    CHECK(!isInterned(copy) && !isInterned(local) && !isInterned(NULL));
+
+    CHECK(internEquals(tel, copy) && internEquals(copy, tel) && internEquals(copy, local));
+    CHECK(!internEquals(tel, internString("TELX", 4)));
+    CHECK(!internEquals(copy, "TELX"));
+
+    //Interned strings are left alone, others are freed
+    freeUnlessInterned((char*)tel);
+    CHECK(strcmp(tel, "TEL") == 0);
+    freeUnlessInterned(copy);
+    freeUnlessInterned(NULL);
+
+    //Enough names to grow the table, then the same names from several threads at once
+    const char** names = (const char**)malloc(INTERN_NAMES * sizeof(char*));
+    bool distinct = true;
+    for (int i = 0; i < INTERN_NAMES; i++)
+    {
+        char name[32];
+        internName(name, sizeof(name), i);
+        names[i] = internString(name, strlen(name));
+        if (names[i] == NULL || strcmp(names[i], name) != 0) distinct = false;
+        if (i > 0 && names[i] == names[i - 1]) distinct = false;
+    }
+    CHECK(distinct);
+    CHECK(internString("TEL", 3) == tel);
+
+    pthread_t threads[INTERN_THREADS];
+    int started = 0;
+    for (int t = 0; t < INTERN_THREADS; t++)
+    {
+        if (pthread_create(&threads[started], NULL, &internNames, (void*)names) == 0) started++;
+    }
+    CHECK(started == INTERN_THREADS);
+    for (int t = 0; t < started; t++)
+    {
+        void* mismatches = NULL;
+        pthread_join(threads[t], &mismatches);
+        CHECK(mismatches == NULL);
+    }
+    free(names);
+
+    //Parsed cards share their names, not their values
+    const char* text = findFixture("full.vcf")->text;
+    Card* first = NULL;
+    Card* second = NULL;
+    CHECK(createCardFromBuffer(text, strlen(text), &first) == OK);
+    CHECK(createCardFromBuffer(text, strlen(text), &second) == OK);
+    if (first != NULL && second != NULL)
+    {
+        CHECK(first->fn->name == second->fn->name && isInterned(first->fn->name));
+
+        char* firstValue = (char*)getFromFront(first->fn->values);
+        char* secondValue = (char*)getFromFront(second->fn->values);
+        CHECK(firstValue != secondValue && !isInterned(firstValue) && strcmp(firstValue, secondValue) == 0);
+
+        Property* firstTel = (Property*)getFromFront(first->optionalProperties);
+        Property* secondTel = (Property*)getFromFront(second->optionalProperties);
+        CHECK(firstTel->name == secondTel->name && firstTel->group == secondTel->group);
+    }
+    deleteCard(first);
+    deleteCard(second);
+}
+
+// ************* Property kinds ***************
+
+//Indexed by PropertyKind, as written in VCParser.h
+static const char* const kindNames[] = {
+    NULL, "BEGIN", "END", "SOURCE", "KIND", "XML", "FN", "N",
+    "NICKNAME", "PHOTO", "BDAY", "ANNIVERSARY", "GENDER", "ADR", "TEL",
+    "EMAIL", "IMPP", "LANG", "TZ", "GEO", "TITLE", "ROLE", "LOGO",
+    "ORG", "MEMBER", "RELATED", "CATEGORIES", "NOTE", "PRODID", "REV",
+    "SOUND", "UID", "CLIENTPIDMAP", "URL", "VERSION", "KEY", "FBURL",
+    "CALADRURI", "CALURI",
+};
+
+#define KIND_COUNT ((int)(sizeof(kindNames) / sizeof(kindNames[0])))
+
+//The kind an upper-case name should have, by looking through kindNames
+static PropertyKind expectedKind(const char* name)
+{
+    for (int kind = 1; kind < KIND_COUNT; kind++)
+    {
+        if (strcmp(kindNames[kind], name) == 0) return (PropertyKind)kind;
+    }
+
+    return PROP_OTHER;
+}
+
+static void testPropertyKind(void)
+{
+    CHECK(KIND_COUNT == PROP_CALURI + 1);
+
+    //Every name in any case
+    for (int kind = 1; kind < KIND_COUNT; kind++)
+    {
+        const char* name = kindNames[kind];
+        size_t len = strlen(name);
+        char lower[16];
+        char mixed[16];
+        for (size_t i = 0; i <= len; i++)
+        {
+            lower[i] = (char)tolower((unsigned char)name[i]);
+            mixed[i] = i % 2 == 0 ? lower[i] : name[i];
+        }
+
+        CHECK(propertyKind(name, len) == (PropertyKind)kind);
+        CHECK(propertyKind(lower, len) == (PropertyKind)kind);
+        CHECK(propertyKind(mixed, len) == (PropertyKind)kind);
+    }
+
+    //Near misses
+    CHECK(propertyKind("TELX", 4) == PROP_OTHER);
+    CHECK(propertyKind("FNN", 3) == PROP_OTHER);
+    CHECK(propertyKind("", 0) == PROP_OTHER);
+    CHECK(propertyKind("TE", 2) == PROP_OTHER);
+    CHECK(propertyKind("TEL ", 4) == PROP_OTHER);
+    CHECK(propertyKind("TEL\0", 4) == PROP_OTHER);
+    CHECK(propertyKind("X-TEL", 5) == PROP_OTHER);
+    CHECK(propertyKind("CLIENTPIDMAPS", 13) == PROP_OTHER);
+    CHECK(propertyKind("CLIENTPIDMAPCLIENTPIDMAP", 24) == PROP_OTHER);
+
+    //Only name[0, len) is read
+    CHECK(propertyKind("TELEPHONE", 3) == PROP_TEL);
+    CHECK(propertyKind("FNORD", 2) == PROP_FN);
+    CHECK(propertyKind("N;CHARSET=UTF-8", 1) == PROP_N);
+
+    //Every one character change, drop and addition of a name is another name or nothing
+    static const char replacements[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0-";
+    bool exact = true;
+    for (int kind = 1; kind < KIND_COUNT; kind++)
+    {
+        const char* name = kindNames[kind];
+        size_t len = strlen(name);
+        char variant[24];
+
+        for (size_t pos = 0; pos < len; pos++)
+        {
+            for (const char* ch = replacements; *ch != '\0'; ch++)
+            {
+                memcpy(variant, name, len + 1);
+                variant[pos] = *ch;
+                if (propertyKind(variant, len) != expectedKind(variant)) exact = false;
+            }
+
+            memcpy(variant, name, pos);
+            memcpy(variant + pos, name + pos + 1, len - pos);
+            if (propertyKind(variant, len - 1) != expectedKind(variant)) exact = false;
+        }
+
+        for (const char* ch = replacements; *ch != '\0'; ch++)
+        {
+            memcpy(variant, name, len);
+            variant[len] = *ch;
+            variant[len + 1] = '\0';
+            if (propertyKind(variant, len + 1) != expectedKind(variant)) exact = false;
+        }
+    }
+    CHECK(exact);
+
+    //Every name of up to three letters
+    char shortName[4];
+    exact = true;
+    for (int len = 1; len <= 3; len++)
+    {
+        int total = len == 1 ? 26 : len == 2 ? 26 * 26 : 26 * 26 * 26;
+        for (int n = 0; n < total; n++)
+        {
+            int rest = n;
+            for (int i = 0; i < len; i++)
+            {
+                shortName[i] = (char)('A' + rest % 26);
+                rest /= 26;
+            }
+            shortName[len] = '\0';
+            if (propertyKind(shortName, len) != expectedKind(shortName)) exact = false;
+        }
+    }
+    CHECK(exact);
+}
+
+// ************* Property index ***************
+
+static Property* newProperty(const char* line)
+{
+    Property* prop = (Property*)malloc(sizeof(Property));
+    if (createProperty(prop, line, strlen(line), NULL) != OK)
+    {
+        free(prop);
+        return NULL;
+    }
+
+    return prop;
+}
+
+static void testPropertyIndex(void)
+{
+    const char* text = findFixture("full.vcf")->text;
+    Card* card = NULL;
+    CHECK(createCardFromBuffer(text, strlen(text), &card) == OK);
+    if (card == NULL) return;
+
+    Property* const* props = NULL;
+    CHECK(getProperties(card, "tel", &props) == 2);
+    CHECK(getProperties(card, "FN", NULL) == 1);
+    CHECK(getFirstProperty(card, "FN") == card->fn);
+    CHECK(getProperties(card, "X-NONE", &props) == 0 && props == NULL);
+    CHECK(getProperties(card, "GEO", NULL) == 1);
+
+    //Kept current by addProperty and removeProperty
+    Property* other = newProperty("X-CUSTOM:1");
+    CHECK(addProperty(card, other) == OK);
+    CHECK(getFirstProperty(card, "x-custom") == other);
+
+    Property* tel = newProperty("TEL:555");
+    CHECK(addProperty(card, tel) == OK);
+    CHECK(getProperties(card, "TEL", &props) == 3 && props[2] == tel);
 
-    printf("Test1\n");
-    VCardErrorCode err = createCard(filename, &obj);
-    printf("Test2\n");
+    CHECK(removeProperty(card, tel) == tel);
+    CHECK(getProperties(card, "TEL", NULL) == 2);
+    CHECK(removeProperty(card, tel) == NULL);
+    deleteProperty(tel);
 
-    char* carsStr = cardToString(obj);
+    //A change made to the list directly is noticed on the next lookup
+    Property* note = newProperty("NOTE:direct");
+    insertBack(card->optionalProperties, note);
+    CHECK(getFirstProperty(card, "NOTE") == note);
 
-    printf("Test3\n");
+    Property* first = (Property*)getFromFront(card->optionalProperties);
+    CHECK(strcmp(first->name, "N") == 0 && getFirstProperty(card, "N") == first);
+    removeFromList(card->optionalProperties, first);
+    deleteProperty(first);
+    CHECK(getFirstProperty(card, "N") == NULL);
 
-    printf("%s\n", carsStr);
-    free(carsStr);
+    //A swap that keeps the length must not leave the old property in the index
+    Property* gender = getFirstProperty(card, "GENDER");
+    CHECK(gender != NULL);
+    removeFromList(card->optionalProperties, gender);
+    deleteProperty(gender);
+    Property* kind = newProperty("KIND:individual");
+    insertBack(card->optionalProperties, kind);
+    CHECK(getFirstProperty(card, "GENDER") == NULL);
+    CHECK(getFirstProperty(card, "KIND") == kind);
 
-    // char* errStr = errorToString(err);
-    // printf("%s\n", errStr);
-    // free(errStr);
+    deleteCard(card);
+}
+
+// ************* Card hash ***************
+
+static uint64_t hashOfText(const char* lines)
+{
+    char text[512];
+    snprintf(text, sizeof(text), "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\n%sEND:VCARD\r\n", lines);
+
+    Card* card = NULL;
+    CHECK(createCardFromBuffer(text, strlen(text), &card) == OK);
+
+    uint64_t hash = cardHash(card);
+    deleteCard(card);
+    return hash;
+}
+
+static void testCardHash(void)
+{
+    //The same card hashes the same however it was loaded
+    const char* text = findFixture("full.vcf")->text;
+    char* path = writeFixture("hash.vcf", text);
+
+    Card* heap = NULL;
+    Card* arena = NULL;
+    CHECK(createCard(path, &heap) == OK);
+    CHECK(createCardInArena(path, &arena) == OK);
+
+    void* data = NULL;
+    size_t len = 0;
+    Card* binary = NULL;
+    CHECK(encodeCardBinary(heap, &data, &len) == OK);
+    CHECK(readCardBinaryFromBuffer(data, len, &binary) == OK);
+    free(data);
+
+    uint64_t hash = cardHash(heap);
+    CHECK(hash != 0);
+    CHECK(cardHash(arena) == hash && cardHash(binary) == hash);
+
+    //Cached, and reset by the functions that change a card
+    CHECK(getCardHash(heap) == hash && heap->hash == hash);
+
+    Property* note = newProperty("NOTE:added");
+    CHECK(addProperty(heap, note) == OK);
+    CHECK(heap->hash == 0 && getCardHash(heap) != hash && getCardHash(heap) == cardHash(heap));
+
+    CHECK(removeProperty(heap, note) == note);
+    CHECK(heap->hash == 0 && getCardHash(heap) == hash);
+    deleteProperty(note);
+
+    CHECK(updateName(path, "Someone Else", &heap) == OK);
+    CHECK(getCardHash(heap) != hash && getCardHash(heap) == cardHash(heap));
+
+    deleteCard(heap);
+    deleteCard(arena);
+    deleteCard(binary);
+    free(path);
+
+    //The value is part of the format: it may be stored, e.g. next to a database row
+    CHECK(hashOfText("") == 0x37fd7d4403e25f8dULL);
+
+    //Each of these differs from the others in one detail only
+    const char* variants[] = {
+        "",
+        "NOTE:a\r\n",
+        "NOTE:b\r\n",
+        "NOTE:a;b\r\n",
+        "NOTE:ab\r\n",
+        "NOTE:a,b\r\n",
+        "NOTE;X=a:b\r\n",
+        "NOTE;X=a:\r\n",
+        "NOTE;X=a;Y=b:c\r\n",
+        "NOTE;X=a:b;c\r\n",
+        "NOTE;X=a:b\r\nNOTE:c\r\n",
+        "NOTE:c\r\nNOTE;X=a:b\r\n",
+        "g.NOTE:a\r\n",
+        "TITLE:a\r\n",
+        "NOTE:a\r\nNOTE:a\r\n",
+        "NOTE:;\r\n",
+        "NOTE:;;\r\n",
+        "BDAY:19540203\r\n",
+        "BDAY:19540204\r\n",
+        "BDAY:19540203T1200\r\n",
+        "BDAY:19540203T1200Z\r\n",
+        "BDAY:text\r\n",
+        "ANNIVERSARY:19540203\r\n",
+        "NOTE:aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\r\n",
+        "NOTE:aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab\r\n",
+        "NOTE:baaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\r\n",
+    };
+    enum {VARIANTS = sizeof(variants) / sizeof(variants[0])};
+
+    uint64_t hashes[VARIANTS];
+    for (int i = 0; i < VARIANTS; i++)
+    {
+        hashes[i] = hashOfText(variants[i]);
+        CHECK(hashes[i] == hashOfText(variants[i]));
+
+        for (int j = 0; j < i; j++)
+        {
+            CHECK(hashes[i] != hashes[j]);
+        }
+    }
+}
+
+// ************* Ordered list ***************
+
+static int compareInts(const void* first, const void* second)
+{
+    int a = *(const int*)first;
+    int b = *(const int*)second;
+
+    return (a > b) - (a < b);
+}
+
+static char* printInt(void* toBePrinted)
+{
+    char* str = (char*)malloc(16);
+    sprintf(str, "%d", *(int*)toBePrinted);
+    return str;
+}
+
+//Position of the first element of a sorted array >= key
+static int lowerBound(const int* sorted, int count, int key)
+{
+    int i = 0;
+    while (i < count && sorted[i] < key) i++;
+    return i;
+}
+
+static void testOrderedList(void)
+{
+    OrderedList* list = initializeOrderedList(printInt, free, compareInts);
+    CHECK(list != NULL);
+    if (list == NULL) return;
+
+    int reference[2000];
+    int count = 0;
+
+    for (int step = 0; step < 6000; step++)
+    {
+        int key = randomBelow(300);
+
+        if (randomBelow(3) != 0 && count < 2000)
+        {
+            int* data = (int*)malloc(sizeof(int));
+            *data = key;
+            insertOrdered(list, data);
+
+            int at = lowerBound(reference, count, key);
+            memmove(reference + at + 1, reference + at, (count - at) * sizeof(int));
+            reference[at] = key;
+            count++;
+        }
+        else
+        {
+            int* removed = (int*)deleteDataFromOrdered(list, &key);
+            int at = lowerBound(reference, count, key);
+            bool present = at < count && reference[at] == key;
+
+            CHECK((removed != NULL) == present);
+            if (removed != NULL)
+            {
+                CHECK(*removed == key);
+                free(removed);
+                memmove(reference + at, reference + at + 1, (count - at - 1) * sizeof(int));
+                count--;
+            }
+        }
+
+        if (step % 500 != 0) continue;
+
+        //Full comparison now and then
+        CHECK(getOrderedLength(list) == count);
+
+        ListIterator iter = createOrderedIterator(list);
+        int i = 0;
+        int* data;
+        while ((data = (int*)nextElement(&iter)) != NULL && i < count)
+        {
+            CHECK(*data == reference[i]);
+            i++;
+        }
+        CHECK(i == count && data == NULL);
+    }
+
+    for (int i = 0; i < count; i += 7)
+    {
+        CHECK(*(int*)getOrderedAt(list, i) == reference[i]);
+    }
+    CHECK(getOrderedAt(list, count) == NULL);
+
+    for (int key = -1; key <= 301; key++)
+    {
+        int rank = lowerBound(reference, count, key);
+        CHECK(orderedRank(list, &key) == rank);
+
+        ListIterator iter = orderedIteratorFrom(list, &key);
+        int* data = (int*)nextElement(&iter);
+        CHECK((rank < count) ? (data != NULL && *data == reference[rank]) : (data == NULL));
+
+        int* found = (int*)findOrdered(list, &key);
+        CHECK((found != NULL) == (rank < count && reference[rank] == key));
+    }
+
+    freeOrderedList(list);
+}
+
+// ************* Lists ***************
+
+static int* newInt(int value)
+{
+    int* data = (int*)malloc(sizeof(int));
+    *data = value;
+    return data;
+}
+
+static bool intEquals(const void* first, const void* second)
+{
+    return *(const int*)first == *(const int*)second;
+}
+
+//The element at position i, NULL past the end
+static void* elementAt(List* list, int i)
+{
+    ListIterator iter = createIterator(list);
+    void* data = nextElement(&iter);
+    while (data != NULL && i-- > 0) data = nextElement(&iter);
+    return data;
+}
+
+//Same length, elements, ends and string
+static bool sameList(List* list, List* reference)
+{
+    if (getLength(list) != getLength(reference)) return false;
+
+    ListIterator iter = createIterator(list);
+    ListIterator refIter = createIterator(reference);
+    int* data;
+    int* refData;
+    do
+    {
+        data = (int*)nextElement(&iter);
+        refData = (int*)nextElement(&refIter);
+        if ((data == NULL) != (refData == NULL)) return false;
+        if (data != NULL && *data != *refData) return false;
+    } while (data != NULL);
+
+    int* front = (int*)getFromFront(list);
+    int* back = (int*)getFromBack(list);
+    if ((front == NULL) != (getFromFront(reference) == NULL)) return false;
+    if (front != NULL && (*front != *(int*)getFromFront(reference) || *back != *(int*)getFromBack(reference))) return false;
+
+    char* str = toString(list);
+    char* refStr = toString(reference);
+    bool same = strcmp(str, refStr) == 0;
+    free(str);
+    free(refStr);
+    return same;
+}
+
+/*  Applies the same random operation to list and to reference, a plain linked list, and
+    checks both give the same results. Returns false on the first difference.
+*/
+static bool sameOperation(List* list, List* reference)
+{
+    unsigned int modifications = list->modifications;
+    int key = randomBelow(100);
+    int op = randomBelow(20);
+    bool changed = true;
+
+    if (op < 4)
+    {
+        insertFront(list, newInt(key));
+        insertFront(reference, newInt(key));
+    }
+    else if (op < 9)
+    {
+        insertBack(list, newInt(key));
+        insertBack(reference, newInt(key));
+    }
+    else if (op < 13)
+    {
+        insertSorted(list, newInt(key));
+        insertSorted(reference, newInt(key));
+    }
+    else if (op < 16)
+    {
+        int* data = (int*)deleteDataFromList(list, &key);
+        int* refData = (int*)deleteDataFromList(reference, &key);
+        if ((data == NULL) != (refData == NULL) || (data != NULL && *data != key)) return false;
+        changed = data != NULL;
+        free(data);
+        free(refData);
+    }
+    else if (op < 18)
+    {
+        //By pointer, so each list gives its own element at the same position
+        int at = (getLength(list) > 0) ? randomBelow(getLength(list)) : 0;
+        int* data = (int*)elementAt(list, at);
+        int* refData = (int*)elementAt(reference, at);
+        if (removeFromList(list, data) != data || removeFromList(reference, refData) != refData) return false;
+        changed = data != NULL;
+        free(data);
+        free(refData);
+
+        int absent = -1;
+        if (removeFromList(list, &absent) != NULL) return false;
+    }
+    else if (op < 19)
+    {
+        int* data = (int*)findElement(list, intEquals, &key);
+        int* refData = (int*)findElement(reference, intEquals, &key);
+        if ((data == NULL) != (refData == NULL) || (data != NULL && *data != key)) return false;
+        changed = false;
+    }
+    else if (randomBelow(10) == 0)
+    {
+        clearList(list);
+        clearList(reference);
+        if (getLength(list) != 0 || getFromFront(list) != NULL || getFromBack(list) != NULL) return false;
+    }
+    else
+    {
+        changed = false;
+    }
+
+    if (changed && list->modifications == modifications) return false;
+    return sameList(list, reference);
+}
+
+//An allocator that counts what is still allocated
+static void* countedAlloc(void* context, size_t size)
+{
+    (*(int*)context)++;
+    return malloc(size);
+}
+
+static void countedRelease(void* context, void* ptr)
+{
+    (*(int*)context)--;
+    free(ptr);
+}
+
+static void testArrayList(void)
+{
+    int outstanding = 0;
+    ListAllocator allocator = {countedAlloc, countedRelease, &outstanding};
+
+    //Room for 1, 4 and 64 elements up front, the last one from an allocator
+    static const int capacities[] = {0, 4, 64};
+    for (int c = 0; c < 3; c++)
+    {
+        List* list = initializeArrayList(printInt, free, compareInts, capacities[c], (c == 2) ? &allocator : NULL);
+        List* reference = initializeList(printInt, free, compareInts);
+        CHECK(list != NULL && list->head == NULL && list->items != NULL);
+        if (list == NULL) continue;
+
+        CHECK(getLength(list) == 0 && getFromFront(list) == NULL && getFromBack(list) == NULL);
+        ListIterator iter = createIterator(list);
+        CHECK(nextElement(&iter) == NULL);
+
+        bool same = true;
+        int longest = 0;
+        for (int step = 0; step < 4000 && same; step++)
+        {
+            same = sameOperation(list, reference);
+            if (getLength(list) > longest) longest = getLength(list);
+        }
+        CHECK(same);
+
+        //Well past the first capacity, still without nodes
+        CHECK(longest > 64 && list->capacity >= longest && list->head == NULL && list->tail == NULL);
+
+        //Sorted inserts into an empty list give a sorted list
+        clearList(list);
+        clearList(reference);
+        for (int i = 0; i < 200; i++)
+        {
+            int key = randomBelow(1000);
+            insertSorted(list, newInt(key));
+            insertSorted(reference, newInt(key));
+        }
+        CHECK(sameList(list, reference));
+
+        int previous = -1;
+        bool sorted = true;
+        iter = createIterator(list);
+        int* data;
+        while ((data = (int*)nextElement(&iter)) != NULL)
+        {
+            if (*data < previous) sorted = false;
+            previous = *data;
+        }
+        CHECK(sorted);
+
+        freeList(list);
+        freeList(reference);
+    }
+
+    CHECK(outstanding == 0);
+}
+
+//Nodes the pool handed out, and the nodes waiting on its free list
+static int poolUsed(const NodePool* pool)
+{
+    int used = 0;
+    for (const NodeSlab* slab = pool->slabs; slab != NULL; slab = slab->next) used += slab->used;
+    return used;
+}
+
+static int poolFree(const NodePool* pool)
+{
+    int count = 0;
+    for (const Node* node = pool->freeNodes; node != NULL; node = node->next) count++;
+    return count;
+}
+
+static void testNodePool(void)
+{
+    //A list with a pool of its own
+    List* list = initializeListWithPool(printInt, free, compareInts, NULL);
+    List* reference = initializeList(printInt, free, compareInts);
+    CHECK(list != NULL && list->pool != NULL);
+    if (list == NULL) return;
+
+    bool same = true;
+    bool balanced = true;
+    for (int step = 0; step < 4000 && same; step++)
+    {
+        same = sameOperation(list, reference);
+        if (poolUsed(list->pool) != poolFree(list->pool) + getLength(list)) balanced = false;
+    }
+    CHECK(same && balanced);
+
+    //Deleted nodes are handed out again before a slab is
+    clearList(list);
+    clearList(reference);
+    for (int i = 0; i < 100; i++) insertBack(list, newInt(i));
+    int used = poolUsed(list->pool);
+    for (int i = 0; i < 50; i++) free(deleteDataFromList(list, &i));
+    for (int i = 0; i < 50; i++) insertFront(list, newInt(i));
+    CHECK(poolUsed(list->pool) == used && poolFree(list->pool) == used - 100);
+
+    //clearList gives every node back at once
+    clearList(list);
+    CHECK(getLength(list) == 0 && poolFree(list->pool) == used);
+    freeList(list);
+    freeList(reference);
+
+    //Two lists sharing a pool, the nodes of one reused by the other
+    NodePool* pool = createNodePool(4);
+    CHECK(pool != NULL);
+    if (pool == NULL) return;
+
+    List* first = initializeListWithPool(printInt, free, compareInts, pool);
+    List* second = initializeListWithPool(printInt, free, compareInts, pool);
+    List* firstReference = initializeList(printInt, free, compareInts);
+    List* secondReference = initializeList(printInt, free, compareInts);
+    CHECK(first != NULL && second != NULL && first->pool == pool && second->pool == pool);
+    if (first == NULL || second == NULL) return;
+
+    same = true;
+    balanced = true;
+    for (int step = 0; step < 4000 && same; step++)
+    {
+        same = (step % 2 == 0) ? sameOperation(first, firstReference) : sameOperation(second, secondReference);
+        if (poolUsed(pool) != poolFree(pool) + getLength(first) + getLength(second)) balanced = false;
+    }
+    CHECK(same && balanced);
+
+    clearList(first);
+    used = poolUsed(pool);
+    for (int i = 0; i < used - getLength(second); i++) insertBack(first, newInt(i));
+    CHECK(poolUsed(pool) == used && poolFree(pool) == 0);
+
+    //freeList gives the nodes back to a shared pool, which outlives the list
+    freeList(first);
+    CHECK(poolFree(pool) == used - getLength(second));
+    insertBack(second, newInt(1));
+    insertBack(secondReference, newInt(1));
+    CHECK(sameList(second, secondReference));
+
+    freeList(second);
+    freeList(firstReference);
+    freeList(secondReference);
+    freeNodePool(pool);
+    freeNodePool(NULL);
+}
+
+// ************* Date columns ***************
+
+static void testDateColumns(void)
+{
+    static const int lengths[13] = {0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    enum {ROWS = 1500};
+
+    Card** cards = (Card**)calloc(ROWS, sizeof(Card*));
+    uint32_t* expected = (uint32_t*)calloc(ROWS, sizeof(uint32_t));
+
+    for (int i = 0; i < ROWS; i++)
+    {
+        int year = 1900 + randomBelow(120);
+        int month = 1 + randomBelow(12);
+        int day = 1 + randomBelow(lengths[month]);
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        if (month == 2 && day == 29 && !leap) year = 2000;
+
+        char date[48];
+        switch (randomBelow(6))
+        {
+            case 0:
+                snprintf(date, sizeof(date), "--%02d%02d", month, day);
+                expected[i] = PACK_DATE(0, month, day);
+                break;
+            case 1:
+                snprintf(date, sizeof(date), "--%02d", month);
+                expected[i] = PACK_DATE(0, month, 0);
+                break;
+            case 2:
+                snprintf(date, sizeof(date), "%04d", year);
+                expected[i] = PACK_DATE(year, 0, 0);
+                break;
+            case 3:
+                //No birthday at all
+                date[0] = '\0';
+                expected[i] = 0;
+                break;
+            default:
+                snprintf(date, sizeof(date), "%04d%02d%02dT1200", year, month, day);
+                expected[i] = PACK_DATE(year, month, day);
+                break;
+        }
+
+        char text[160];
+        if (date[0] == '\0')
+        {
+            snprintf(text, sizeof(text), "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Row %d\r\nEND:VCARD\r\n", i);
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Row %d\r\nBDAY:%s\r\nEND:VCARD\r\n", i, date);
+        }
+
+        CHECK(createCardFromBuffer(text, strlen(text), &cards[i]) == OK);
+        if (cards[i] != NULL) CHECK(packDate(cards[i]->birthday) == expected[i]);
+    }
+
+    DateColumns* columns = NULL;
+    CHECK(buildDateColumns(cards, ROWS, &columns) == OK);
+
+    uint32_t* rows = (uint32_t*)malloc(ROWS * sizeof(uint32_t));
+    uint32_t* want = (uint32_t*)malloc(ROWS * sizeof(uint32_t));
+
+    for (int month = 1; month <= 12; month++)
+    {
+        size_t n = 0;
+        for (int i = 0; i < ROWS; i++)
+        {
+            if (DATE_MONTH(expected[i]) == month) want[n++] = i;
+        }
+
+        size_t got = queryDateMonth(columns, DATE_BIRTHDAY, month, rows, ROWS);
+        CHECK(got == n && memcmp(rows, want, n * sizeof(uint32_t)) == 0);
+        CHECK(queryDateMonth(columns, DATE_ANNIVERSARY, month, rows, ROWS) == 0);
+    }
+
+    for (int query = 0; query < 200; query++)
+    {
+        int month = 1 + randomBelow(12);
+        int day = 1 + randomBelow(lengths[month]);
+        int days = 1 + randomBelow((query % 10 == 0) ? 400 : 60);
+
+        //Days since January 1 in a leap year
+        int start = day - 1;
+        for (int m = 1; m < month; m++) start += lengths[m];
+
+        size_t n = 0;
+        for (int i = 0; i < ROWS; i++)
+        {
+            int m = DATE_MONTH(expected[i]);
+            int d = DATE_DAY(expected[i]);
+            if (m == 0 || d == 0) continue;
+
+            int at = d - 1;
+            for (int k = 1; k < m; k++) at += lengths[k];
+
+            if (days >= 366 || (at - start + 366) % 366 < days) want[n++] = i;
+        }
+
+        size_t got = queryDateWithin(columns, DATE_BIRTHDAY, month, day, days, rows, ROWS);
+        CHECK(got == n && memcmp(rows, want, n * sizeof(uint32_t)) == 0);
+
+        uint32_t from = PACK_DATE(1900 + randomBelow(120), 1 + randomBelow(12), 1 + randomBelow(28));
+        uint32_t to = from + (uint32_t)randomBelow(20 << 9);
+
+        n = 0;
+        for (int i = 0; i < ROWS; i++)
+        {
+            if (expected[i] >= from && expected[i] <= to) want[n++] = i;
+        }
+
+        got = queryDateBetween(columns, DATE_BIRTHDAY, from, to, rows, ROWS);
+        CHECK(got == n && memcmp(rows, want, n * sizeof(uint32_t)) == 0);
+
+        //A small capacity still counts every match, and writes the first ones
+        got = queryDateBetween(columns, DATE_BIRTHDAY, from, to, rows, 3);
+        CHECK(got == n && memcmp(rows, want, (n < 3 ? n : 3) * sizeof(uint32_t)) == 0);
+    }
+
+    free(rows);
+    free(want);
+    freeDateColumns(columns);
+
+    for (int i = 0; i < ROWS; i++) deleteCard(cards[i]);
+    free(cards);
+    free(expected);
+}
+
+// ************* Search index ***************
+
+#define SEARCH_ITEMS 600
+
+static void foldString(char* dest, const char* src)
+{
+    while (*src != '\0') *dest++ = (char)tolower((unsigned char)*src++);
+    *dest = '\0';
+}
+
+static void testSearchIndex(void)
+{
+    //A small alphabet, so queries match many items
+    static const char* syllables[] = {"an", "ber", "Ca", "DO", "el", "fi", "gus", "ha", "Ro", "sa", "li", "MAR"};
+    char terms[SEARCH_ITEMS][3][24];
+    int termCounts[SEARCH_ITEMS];
+    bool live[SEARCH_ITEMS];
+    int ids[SEARCH_ITEMS];
+    SearchEntry* entries[SEARCH_ITEMS];
+
+    SearchIndex* index = NULL;
+    CHECK(createSearchIndex(&index) == OK);
+    if (index == NULL) return;
+
+    for (int i = 0; i < SEARCH_ITEMS; i++)
+    {
+        termCounts[i] = 1 + randomBelow(3);
+        const char* termPointers[3];
+
+        for (int t = 0; t < termCounts[i]; t++)
+        {
+            terms[i][t][0] = '\0';
+            int parts = 1 + randomBelow(4);
+            for (int p = 0; p < parts; p++) strcat(terms[i][t], syllables[randomBelow(12)]);
+            termPointers[t] = terms[i][t];
+        }
+
+        ids[i] = i;
+        live[i] = true;
+        CHECK(addSearchEntry(index, &ids[i], termPointers, termCounts[i], &entries[i]) == OK);
+    }
+
+    void** found = (void**)malloc(SEARCH_ITEMS * sizeof(void*));
+
+    for (int round = 0; round < 3; round++)
+    {
+        for (int query = 0; query < 300; query++)
+        {
+            //A piece of some term, in any case
+            int item = randomBelow(SEARCH_ITEMS);
+            const char* term = terms[item][randomBelow(termCounts[item])];
+            int termLen = (int)strlen(term);
+            int len = 1 + randomBelow(termLen < 6 ? termLen : 6);
+            int start = randomBelow(termLen - len + 1);
+
+            char text[8];
+            memcpy(text, term + start, len);
+            text[len] = '\0';
+            if (query % 2 == 0) text[0] = (char)toupper((unsigned char)text[0]);
+
+            char folded[8];
+            foldString(folded, text);
+
+            bool want[SEARCH_ITEMS];
+            bool prefix[SEARCH_ITEMS];
+            int wantCount = 0;
+
+            for (int i = 0; i < SEARCH_ITEMS; i++)
+            {
+                want[i] = false;
+                prefix[i] = false;
+                if (!live[i]) continue;
+
+                for (int t = 0; t < termCounts[i]; t++)
+                {
+                    char foldedTerm[24];
+                    foldString(foldedTerm, terms[i][t]);
+
+                    if (strncmp(foldedTerm, folded, len) == 0) prefix[i] = true;
+                    if (len >= 3 && strstr(foldedTerm, folded) != NULL) want[i] = true;
+                }
+
+                if (prefix[i]) want[i] = true;
+                if (want[i]) wantCount++;
+            }
+
+            int got = querySearchIndex(index, text, found, SEARCH_ITEMS);
+            CHECK(got == wantCount);
+
+            //Each wanted item once, prefix matches first
+            bool seen[SEARCH_ITEMS] = {false};
+            bool pastPrefixes = false;
+            for (int k = 0; k < got; k++)
+            {
+                int id = *(int*)found[k];
+                CHECK(want[id] && !seen[id]);
+                seen[id] = true;
+
+                if (!prefix[id]) pastPrefixes = true;
+                CHECK(!pastPrefixes || !prefix[id]);
+            }
+
+            //A limit cuts the results short
+            CHECK(querySearchIndex(index, text, found, 2) == (wantCount < 2 ? wantCount : 2));
+        }
+
+        //Remove a third of what is left, then check again
+        for (int i = 0; i < SEARCH_ITEMS; i++)
+        {
+            if (live[i] && randomBelow(3) == 0)
+            {
+                removeSearchEntry(index, entries[i]);
+                live[i] = false;
+            }
+        }
+    }
+
+    free(found);
+    freeSearchIndex(index);
+}
+
+// ************* Contact store ***************
+
+#define STORE_FILES 240
+
+//What the store should have for one file name
+typedef struct storeRecord {
+    bool    present;
+    char    fileName[16];
+    char    email[32];
+    Contact contact;
+    int     birthdayMonth;
+    int     birthdayDay;
+    int     anniversaryMonth;
+    int     anniversaryDay;
+} StoreRecord;
+
+static int compareRecordNames(const StoreRecord* a, const StoreRecord* b)
+{
+    int cmp = strcasecmp(a->contact.name, b->contact.name);
+    if (cmp == 0) cmp = strcmp(a->contact.name, b->contact.name);
+    if (cmp == 0) cmp = strcmp(a->fileName, b->fileName);
+    return cmp;
+}
+
+static int compareRecordsByName(const void* first, const void* second)
+{
+    return compareRecordNames((const StoreRecord*)first, (const StoreRecord*)second);
+}
+
+static int compareRecordsByBirthday(const void* first, const void* second)
+{
+    const StoreRecord* a = (const StoreRecord*)first;
+    const StoreRecord* b = (const StoreRecord*)second;
+    if (a->birthdayDay != b->birthdayDay) return a->birthdayDay - b->birthdayDay;
+    return compareRecordNames(a, b);
+}
+
+static int compareRecordsByAnniversary(const void* first, const void* second)
+{
+    const StoreRecord* a = (const StoreRecord*)first;
+    const StoreRecord* b = (const StoreRecord*)second;
+    if (a->anniversaryDay != b->anniversaryDay) return a->anniversaryDay - b->anniversaryDay;
+    return compareRecordNames(a, b);
+}
+
+//A random date line for prop, setting month and day to what the store should index it under
+static void randomDate(char* line, size_t size, const char* prop, int* month, int* day)
+{
+    (*month) = 1 + randomBelow(12);
+    (*day) = 1 + randomBelow(28);
+
+    switch (randomBelow(5))
+    {
+        case 0: snprintf(line, size, "%s:19%02d%02d%02d\r\n", prop, randomBelow(100), *month, *day); break;
+        case 1: snprintf(line, size, "%s:--%02d%02d\r\n", prop, *month, *day); break;
+        case 2: snprintf(line, size, "%s:19%02d\r\n", prop, randomBelow(100)); (*month) = 0; (*day) = 0; break;
+        case 3: snprintf(line, size, "%s:circa 18%02d\r\n", prop, randomBelow(100)); (*month) = 0; (*day) = 0; break;
+        default: line[0] = '\0'; (*month) = 0; (*day) = 0; break;
+    }
+}
+
+//Stores a new random card under record->fileName
+static void storeRandomCard(ContactStore* store, StoreRecord* record, int serial)
+{
+    //Few names, differing in case, so names tie and fall back to the file name
+    static const char* names[] = {"Anna Smith", "anna smith", "Bob", "BOB", "Chloe Du", "Zed", "al", "Ng"};
+
+    char bday[48];
+    char anniversary[48];
+    randomDate(bday, sizeof(bday), "BDAY", &record->birthdayMonth, &record->birthdayDay);
+    randomDate(anniversary, sizeof(anniversary), "ANNIVERSARY", &record->anniversaryMonth, &record->anniversaryDay);
+    snprintf(record->email, sizeof(record->email), "person%dq@example.com", serial);
+
+    char text[512];
+    snprintf(text, sizeof(text), "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:%s\r\nN:Last%d;First;;;\r\nEMAIL:%s\r\n%s%sEND:VCARD\r\n",
+             names[randomBelow(8)], serial, record->email, bday, anniversary);
+
+    Card* card = NULL;
+    CHECK(createCardFromBuffer(text, strlen(text), &card) == OK);
+    if (card == NULL) return;
+
+    CHECK(storeContact(store, record->fileName, card) == OK);
+    record->contact = getContact(record->fileName, card);
+    record->present = true;
+    deleteCard(card);
+}
+
+static bool sameContact(const Contact* a, const Contact* b)
+{
+    return strcmp(a->file_name, b->file_name) == 0 && strcmp(a->name, b->name) == 0 && strcmp(a->birthday, b->birthday) == 0
+        && strcmp(a->anniversary, b->anniversary) == 0 && a->prop_count == b->prop_count;
+}
+
+//Reads a query page by page and checks it gives expected, in order
+static bool samePages(const StoreRecord* expected, int count, int pageSize, int (*query)(ContactStore*, int, int, int, int, Contact*, int*),
+                      ContactStore* store, int month, int day)
+{
+    Contact page[16];
+    for (int offset = 0; offset < count + pageSize; offset += pageSize)
+    {
+        int total = -1;
+        int got = (query != NULL) ? query(store, month, day, offset, pageSize, page, &total)
+                                  : queryContactsByName(store, offset, pageSize, page, &total);
+
+        int want = (count - offset < pageSize) ? count - offset : pageSize;
+        if (want < 0) want = 0;
+        if (total != count || got != want) return false;
+
+        for (int i = 0; i < got; i++)
+        {
+            if (!sameContact(&page[i], &expected[offset + i].contact)) return false;
+        }
+    }
+
+    return true;
+}
+
+static void checkStore(ContactStore* store, const StoreRecord* records)
+{
+    StoreRecord* sorted = (StoreRecord*)malloc(STORE_FILES * sizeof(StoreRecord));
+    int count = 0;
+    for (int i = 0; i < STORE_FILES; i++)
+    {
+        if (records[i].present) sorted[count++] = records[i];
+    }
+    CHECK(getStoredContactCount(store) == count);
+
+    bool found = true;
+    for (int i = 0; i < STORE_FILES; i++)
+    {
+        Contact contact;
+        if (findStoredContact(store, records[i].fileName, &contact) != records[i].present) found = false;
+        else if (records[i].present && !sameContact(&contact, &records[i].contact)) found = false;
+    }
+    CHECK(found);
+
+    qsort(sorted, count, sizeof(StoreRecord), compareRecordsByName);
+    CHECK(samePages(sorted, count, 7, NULL, store, 0, 0));
+    CHECK(samePages(sorted, count, 16, NULL, store, 0, 0));
+
+    //Birthdays and anniversaries by month, and on a few days of each month
+    bool dates = true;
+    for (int month = 1; month <= 12; month++)
+    {
+        for (int day = 0; day <= 28; day += (day == 0) ? 1 : 9)
+        {
+            int matches = 0;
+            for (int i = 0; i < STORE_FILES; i++)
+            {
+                if (records[i].present && records[i].birthdayMonth == month && (day == 0 || records[i].birthdayDay == day))
+                {
+                    sorted[matches++] = records[i];
+                }
+            }
+            qsort(sorted, matches, sizeof(StoreRecord), compareRecordsByBirthday);
+            if (!samePages(sorted, matches, 5, queryContactsByBirthday, store, month, day)) dates = false;
+
+            matches = 0;
+            for (int i = 0; i < STORE_FILES; i++)
+            {
+                if (records[i].present && records[i].anniversaryMonth == month && (day == 0 || records[i].anniversaryDay == day))
+                {
+                    sorted[matches++] = records[i];
+                }
+            }
+            qsort(sorted, matches, sizeof(StoreRecord), compareRecordsByAnniversary);
+            if (!samePages(sorted, matches, 5, queryContactsByAnniversary, store, month, day)) dates = false;
+        }
+    }
+    CHECK(dates);
+
+    //Each EMAIL finds its own contact first, since it is the only one starting with it
+    bool searched = true;
+    for (int i = 0; i < STORE_FILES; i += 5)
+    {
+        if (!records[i].present) continue;
+
+        Contact results[4];
+        int got = searchContacts(store, records[i].email, 4, results);
+        if (got < 1 || !sameContact(&results[0], &records[i].contact)) searched = false;
+    }
+    CHECK(searched);
+
+    free(sorted);
+}
+
+static void testContactStore(void)
+{
+    ContactStore* store = NULL;
+    CHECK(createContactStore(&store) == OK);
+    if (store == NULL) return;
+
+    StoreRecord* records = (StoreRecord*)calloc(STORE_FILES, sizeof(StoreRecord));
+    int serial = 0;
+    for (int i = 0; i < STORE_FILES; i++)
+    {
+        snprintf(records[i].fileName, sizeof(records[i].fileName), "c%03d.vcf", i);
+        if (i % 4 != 3) storeRandomCard(store, &records[i], serial++);
+    }
+    checkStore(store, records);
+
+    //Replace, remove and rename, including onto a file the store already has
+    for (int round = 0; round < 6; round++)
+    {
+        for (int step = 0; step < 60; step++)
+        {
+            StoreRecord* record = &records[randomBelow(STORE_FILES)];
+            StoreRecord* target = &records[randomBelow(STORE_FILES)];
+
+            switch (randomBelow(3))
+            {
+                case 0:
+                    storeRandomCard(store, record, serial++);
+                    break;
+                case 1:
+                    CHECK(unstoreContact(store, record->fileName) == record->present);
+                    record->present = false;
+                    break;
+                default:
+                    CHECK(renameStoredContact(store, record->fileName, target->fileName) == record->present);
+                    if (record->present && record != target)
+                    {
+                        char fileName[sizeof(target->fileName)];
+                        strcpy(fileName, target->fileName);
+                        (*target) = (*record);
+                        strcpy(target->fileName, fileName);
+                        strcpy(target->contact.file_name, fileName);
+                        record->present = false;
+                    }
+                    break;
+            }
+        }
+        checkStore(store, records);
+    }
+
+    //Out of range pages and dates are empty, with the right total
+    Contact page[4];
+    int total = -1;
+    CHECK(queryContactsByName(store, -1, 4, page, &total) == 0 && total == getStoredContactCount(store));
+    CHECK(queryContactsByName(store, 0, 0, page, &total) == 0);
+    CHECK(queryContactsByName(store, 0, 4, NULL, &total) == 0);
+    CHECK(queryContactsByBirthday(store, 13, 0, 0, 4, page, &total) == 0 && total == 0);
+    CHECK(queryContactsByAnniversary(store, 0, 0, 0, 4, page, &total) == 0 && total == 0);
+    CHECK(queryContactsByBirthday(store, 2, 32, 0, 4, page, &total) == 0 && total == 0);
+    CHECK(searchContacts(store, "nobody-has-this", 4, page) == 0);
+
+    //A card without FN, and files the store does not have
+    Card* card = NULL;
+    CHECK(createCardFromBuffer(findFixture("full.vcf")->text, strlen(findFixture("full.vcf")->text), &card) == OK);
+    if (card != NULL)
+    {
+        Property* fn = card->fn;
+        card->fn = NULL;
+        CHECK(storeContact(store, "nofn.vcf", card) == INV_CARD);
+        card->fn = fn;
+    }
+    deleteCard(card);
+    CHECK(!findStoredContact(store, "nofn.vcf", NULL));
+    CHECK(!unstoreContact(store, "nofn.vcf"));
+    CHECK(!renameStoredContact(store, "nofn.vcf", records[0].fileName));
+    checkStore(store, records);
+
+    free(records);
+    freeContactStore(store);
+    freeContactStore(NULL);
+}
+
+// ************* Duplicates ***************
+
+static Card* cardFromLines(const char* lines)
+{
+    char text[512];
+    snprintf(text, sizeof(text), "BEGIN:VCARD\r\nVERSION:4.0\r\n%sEND:VCARD\r\n", lines);
+
+    Card* card = NULL;
+    createCardFromBuffer(text, strlen(text), &card);
+    return card;
+}
+
+//Cluster of a report holding member, -1 if none
+static int clusterOf(const DuplicateReport* report, int member)
+{
+    for (int c = 0; c < report->clusterCount; c++)
+    {
+        const DuplicateCluster* cluster = &report->clusters[c];
+        for (int k = 0; k < cluster->count; k++)
+        {
+            if (report->members[cluster->first + k] == member) return c;
+        }
+    }
+
+    return -1;
+}
+
+static void testDuplicates(void)
+{
+    Card* cards[8];
+    cards[0] = cardFromLines("FN:John Smith\r\nEMAIL:john@example.com\r\n");
+    cards[1] = cardFromLines("FN:Smith John\r\nEMAIL:MAILTO:JOHN@example.com\r\n");
+    cards[2] = cardFromLines("FN:Mary Jones\r\nTEL:+1 (555) 010-2030\r\n");
+    cards[3] = NULL;
+    cards[4] = cardFromLines("FN:Mary Jones\r\nTEL:5550102030\r\n");
+    cards[5] = cardFromLines("FN:Mary Jones\r\nEMAIL:mary@other.org\r\n");
+    cards[6] = cardFromLines("FN:Someone Else\r\nEMAIL:john@example.com\r\n");
+    cards[7] = cardFromLines("FN:John Smith\r\nN:Smith;John;;;\r\n");
+
+    DuplicateReport* report = NULL;
+    CHECK(findDuplicateCards(cards, 8, 0.7, &report) == OK);
+    if (report == NULL) return;
+
+    //Same name words and email, different order and case
+    CHECK(clusterOf(report, 0) >= 0 && clusterOf(report, 0) == clusterOf(report, 1));
+
+    //Same name and phone number, written differently
+    CHECK(clusterOf(report, 2) >= 0 && clusterOf(report, 2) == clusterOf(report, 4));
+
+    //A shared email alone is not enough, nor a shared name with different emails
+    CHECK(clusterOf(report, 6) == -1 || clusterOf(report, 6) != clusterOf(report, 0));
+    CHECK(clusterOf(report, 3) == -1);
+
+    //Members are in increasing order, clusters sorted by their first member
+    for (int c = 0; c < report->clusterCount; c++)
+    {
+        const DuplicateCluster* cluster = &report->clusters[c];
+        CHECK(cluster->count >= 2 && cluster->score >= 0.7);
+
+        for (int k = 1; k < cluster->count; k++)
+        {
+            CHECK(report->members[cluster->first + k - 1] < report->members[cluster->first + k]);
+        }
+
+        if (c > 0) CHECK(report->members[report->clusters[c - 1].first] < report->members[cluster->first]);
+    }
+
+    freeDuplicateReport(report);
+
+    //Nothing is a duplicate at a threshold above 1
+    CHECK(findDuplicateCards(cards, 8, 1.01, &report) == OK && report != NULL && report->clusterCount == 0);
+    freeDuplicateReport(report);
+
+    for (int i = 0; i < 8; i++) deleteCard(cards[i]);
+}
+
+// ************* Watcher ***************
+
+static void logChange(CardChange change, const char* fileName, const char* oldFileName, Card* card, VCardErrorCode err, void* userData)
+{
+    static const char* const names[] = {"created", "modified", "renamed", "deleted", "rescan"};
+    char* log = (char*)userData;
+    size_t used = strlen(log);
+
+    snprintf(log + used, 256 - used, "[%s %s%s%s err %d]", names[change], (fileName != NULL) ? fileName : "-",
+             (oldFileName != NULL) ? " from " : "", (oldFileName != NULL) ? oldFileName : "", (int)err);
+    deleteCard(card);
+}
+
+static void writeText(const char* path, const char* text)
+{
+    FILE* fptr = fopen(path, "wb");
+    if (fptr == NULL) return;
+    fputs(text, fptr);
+    fclose(fptr);
+}
+
+static void testCardWatcher(void)
+{
+    char* dir = writeFixture("watched", "");
+    unlink(dir);
+    CHECK(mkdir(dir, 0700) == 0);
+
+    char log[256] = "";
+    CardWatcher* watcher = NULL;
+    CHECK(openCardWatcher(dir, logChange, log, &watcher) == OK);
+    if (watcher == NULL)
+    {
+        free(dir);
+        return;
+    }
+
+    char path[512];
+    char other[512];
+    snprintf(path, sizeof(path), "%s/a.vcf", dir);
+    snprintf(other, sizeof(other), "%s/b.vcf", dir);
+
+    //Nothing pending
+    CHECK(processCardChanges(watcher, 0) == 0);
+
+    writeText(path, fixtures[0].text);
+    CHECK(processCardChanges(watcher, 0) == 1);
+    CHECK(strcmp(log, "[created a.vcf err 3]") == 0);
+
+    log[0] = '\0';
+    writeText(path, findFixture("full.vcf")->text);
+    CHECK(processCardChanges(watcher, 0) == 1);
+    CHECK(rename(path, other) == 0);
+    CHECK(unlink(other) == 0);
+    CHECK(processCardChanges(watcher, 0) == 2);
+    CHECK(strcmp(log, "[modified a.vcf err 0][renamed b.vcf from a.vcf err 0][deleted b.vcf err 0]") == 0);
+
+    //More events than the kernel queues: the ones that fit are reported, then a rescan
+    char junk[2][512];
+    snprintf(junk[0], sizeof(junk[0]), "%s/x.txt", dir);
+    snprintf(junk[1], sizeof(junk[1]), "%s/y.txt", dir);
+    for (int i = 0; i < 20000; i++) writeText(junk[i % 2], "");
+
+    log[0] = '\0';
+    CHECK(processCardChanges(watcher, 0) == 1);
+    CHECK(strcmp(log, "[rescan - err 0]") == 0);
+    CHECK(processCardChanges(watcher, 0) == 0);
+
+    //Deleting the directory ends the watch
+    unlink(junk[0]);
+    unlink(junk[1]);
+    CHECK(rmdir(dir) == 0);
+    CHECK(processCardChanges(watcher, 0) == -1);
+    CHECK(processCardChanges(watcher, 0) == -1);
+
+    closeCardWatcher(watcher);
+    free(dir);
+}
+
+int main(void)
+{
+    if (mkdtemp(tempDir) == NULL)
+    {
+        printf("could not create a directory for the fixtures\n");
+        return 1;
+    }
 
-    // VCardErrorCode writeErr = writeCard("testOut.vcf", obj);
-    // errStr = errorToString(writeErr);
-    // printf("%s\n", errStr);
-    // free(errStr);
+    testCreateCard();
+    testCardStream();
+    testPushParser();
+    testPushParserLatency();
+    testDelimiterScan();
+    testBinaryRoundTrip();
+    testLoadCardDirectory();
+    testLoadCardBatch();
+    testValidateCards();
+    testCardCache();
+    testWriteCard();
+    testPropertyIndex();
+    testInternTable();
+    testPropertyKind();
+    testCardHash();
+    testOrderedList();
+    testArrayList();
+    testNodePool();
+    testDateColumns();
+    testSearchIndex();
+    testContactStore();
+    testDuplicates();
+    testCardWatcher();
 
-    VCardErrorCode validateErr = validateCard(obj);
-    char* errStr = errorToString(validateErr);
-    printf("%s\n", errStr);
-    free(errStr);
+    removeFixtures();
 
-    Contact contact = getContact(filename, obj);
-    printf("%s\n", contact.file_name);
-    printf("%s\n", contact.name);
-    printf("%s\n", contact.birthday);
-    printf("%s\n", contact.anniversary);
-    printf("%d\n", contact.prop_count);
-    
-    deleteCard(obj);
-    return 0;
-}
\ No newline at end of file
+    printf("%d checks, %d failed\n", checks, failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -2,19 +2,32 @@
 #include "LinkedListAPI.h"
 #include "VCValidate.h"
 #include "VCAPIHelpers.h"
+#include "VCHelpers.h"
+#include "VCWriter.h"
+#include "VCHash.h"
 #include <ctype.h>
 
 Contact getContact(char* filename, Card* obj)
 {
     Contact contact;
-    strcpy(contact.file_name, filename);
-    strcpy(contact.name, obj->fn->values->head->data);
+    snprintf(contact.file_name, sizeof(contact.file_name), "%s", filename);
+    snprintf(contact.name, sizeof(contact.name), "%s", (char*)getFromFront(obj->fn->values));
     
     if (obj->birthday == NULL) strcpy(contact.birthday, "");
-    else strcpy(contact.birthday, dateToString(obj->birthday));
+    else
+    {
+        char* bday = dateToString(obj->birthday);
+        snprintf(contact.birthday, sizeof(contact.birthday), "%s", bday);
+        free(bday);
+    }
 
     if (obj->anniversary == NULL) strcpy(contact.anniversary, "");
-    else strcpy(contact.anniversary, dateToString(obj->anniversary));
+    else
+    {
+        char* ann = dateToString(obj->anniversary);
+        snprintf(contact.anniversary, sizeof(contact.anniversary), "%s", ann);
+        free(ann);
+    }
 
     contact.prop_count = getLength(obj->optionalProperties);
 
@@ -24,14 +37,15 @@ Contact getContact(char* filename, Card* obj)
 VCardErrorCode updateName(char* filename, char* fn, Card** obj)
 {
     clearList((*obj)->fn->values);
-    char* fnCopy = malloc(strlen(fn) + 1);
+    char* fnCopy = cardAlloc((*obj), strlen(fn) + 1);
     strcpy(fnCopy, fn);
     insertBack((*obj)->fn->values, fnCopy);
+    invalidateCardHash(*obj);
 
     VCardErrorCode err = validateCard(*obj);
     if (err != OK) return err;
 
-    VCardErrorCode writeErr = writeCard(filename, *obj);
+    VCardErrorCode writeErr = writeCardWithFlags(filename, *obj, CARD_WRITE_FSYNC);
     if (writeErr != OK) return writeErr;
 
     return OK;
@@ -55,6 +69,7 @@ VCardErrorCode newCard(char* filename, char* fn, Card** obj)
 
     prop->group = (char*)malloc(sizeof(char) * 1);
     prop->group[0] = '\0';
+    prop->kind = PROP_FN;
 
     prop->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
     prop->values = initializeList(&valueToString, &deleteValue, &compareValues);
@@ -67,12 +82,15 @@ VCardErrorCode newCard(char* filename, char* fn, Card** obj)
     (*obj)->optionalProperties = initializeList(&propertyToString, &deleteProperty, &compareProperties);
     (*obj)->birthday = NULL;
     (*obj)->anniversary = NULL;
+    (*obj)->arena = NULL;
+    (*obj)->index = NULL;
+    (*obj)->hash = 0;
 
 
     VCardErrorCode err = validateCard(*obj);
     if (err != OK) return err;
 
-    VCardErrorCode writeErr = writeCard(filename, *obj);
+    VCardErrorCode writeErr = writeCardWithFlags(filename, *obj, CARD_WRITE_FSYNC);
     if (writeErr != OK) return writeErr;
 
     return OK;
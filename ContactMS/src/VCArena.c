@@ -0,0 +1,90 @@
+#include <stdalign.h>
+
+#include "VCArena.h"
+
+
+static size_t alignSize(size_t size)
+{
+    size_t align = alignof(max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+static ArenaChunk* createChunk(size_t size)
+{
+    ArenaChunk* chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL) return NULL;
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+static void* listAlloc(void* context, size_t size)
+{
+    return arenaAlloc((CardArena*)context, size);
+}
+
+CardArena* createArena(size_t initialSize)
+{
+    size_t headerSize = alignSize(sizeof(CardArena));
+
+    ArenaChunk* chunk = createChunk(alignSize(headerSize + initialSize));
+    if (chunk == NULL) return NULL;
+
+    CardArena* arena = (CardArena*)chunk->data;
+    chunk->used = headerSize;
+
+    arena->chunks = chunk;
+    arena->listAllocator.alloc = &listAlloc;
+    arena->listAllocator.release = NULL;
+    arena->listAllocator.context = arena;
+
+    return arena;
+}
+
+void* arenaAlloc(CardArena* arena, size_t size)
+{
+    if (arena == NULL) return NULL;
+
+    size = alignSize(size);
+
+    ArenaChunk* chunk = arena->chunks;
+    if (chunk->size - chunk->used < size)
+    {
+        size_t newSize = chunk->size * 2;
+        while (newSize < size) newSize *= 2;
+
+        ArenaChunk* newChunk = createChunk(newSize);
+        if (newChunk == NULL) return NULL;
+
+        //Newest chunk first, the first chunk (holding the arena) stays at the tail
+        newChunk->next = chunk;
+        arena->chunks = newChunk;
+        chunk = newChunk;
+    }
+
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+
+    return ptr;
+}
+
+size_t arenaSizeFor(size_t size)
+{
+    return alignSize(size);
+}
+
+void freeArena(CardArena* arena)
+{
+    if (arena == NULL) return;
+
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk != NULL)
+    {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
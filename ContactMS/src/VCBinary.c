@@ -0,0 +1,467 @@
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+#include "VCBinary.h"
+
+#define BINARY_MAGIC "VCBN"
+#define BINARY_HEADER_SIZE 28
+
+//Files up to this size are read into a stack buffer, larger ones are mapped
+#define BINARY_READ_BUFFER 16384
+
+#define HAS_BIRTHDAY 1
+#define HAS_ANNIVERSARY 2
+
+#define DATE_UTC 1
+#define DATE_TEXT 2
+
+/*  The writer runs twice over the card: once with buf NULL to measure it and count
+    the properties, parameters and values, then to fill a buffer of that size.
+*/
+typedef struct binaryWriter {
+    unsigned char*  buf;
+    size_t          len;
+    bool            failed;
+
+    uint32_t        properties;
+    uint32_t        parameters;
+    uint32_t        values;
+} BinaryWriter;
+
+typedef struct binaryReader {
+    unsigned char*  pos;
+    unsigned char*  end;
+    bool            failed;
+} BinaryReader;
+
+static void storeU32(unsigned char* dest, uint32_t value)
+{
+    dest[0] = (unsigned char)value;
+    dest[1] = (unsigned char)(value >> 8);
+    dest[2] = (unsigned char)(value >> 16);
+    dest[3] = (unsigned char)(value >> 24);
+}
+
+static uint32_t loadU32(const unsigned char* src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+//Unsigned LEB128: seven bits per byte, high bit set on all but the last
+static void putVarint(BinaryWriter* writer, uint32_t value)
+{
+    do
+    {
+        unsigned char byte = value & 0x7F;
+        value >>= 7;
+        if (value != 0) byte |= 0x80;
+
+        if (writer->buf != NULL) writer->buf[writer->len] = byte;
+        writer->len++;
+    } while (value != 0);
+}
+
+static void putString(BinaryWriter* writer, const char* str)
+{
+    if (str == NULL)
+    {
+        writer->failed = true;
+        return;
+    }
+
+    size_t len = strlen(str);
+    if (len > UINT32_MAX)
+    {
+        writer->failed = true;
+        return;
+    }
+
+    putVarint(writer, (uint32_t)len);
+    if (writer->buf != NULL) memcpy(writer->buf + writer->len, str, len + 1);
+    writer->len += len + 1;
+}
+
+static void putProperty(BinaryWriter* writer, const Property* prop)
+{
+    if (prop == NULL || prop->parameters == NULL || prop->values == NULL)
+    {
+        writer->failed = true;
+        return;
+    }
+
+    putString(writer, prop->group);
+    putString(writer, prop->name);
+
+    putVarint(writer, (uint32_t)getLength(prop->parameters));
+    ListIterator iter = createIterator(prop->parameters);
+    void* elem;
+    while ((elem = nextElement(&iter)) != NULL)
+    {
+        Parameter* param = (Parameter*)elem;
+        putString(writer, param->name);
+        putString(writer, param->value);
+        writer->parameters++;
+    }
+
+    putVarint(writer, (uint32_t)getLength(prop->values));
+    iter = createIterator(prop->values);
+    while ((elem = nextElement(&iter)) != NULL)
+    {
+        putString(writer, (char*)elem);
+        writer->values++;
+    }
+}
+
+static void putDate(BinaryWriter* writer, const DateTime* date)
+{
+    uint32_t flags = (date->UTC ? DATE_UTC : 0) | (date->isText ? DATE_TEXT : 0);
+
+    putVarint(writer, flags);
+    putString(writer, date->date);
+    putString(writer, date->time);
+    putString(writer, date->text);
+}
+
+static void putCard(BinaryWriter* writer, const Card* obj)
+{
+    writer->len = BINARY_HEADER_SIZE;
+
+    putProperty(writer, obj->fn);
+
+    ListIterator iter = createIterator(obj->optionalProperties);
+    void* elem;
+    while ((elem = nextElement(&iter)) != NULL)
+    {
+        putProperty(writer, (Property*)elem);
+        writer->properties++;
+    }
+
+    if (obj->birthday != NULL) putDate(writer, obj->birthday);
+    if (obj->anniversary != NULL) putDate(writer, obj->anniversary);
+
+    if (writer->buf == NULL) return;
+
+    uint32_t flags = (obj->birthday != NULL ? HAS_BIRTHDAY : 0) | (obj->anniversary != NULL ? HAS_ANNIVERSARY : 0);
+
+    memcpy(writer->buf, BINARY_MAGIC, 4);
+    storeU32(writer->buf + 4, BINARY_CARD_VERSION);
+    storeU32(writer->buf + 8, (uint32_t)(writer->len - BINARY_HEADER_SIZE));
+    storeU32(writer->buf + 12, writer->properties);
+    storeU32(writer->buf + 16, writer->parameters);
+    storeU32(writer->buf + 20, writer->values);
+    storeU32(writer->buf + 24, flags);
+}
+
+VCardErrorCode encodeCardBinary(const Card* obj, void** data, size_t* len)
+{
+    (*data) = NULL;
+    (*len) = 0;
+
+    if (obj == NULL || obj->fn == NULL || obj->optionalProperties == NULL) return WRITE_ERROR;
+
+    BinaryWriter writer = {NULL, 0, false, 0, 0, 0};
+    putCard(&writer, obj);
+    if (writer.failed || writer.len - BINARY_HEADER_SIZE > UINT32_MAX) return WRITE_ERROR;
+
+    unsigned char* buf = (unsigned char*)malloc(writer.len);
+    if (buf == NULL) return OTHER_ERROR;
+
+    writer = (BinaryWriter){buf, 0, false, 0, 0, 0};
+    putCard(&writer, obj);
+
+    (*data) = buf;
+    (*len) = writer.len;
+    return OK;
+}
+
+VCardErrorCode writeCardBinary(const char* fileName, const Card* obj)
+{
+    if (fileName == NULL) return WRITE_ERROR;
+
+    void* buf;
+    size_t len;
+    if (encodeCardBinary(obj, &buf, &len) != OK) return WRITE_ERROR;
+
+    FILE* fptr = fopen(fileName, "wb");
+    if (fptr == NULL)
+    {
+        free(buf);
+        return WRITE_ERROR;
+    }
+
+    size_t written = fwrite(buf, 1, len, fptr);
+    int closeErr = fclose(fptr);
+    free(buf);
+
+    return (written == len && closeErr == 0) ? OK : WRITE_ERROR;
+}
+
+static uint32_t getVarint(BinaryReader* reader)
+{
+    uint32_t value = 0;
+
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (reader->pos == reader->end) break;
+
+        unsigned char byte = *reader->pos++;
+        if (shift == 28 && byte > 0x0F) break;
+
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+
+    reader->failed = true;
+    return 0;
+}
+
+//Strings are used in place: the payload was copied into the card's arena, NULs included
+static char* getString(BinaryReader* reader)
+{
+    uint32_t len = getVarint(reader);
+
+    if (reader->failed || (size_t)(reader->end - reader->pos) <= len || reader->pos[len] != '\0')
+    {
+        reader->failed = true;
+        return NULL;
+    }
+
+    char* str = (char*)reader->pos;
+    reader->pos += len + 1;
+    return str;
+}
+
+//Remaining counts from the header; a card that uses more than it declared is rejected
+typedef struct binaryBudget {
+    uint32_t parameters;
+    uint32_t values;
+} BinaryBudget;
+
+static VCardErrorCode getProperty(BinaryReader* reader, Card* card, BinaryBudget* budget, Property** result)
+{
+    CardArena* arena = card->arena;
+
+    char* group = getString(reader);
+    char* name = getString(reader);
+    if (reader->failed) return INV_CARD;
+
+    Property* prop = (Property*)cardAlloc(card, sizeof(Property));
+    if (prop == NULL) return OTHER_ERROR;
+
+    prop->group = group;
+    prop->name = name;
+    prop->kind = propertyKind(name, strlen(name));
+    prop->parameters = NULL;
+    prop->values = NULL;
+
+    //Lists are created once their counts are known, so their arrays are exactly full
+    uint32_t paramCount = getVarint(reader);
+    if (reader->failed || paramCount > budget->parameters) return INV_CARD;
+    budget->parameters -= paramCount;
+
+    prop->parameters = createCardList(arena, paramCount, &parameterToString, &deleteParameter, &compareParameters);
+    if (prop->parameters == NULL) return OTHER_ERROR;
+
+    for (uint32_t i = 0; i < paramCount; i++)
+    {
+        char* paramName = getString(reader);
+        char* value = getString(reader);
+        if (reader->failed) return INV_CARD;
+
+        Parameter* param = (Parameter*)cardAlloc(card, sizeof(Parameter));
+        if (param == NULL) return OTHER_ERROR;
+
+        param->name = paramName;
+        param->value = value;
+
+        insertBack(prop->parameters, param);
+    }
+
+    uint32_t valueCount = getVarint(reader);
+    if (reader->failed || valueCount > budget->values) return INV_CARD;
+    budget->values -= valueCount;
+
+    prop->values = createCardList(arena, valueCount, &valueToString, &deleteValue, &compareValues);
+    if (prop->values == NULL) return OTHER_ERROR;
+
+    for (uint32_t i = 0; i < valueCount; i++)
+    {
+        char* value = getString(reader);
+        if (reader->failed) return INV_CARD;
+
+        insertBack(prop->values, value);
+    }
+
+    *result = prop;
+    return OK;
+}
+
+static VCardErrorCode getDate(BinaryReader* reader, Card* card, DateTime** result)
+{
+    uint32_t flags = getVarint(reader);
+    char* date = getString(reader);
+    char* time = getString(reader);
+    char* text = getString(reader);
+    if (reader->failed) return INV_CARD;
+
+    DateTime* dt = (DateTime*)cardAlloc(card, sizeof(DateTime));
+    if (dt == NULL) return OTHER_ERROR;
+
+    dt->UTC = (flags & DATE_UTC) != 0;
+    dt->isText = (flags & DATE_TEXT) != 0;
+    dt->date = date;
+    dt->time = time;
+    dt->text = text;
+
+    *result = dt;
+    return OK;
+}
+
+//Arena space for a card with these counts, the payload copy included
+static size_t binaryArenaSize(size_t payload, size_t properties, size_t parameters, size_t values)
+{
+    //A list and its array are one allocation; the slack covers rounding it up
+    size_t list = arenaSizeFor(sizeof(List) + sizeof(void*)) + sizeof(max_align_t);
+    size_t item = sizeof(void*);
+
+    //fn and both dates included; optionalProperties doubles as it grows, 3 slots per property cover it
+    return arenaSizeFor(sizeof(Card)) + list + arenaSizeFor(CARD_PROPERTY_CAPACITY * sizeof(void*))
+        + (properties + 1) * (arenaSizeFor(sizeof(Property)) + 2 * list + 3 * item)
+        + parameters * (arenaSizeFor(sizeof(Parameter)) + item)
+        + values * item
+        + 2 * arenaSizeFor(sizeof(DateTime))
+        + arenaSizeFor(payload);
+}
+
+static VCardErrorCode getCard(BinaryReader* reader, uint32_t properties, BinaryBudget* budget, uint32_t flags, Card* card)
+{
+    VCardErrorCode err = getProperty(reader, card, budget, &card->fn);
+    if (err != OK) return err;
+
+    for (uint32_t i = 0; i < properties; i++)
+    {
+        Property* prop = NULL;
+        err = getProperty(reader, card, budget, &prop);
+        if (err != OK) return err;
+
+        insertBack(card->optionalProperties, prop);
+    }
+
+    if (flags & HAS_BIRTHDAY)
+    {
+        err = getDate(reader, card, &card->birthday);
+        if (err != OK) return err;
+    }
+
+    if (flags & HAS_ANNIVERSARY)
+    {
+        err = getDate(reader, card, &card->anniversary);
+        if (err != OK) return err;
+    }
+
+    if (reader->pos != reader->end || budget->parameters != 0 || budget->values != 0) return INV_CARD;
+
+    return OK;
+}
+
+VCardErrorCode readCardBinaryFromBuffer(const void* data, size_t len, Card** obj)
+{
+    (*obj) = NULL;
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    if (bytes == NULL || len < BINARY_HEADER_SIZE || memcmp(bytes, BINARY_MAGIC, 4) != 0) return INV_FILE;
+    if (loadU32(bytes + 4) != BINARY_CARD_VERSION) return INV_FILE;
+
+    size_t payload = loadU32(bytes + 8);
+    uint32_t properties = loadU32(bytes + 12);
+    BinaryBudget budget = {loadU32(bytes + 16), loadU32(bytes + 20)};
+    uint32_t flags = loadU32(bytes + 24);
+
+    //Every property takes at least 6 bytes, every parameter 4 and every value 2
+    if (payload != len - BINARY_HEADER_SIZE) return INV_CARD;
+    if ((uint64_t)properties * 6 + (uint64_t)budget.parameters * 4 + (uint64_t)budget.values * 2 > payload) return INV_CARD;
+
+    CardArena* arena = createArena(binaryArenaSize(payload, properties, budget.parameters, budget.values));
+    if (arena == NULL) return OTHER_ERROR;
+
+    Card* card = initializeCardWithArena(arena);
+    if (card == NULL)
+    {
+        freeArena(arena);
+        return OTHER_ERROR;
+    }
+
+    //One copy of the payload, every string of the card points into it
+    unsigned char* copy = (unsigned char*)arenaAlloc(arena, payload);
+    if (copy == NULL)
+    {
+        deleteCard(card);
+        return OTHER_ERROR;
+    }
+    memcpy(copy, bytes + BINARY_HEADER_SIZE, payload);
+
+    BinaryReader reader = {copy, copy + payload, false};
+
+    VCardErrorCode err = getCard(&reader, properties, &budget, flags, card);
+    if (err != OK)
+    {
+        deleteCard(card);
+        return err;
+    }
+
+    (*obj) = card;
+    return OK;
+}
+
+VCardErrorCode readCardBinary(const char* fileName, Card** obj)
+{
+    (*obj) = NULL;
+
+    if (fileName == NULL) return INV_FILE;
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd == -1) return INV_FILE;
+
+    //Most cards fit the buffer, a short read means the whole file is in
+    unsigned char buf[BINARY_READ_BUFFER];
+    ssize_t got = read(fd, buf, sizeof(buf));
+
+    if (got < 0)
+    {
+        close(fd);
+        return INV_FILE;
+    }
+
+    if ((size_t)got < sizeof(buf))
+    {
+        close(fd);
+        return readCardBinaryFromBuffer(buf, (size_t)got, obj);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        close(fd);
+        return INV_FILE;
+    }
+
+    size_t len = (size_t)info.st_size;
+
+    void* data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) return INV_FILE;
+
+    VCardErrorCode err = readCardBinaryFromBuffer(data, len, obj);
+
+    munmap(data, len);
+    return err;
+}
@@ -0,0 +1,178 @@
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+#include "VCValidate.h"
+#include "VCBuffer.h"
+
+
+void initBufferReader(BufferReader* reader, const char* data, size_t len)
+{
+    reader->pos = data;
+    reader->end = data + len;
+    reader->scratch = NULL;
+    reader->scratchSize = 0;
+}
+
+//Physical line at reader->pos without its CRLF, advances past the line ending
+static void physicalLine(BufferReader* reader, const char** line, size_t* len)
+{
+    const char* start = reader->pos;
+    const char* newline = memchr(start, '\n', reader->end - start);
+    const char* lineEnd = (newline != NULL) ? newline : reader->end;
+
+    reader->pos = (newline != NULL) ? newline + 1 : reader->end;
+
+    if (lineEnd > start && lineEnd[-1] == '\r') lineEnd--;
+
+    *line = start;
+    *len = lineEnd - start;
+}
+
+static bool isFolded(const BufferReader* reader)
+{
+    return reader->pos < reader->end && (*reader->pos == ' ' || *reader->pos == '\t');
+}
+
+static bool appendScratch(BufferReader* reader, size_t used, const char* data, size_t len)
+{
+    if (used + len > reader->scratchSize)
+    {
+        size_t newSize = (reader->scratchSize == 0) ? 128 : reader->scratchSize;
+        while (newSize < used + len) newSize *= 2;
+
+        char* tmp = (char*)realloc(reader->scratch, newSize);
+        if (tmp == NULL) return false;
+
+        reader->scratch = tmp;
+        reader->scratchSize = newSize;
+    }
+
+    memcpy(reader->scratch + used, data, len);
+    return true;
+}
+
+bool nextBufferLine(BufferReader* reader, const char** line, size_t* len)
+{
+    if (reader->pos >= reader->end) return false;
+
+    physicalLine(reader, line, len);
+    if (!isFolded(reader)) return true;
+
+    size_t used = 0;
+    if (!appendScratch(reader, used, *line, *len)) return false;
+    used += *len;
+
+    while (isFolded(reader))
+    {
+        const char* part;
+        size_t partLen;
+        physicalLine(reader, &part, &partLen);
+
+        //Same as removeSpace, all leading whitespace of the continuation goes
+        while (partLen > 0 && (*part == ' ' || *part == '\t'))
+        {
+            part++;
+            partLen--;
+        }
+
+        if (!appendScratch(reader, used, part, partLen)) return false;
+        used += partLen;
+    }
+
+    *line = reader->scratch;
+    *len = used;
+    return true;
+}
+
+void freeBufferReader(BufferReader* reader)
+{
+    free(reader->scratch);
+    reader->scratch = NULL;
+    reader->scratchSize = 0;
+}
+
+VCardErrorCode createCardFromBuffer(const char* data, size_t len, Card** obj)
+{
+    (*obj) = NULL;
+
+    if (data == NULL && len > 0) return INV_FILE;
+
+    (*obj) = initializeCard(false);
+    if ((*obj) == NULL) return INV_CARD;
+
+    CardParser parser;
+    initCardParser(&parser, (*obj));
+
+    BufferReader reader;
+    initBufferReader(&reader, data, len);
+
+    const char* line;
+    size_t lineLen;
+    VCardErrorCode err = OK;
+
+    while (err == OK && nextBufferLine(&reader, &line, &lineLen))
+    {
+        err = parseCardLine(&parser, line, lineLen);
+    }
+
+    if (err == OK)
+    {
+        err = finishCardParser(&parser);
+    }
+
+    freeBufferReader(&reader);
+
+    if (err != OK)
+    {
+        deleteCard((*obj));
+        (*obj) = NULL;
+    }
+
+    return err;
+}
+
+VCardErrorCode createCardFromMappedFile(const char* fileName, Card** obj)
+{
+    (*obj) = NULL;
+
+    VCardErrorCode filenameErr = validateFileName(fileName);
+    if (filenameErr != OK) return filenameErr;
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd == -1) return INV_FILE;
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        close(fd);
+        return INV_FILE;
+    }
+
+    size_t len = (size_t)info.st_size;
+
+    //mmap cannot map an empty file
+    if (len == 0)
+    {
+        close(fd);
+        return createCardFromBuffer("", 0, obj);
+    }
+
+    void* data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) return INV_FILE;
+
+    madvise(data, len, MADV_SEQUENTIAL);
+
+    VCardErrorCode err = createCardFromBuffer((const char*)data, len, obj);
+
+    munmap(data, len);
+    return err;
+}
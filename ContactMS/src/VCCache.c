@@ -0,0 +1,422 @@
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCBinary.h"
+#include "VCCache.h"
+
+/*  File layout, integers little endian:
+        header      "VCCA", version, entry count, FNV-1a 64 checksum of everything after the header
+        entry       path length, path and a NUL, inode, mtime seconds, mtime nanoseconds,
+                    size, error code, card length, card
+    Sizes are 32 bit except inode, mtime seconds and size.
+*/
+#define CACHE_MAGIC "VCCA"
+#define CACHE_VERSION 1
+#define CACHE_HEADER_SIZE 20
+#define CACHE_ENTRY_FIXED 40
+
+typedef struct cacheReader {
+    unsigned char*  pos;
+    unsigned char*  end;
+    bool            failed;
+} CacheReader;
+
+static uint64_t checksum(const unsigned char* data, size_t len)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t hashPath(const char* path)
+{
+    return checksum((const unsigned char*)path, strlen(path));
+}
+
+static void storeLE(unsigned char* dest, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) dest[i] = (unsigned char)(value >> (8 * i));
+}
+
+static uint64_t loadLE(const unsigned char* src, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= (uint64_t)src[i] << (8 * i);
+    return value;
+}
+
+static uint64_t getLE(CacheReader* reader, int bytes)
+{
+    if (reader->end - reader->pos < bytes)
+    {
+        reader->failed = true;
+        return 0;
+    }
+
+    uint64_t value = loadLE(reader->pos, bytes);
+    reader->pos += bytes;
+    return value;
+}
+
+static unsigned char* getBytes(CacheReader* reader, size_t len)
+{
+    if ((size_t)(reader->end - reader->pos) < len)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+
+    unsigned char* bytes = reader->pos;
+    reader->pos += len;
+    return bytes;
+}
+
+static bool sameFile(const CacheEntry* entry, const struct stat* info)
+{
+    return entry->inode == (uint64_t)info->st_ino
+        && entry->mtimeSec == (int64_t)info->st_mtim.tv_sec
+        && entry->mtimeNsec == (uint32_t)info->st_mtim.tv_nsec
+        && entry->size == (uint64_t)info->st_size;
+}
+
+static void freeEntry(CacheEntry* entry)
+{
+    if (!entry->owned) return;
+
+    free(entry->path);
+    free((void*)entry->blob);
+}
+
+//Reads the cache file into cache->data and cache->old, false if it is missing or unusable
+static bool readCacheFile(CardCache* cache)
+{
+    int fd = open(cache->fileName, O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size < CACHE_HEADER_SIZE)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t len = (size_t)info.st_size;
+    cache->data = (unsigned char*)malloc(len);
+    if (cache->data == NULL)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = read(fd, cache->data + got, len - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+
+    unsigned char* data = cache->data;
+    if (got != len || memcmp(data, CACHE_MAGIC, 4) != 0 || loadLE(data + 4, 4) != CACHE_VERSION) return false;
+    if (loadLE(data + 12, 8) != checksum(data + CACHE_HEADER_SIZE, len - CACHE_HEADER_SIZE)) return false;
+
+    size_t count = (size_t)loadLE(data + 8, 4);
+    if (count > (len - CACHE_HEADER_SIZE) / CACHE_ENTRY_FIXED) return false;
+
+    cache->old = (CacheEntry*)calloc(count > 0 ? count : 1, sizeof(CacheEntry));
+    if (cache->old == NULL) return false;
+
+    CacheReader reader = {data + CACHE_HEADER_SIZE, data + len, false};
+
+    for (size_t i = 0; i < count; i++)
+    {
+        CacheEntry* entry = &cache->old[i];
+
+        size_t pathLen = (size_t)getLE(&reader, 4);
+        entry->path = (char*)getBytes(&reader, pathLen + 1);
+        entry->inode = getLE(&reader, 8);
+        entry->mtimeSec = (int64_t)getLE(&reader, 8);
+        entry->mtimeNsec = (uint32_t)getLE(&reader, 4);
+        entry->size = getLE(&reader, 8);
+        entry->err = (VCardErrorCode)getLE(&reader, 4);
+        entry->blobLen = (size_t)getLE(&reader, 4);
+        entry->blob = getBytes(&reader, entry->blobLen);
+        entry->owned = false;
+
+        if (reader.failed || entry->path[pathLen] != '\0' || entry->err > OTHER_ERROR) return false;
+        if (entry->err != OK) entry->blob = NULL;
+    }
+
+    if (reader.pos != reader.end) return false;
+
+    cache->oldCount = count;
+    return true;
+}
+
+static bool indexOldEntries(CardCache* cache)
+{
+    size_t slotCount = 16;
+    while (slotCount < cache->oldCount * 2) slotCount *= 2;
+
+    cache->slots = (size_t*)calloc(slotCount, sizeof(size_t));
+    if (cache->slots == NULL) return false;
+    cache->slotCount = slotCount;
+
+    //A path stored twice keeps its last entry
+    for (size_t i = 0; i < cache->oldCount; i++)
+    {
+        size_t slot = hashPath(cache->old[i].path) & (slotCount - 1);
+        while (cache->slots[slot] != 0 && strcmp(cache->old[cache->slots[slot] - 1].path, cache->old[i].path) != 0)
+        {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        cache->slots[slot] = i + 1;
+    }
+
+    return true;
+}
+
+static const CacheEntry* findOldEntry(const CardCache* cache, const char* path)
+{
+    size_t slot = hashPath(path) & (cache->slotCount - 1);
+
+    while (cache->slots[slot] != 0)
+    {
+        const CacheEntry* entry = &cache->old[cache->slots[slot] - 1];
+        if (strcmp(entry->path, path) == 0) return entry;
+        slot = (slot + 1) & (cache->slotCount - 1);
+    }
+
+    return NULL;
+}
+
+static bool addFreshEntry(CardCache* cache, const CacheEntry* entry)
+{
+    pthread_mutex_lock(&cache->freshLock);
+
+    if (cache->freshCount == cache->freshCapacity)
+    {
+        size_t capacity = (cache->freshCapacity == 0) ? 256 : cache->freshCapacity * 2;
+        CacheEntry* tmp = (CacheEntry*)realloc(cache->fresh, capacity * sizeof(CacheEntry));
+        if (tmp == NULL)
+        {
+            pthread_mutex_unlock(&cache->freshLock);
+            return false;
+        }
+        cache->fresh = tmp;
+        cache->freshCapacity = capacity;
+    }
+
+    cache->fresh[cache->freshCount++] = *entry;
+
+    pthread_mutex_unlock(&cache->freshLock);
+    return true;
+}
+
+VCardErrorCode openCardCache(const char* fileName, CardCache** cache)
+{
+    (*cache) = NULL;
+
+    if (fileName == NULL) return OTHER_ERROR;
+
+    CardCache* newCache = (CardCache*)calloc(1, sizeof(CardCache));
+    if (newCache == NULL) return OTHER_ERROR;
+
+    newCache->fileName = (char*)malloc(strlen(fileName) + 1);
+    if (newCache->fileName == NULL)
+    {
+        free(newCache);
+        return OTHER_ERROR;
+    }
+    strcpy(newCache->fileName, fileName);
+
+    pthread_mutex_init(&newCache->freshLock, NULL);
+    atomic_init(&newCache->hits, 0);
+    atomic_init(&newCache->misses, 0);
+
+    if (!readCacheFile(newCache))
+    {
+        //Start empty, whatever was wrong with the file
+        free(newCache->data);
+        free(newCache->old);
+        newCache->data = NULL;
+        newCache->old = NULL;
+        newCache->oldCount = 0;
+    }
+
+    if (!indexOldEntries(newCache))
+    {
+        closeCardCache(newCache);
+        return OTHER_ERROR;
+    }
+
+    (*cache) = newCache;
+    return OK;
+}
+
+bool cardCacheLookup(CardCache* cache, const char* path, const struct stat* info, VCardErrorCode* err, Card** card)
+{
+    (*card) = NULL;
+
+    const CacheEntry* entry = (cache != NULL && path != NULL) ? findOldEntry(cache, path) : NULL;
+
+    if (entry != NULL && sameFile(entry, info))
+    {
+        if (entry->err != OK || readCardBinaryFromBuffer(entry->blob, entry->blobLen, card) == OK)
+        {
+            //Carried over to the next save as is
+            addFreshEntry(cache, entry);
+
+            (*err) = entry->err;
+            atomic_fetch_add(&cache->hits, 1);
+            return true;
+        }
+    }
+
+    if (cache != NULL) atomic_fetch_add(&cache->misses, 1);
+    return false;
+}
+
+void cardCacheStore(CardCache* cache, const char* path, const struct stat* info, VCardErrorCode err, const Card* card)
+{
+    if (cache == NULL || path == NULL) return;
+
+    if (info->st_mtim.tv_sec + CACHE_RACY_SECONDS > time(NULL)) return;
+
+    CacheEntry entry;
+    entry.inode = (uint64_t)info->st_ino;
+    entry.mtimeSec = (int64_t)info->st_mtim.tv_sec;
+    entry.mtimeNsec = (uint32_t)info->st_mtim.tv_nsec;
+    entry.size = (uint64_t)info->st_size;
+    entry.err = err;
+    entry.blob = NULL;
+    entry.blobLen = 0;
+    entry.owned = true;
+
+    if (err == OK)
+    {
+        void* blob;
+        if (encodeCardBinary(card, &blob, &entry.blobLen) != OK) return;
+        entry.blob = blob;
+    }
+
+    entry.path = (char*)malloc(strlen(path) + 1);
+    if (entry.path == NULL)
+    {
+        free((void*)entry.blob);
+        return;
+    }
+    strcpy(entry.path, path);
+
+    if (!addFreshEntry(cache, &entry)) freeEntry(&entry);
+}
+
+VCardErrorCode saveCardCache(CardCache* cache)
+{
+    if (cache == NULL) return WRITE_ERROR;
+
+    pthread_mutex_lock(&cache->freshLock);
+
+    size_t len = CACHE_HEADER_SIZE;
+    for (size_t i = 0; i < cache->freshCount; i++)
+    {
+        len += CACHE_ENTRY_FIXED + strlen(cache->fresh[i].path) + 1 + cache->fresh[i].blobLen;
+    }
+
+    unsigned char* buf = (unsigned char*)malloc(len);
+    if (buf == NULL)
+    {
+        pthread_mutex_unlock(&cache->freshLock);
+        return WRITE_ERROR;
+    }
+
+    unsigned char* pos = buf + CACHE_HEADER_SIZE;
+    for (size_t i = 0; i < cache->freshCount; i++)
+    {
+        const CacheEntry* entry = &cache->fresh[i];
+        size_t pathLen = strlen(entry->path);
+
+        storeLE(pos, pathLen, 4);
+        memcpy(pos + 4, entry->path, pathLen + 1);
+        pos += 4 + pathLen + 1;
+
+        storeLE(pos, entry->inode, 8);
+        storeLE(pos + 8, (uint64_t)entry->mtimeSec, 8);
+        storeLE(pos + 16, entry->mtimeNsec, 4);
+        storeLE(pos + 20, entry->size, 8);
+        storeLE(pos + 28, (uint64_t)entry->err, 4);
+        storeLE(pos + 32, entry->blobLen, 4);
+        pos += 36;
+
+        if (entry->blobLen > 0) memcpy(pos, entry->blob, entry->blobLen);
+        pos += entry->blobLen;
+    }
+
+    memcpy(buf, CACHE_MAGIC, 4);
+    storeLE(buf + 4, CACHE_VERSION, 4);
+    storeLE(buf + 8, cache->freshCount, 4);
+    storeLE(buf + 12, checksum(buf + CACHE_HEADER_SIZE, len - CACHE_HEADER_SIZE), 8);
+
+    pthread_mutex_unlock(&cache->freshLock);
+
+    //Write next to the cache and rename, so a crash leaves either the old or the new cache
+    size_t tmpLen = strlen(cache->fileName) + 32;
+    char* tmpName = (char*)malloc(tmpLen);
+    if (tmpName == NULL)
+    {
+        free(buf);
+        return WRITE_ERROR;
+    }
+    snprintf(tmpName, tmpLen, "%s.%ld.tmp", cache->fileName, (long)getpid());
+
+    VCardErrorCode result = WRITE_ERROR;
+    int fd = open(tmpName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1)
+    {
+        size_t written = 0;
+        while (written < len)
+        {
+            ssize_t n = write(fd, buf + written, len - written);
+            if (n <= 0) break;
+            written += (size_t)n;
+        }
+
+        if (close(fd) == 0 && written == len && rename(tmpName, cache->fileName) == 0) result = OK;
+        else unlink(tmpName);
+    }
+
+    free(tmpName);
+    free(buf);
+    return result;
+}
+
+void cardCacheStats(CardCache* cache, long* hits, long* misses)
+{
+    (*hits) = (cache != NULL) ? atomic_load(&cache->hits) : 0;
+    (*misses) = (cache != NULL) ? atomic_load(&cache->misses) : 0;
+}
+
+void closeCardCache(CardCache* cache)
+{
+    if (cache == NULL) return;
+
+    for (size_t i = 0; i < cache->freshCount; i++) freeEntry(&cache->fresh[i]);
+
+    pthread_mutex_destroy(&cache->freshLock);
+    free(cache->fresh);
+    free(cache->slots);
+    free(cache->old);
+    free(cache->data);
+    free(cache->fileName);
+    free(cache);
+}
@@ -0,0 +1,483 @@
+#include <ctype.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCDates.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DATES_X86 1
+#endif
+
+//Longest each month can be, so February 29 is inside windows that reach it
+static const int monthLengths[13] = {0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+/*  What a query looks for: dates d with (d & mask) - lo[i] <= span[i], unsigned, for
+    either i, and d & need != 0. A query with one range repeats it in both.
+*/
+typedef struct dateFilter {
+    uint32_t mask;
+    uint32_t lo[2];
+    uint32_t span[2];
+    uint32_t need;
+} DateFilter;
+
+static bool digitsAt(const char* str, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isdigit((unsigned char)str[i])) return false;
+    }
+
+    return true;
+}
+
+static int twoDigits(const char* str)
+{
+    return (str[0] - '0') * 10 + (str[1] - '0');
+}
+
+uint32_t packDate(const DateTime* date)
+{
+    if (date == NULL || date->isText || date->date == NULL) return 0;
+
+    const char* str = date->date;
+    size_t len = strlen(str);
+    int year = 0, month = 0, day = 0;
+
+    if (len == 8 && digitsAt(str, 8))
+    {
+        year = twoDigits(str) * 100 + twoDigits(str + 2);
+        month = twoDigits(str + 4);
+        day = twoDigits(str + 6);
+    }
+    else if (len == 4 && digitsAt(str, 4))
+    {
+        year = twoDigits(str) * 100 + twoDigits(str + 2);
+    }
+    else if (len == 5 && strncmp(str, "---", 3) == 0 && digitsAt(str + 3, 2))
+    {
+        day = twoDigits(str + 3);
+    }
+    else if ((len == 4 || len == 6) && str[0] == '-' && str[1] == '-' && digitsAt(str + 2, len - 2))
+    {
+        month = twoDigits(str + 2);
+        if (len == 6) day = twoDigits(str + 4);
+    }
+    else if ((len == 7 || len == 10) && digitsAt(str, 4) && str[4] == '-' && digitsAt(str + 5, 2))
+    {
+        year = twoDigits(str) * 100 + twoDigits(str + 2);
+        month = twoDigits(str + 5);
+        if (len == 10)
+        {
+            if (str[7] != '-' || !digitsAt(str + 8, 2)) return 0;
+            day = twoDigits(str + 8);
+        }
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (month > 12 || day > 31) return 0;
+    if (month != 0 && day > monthLengths[month]) return 0;
+
+    return PACK_DATE(year, month, day);
+}
+
+uint32_t packTime(const DateTime* date)
+{
+    if (date == NULL) return 0;
+    if (date->isText) return DATE_PRESENT | DATE_IS_TEXT;
+
+    uint32_t flags = DATE_PRESENT;
+    if (date->UTC) flags |= DATE_UTC;
+
+    const char* str = date->time;
+    if (str == NULL || str[0] == '\0') return flags;
+
+    //HH, HHMM or HHMMSS; a leading '-' stands for each hour or minute left out
+    int parts[3] = {0, 0, 0};
+    int part = 0;
+    while (part < 3 && str[0] == '-')
+    {
+        part++;
+        str++;
+    }
+
+    while (part < 3 && digitsAt(str, 2))
+    {
+        parts[part++] = twoDigits(str);
+        str += 2;
+    }
+
+    if (parts[0] > 24 || parts[1] > 59 || parts[2] > 60) return flags;
+
+    return flags | DATE_HAS_TIME | (uint32_t)(parts[0] * 3600 + parts[1] * 60 + parts[2]);
+}
+
+static inline void addRow(uint32_t* rows, size_t capacity, size_t* count, size_t row)
+{
+    if (*count < capacity) rows[*count] = (uint32_t)row;
+    (*count)++;
+}
+
+//Appends the set bits of mask as row numbers from base
+static inline void addMask(uint32_t* rows, size_t capacity, size_t* count, size_t base, uint32_t mask)
+{
+    while (mask != 0)
+    {
+        addRow(rows, capacity, count, base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+static inline bool matches(const DateFilter* filter, uint32_t date)
+{
+    uint32_t x = date & filter->mask;
+
+    return ((x - filter->lo[0]) <= filter->span[0] || (x - filter->lo[1]) <= filter->span[1]) && (date & filter->need) != 0;
+}
+
+static size_t filterTail(const uint32_t* dates, size_t start, size_t n, const DateFilter* filter, uint32_t* rows, size_t capacity, size_t count)
+{
+    for (size_t i = start; i < n; i++)
+    {
+        if (matches(filter, dates[i])) addRow(rows, capacity, &count, i);
+    }
+
+    return count;
+}
+
+#ifdef DATES_X86
+
+//Lanes of each 8-bit match mask in order, so matching row numbers are written without a branch per match
+static uint8_t compressTable[256][8];
+
+//Writes base + each set lane of a 4-bit mask, branch free; rows must have room for 4 more
+static inline void addMask4(uint32_t* rows, size_t* count, size_t base, uint32_t mask)
+{
+    const uint8_t* lanes = compressTable[mask];
+    uint32_t* out = rows + *count;
+
+    out[0] = (uint32_t)base + lanes[0];
+    out[1] = (uint32_t)base + lanes[1];
+    out[2] = (uint32_t)base + lanes[2];
+    out[3] = (uint32_t)base + lanes[3];
+
+    (*count) += __builtin_popcount(mask);
+}
+
+//SSE2 has no unsigned compare, so both sides are offset by 2^31 and compared signed
+static size_t filterSSE2(const uint32_t* dates, size_t n, const DateFilter* filter, uint32_t* rows, size_t capacity)
+{
+    const __m128i sign = _mm_set1_epi32((int)0x80000000u);
+    const __m128i mask = _mm_set1_epi32((int)filter->mask);
+    const __m128i lo0 = _mm_set1_epi32((int)filter->lo[0]);
+    const __m128i lo1 = _mm_set1_epi32((int)filter->lo[1]);
+    const __m128i span0 = _mm_set1_epi32((int)(filter->span[0] ^ 0x80000000u));
+    const __m128i span1 = _mm_set1_epi32((int)(filter->span[1] ^ 0x80000000u));
+    const __m128i need = _mm_set1_epi32((int)filter->need);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i date = _mm_loadu_si128((const __m128i*)(dates + i));
+        __m128i x = _mm_and_si128(date, mask);
+
+        __m128i above0 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(x, lo0), sign), span0);
+        __m128i above1 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_sub_epi32(x, lo1), sign), span1);
+        __m128i missing = _mm_cmpeq_epi32(_mm_and_si128(date, need), zero);
+
+        __m128i miss = _mm_or_si128(_mm_and_si128(above0, above1), missing);
+
+        uint32_t hits = ~(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(miss)) & 0xF;
+
+        if (count + 4 <= capacity) addMask4(rows, &count, i, hits);
+        else addMask(rows, capacity, &count, i, hits);
+    }
+
+    return filterTail(dates, i, n, filter, rows, capacity, count);
+}
+
+__attribute__((target("avx2")))
+static size_t filterAVX2(const uint32_t* dates, size_t n, const DateFilter* filter, uint32_t* rows, size_t capacity)
+{
+    const __m256i mask = _mm256_set1_epi32((int)filter->mask);
+    const __m256i lo0 = _mm256_set1_epi32((int)filter->lo[0]);
+    const __m256i lo1 = _mm256_set1_epi32((int)filter->lo[1]);
+    const __m256i span0 = _mm256_set1_epi32((int)filter->span[0]);
+    const __m256i span1 = _mm256_set1_epi32((int)filter->span[1]);
+    const __m256i need = _mm256_set1_epi32((int)filter->need);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i dateA = _mm256_loadu_si256((const __m256i*)(dates + i));
+        __m256i dateB = _mm256_loadu_si256((const __m256i*)(dates + i + 8));
+        __m256i xA = _mm256_and_si256(dateA, mask);
+        __m256i xB = _mm256_and_si256(dateB, mask);
+
+        //x <= span unsigned exactly when min(x, span) == x
+        __m256i dA0 = _mm256_sub_epi32(xA, lo0);
+        __m256i dA1 = _mm256_sub_epi32(xA, lo1);
+        __m256i dB0 = _mm256_sub_epi32(xB, lo0);
+        __m256i dB1 = _mm256_sub_epi32(xB, lo1);
+
+        __m256i inA = _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_min_epu32(dA0, span0), dA0),
+                                      _mm256_cmpeq_epi32(_mm256_min_epu32(dA1, span1), dA1));
+        __m256i inB = _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_min_epu32(dB0, span0), dB0),
+                                      _mm256_cmpeq_epi32(_mm256_min_epu32(dB1, span1), dB1));
+
+        inA = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(dateA, need), zero), inA);
+        inB = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(dateB, need), zero), inB);
+
+        uint32_t hitsA = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(inA));
+        uint32_t hitsB = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(inB));
+
+        if (count + 16 <= capacity)
+        {
+            //Row numbers of all 8 lanes, the matching ones moved to the front; the rest is overwritten next
+            __m256i lanesA = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)compressTable[hitsA]));
+            _mm256_storeu_si256((__m256i*)(rows + count), _mm256_add_epi32(lanesA, _mm256_set1_epi32((int)i)));
+            count += __builtin_popcount(hitsA);
+
+            __m256i lanesB = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)compressTable[hitsB]));
+            _mm256_storeu_si256((__m256i*)(rows + count), _mm256_add_epi32(lanesB, _mm256_set1_epi32((int)(i + 8))));
+            count += __builtin_popcount(hitsB);
+        }
+        else
+        {
+            addMask(rows, capacity, &count, i, hitsA | (hitsB << 8));
+        }
+    }
+
+    //Leaving dirty upper halves makes every later SSE instruction in the process pay a transition penalty
+    _mm256_zeroupper();
+
+    return filterTail(dates, i, n, filter, rows, capacity, count);
+}
+
+static size_t (*filterImpl)(const uint32_t*, size_t, const DateFilter*, uint32_t*, size_t) = &filterSSE2;
+
+//Picks the widest filter the CPU supports when the library is loaded
+__attribute__((constructor))
+static void selectFilter(void)
+{
+    for (uint32_t mask = 0; mask < 256; mask++)
+    {
+        int n = 0;
+        for (uint32_t lane = 0; lane < 8; lane++)
+        {
+            if (mask & (1u << lane)) compressTable[mask][n++] = (uint8_t)lane;
+        }
+    }
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) filterImpl = &filterAVX2;
+}
+
+#else
+
+static size_t filterScalar(const uint32_t* dates, size_t n, const DateFilter* filter, uint32_t* rows, size_t capacity)
+{
+    return filterTail(dates, 0, n, filter, rows, capacity, 0);
+}
+
+static size_t (*filterImpl)(const uint32_t*, size_t, const DateFilter*, uint32_t*, size_t) = &filterScalar;
+
+#endif
+
+static size_t runFilter(const DateColumns* columns, DateField field, const DateFilter* filter, uint32_t* rows, size_t capacity)
+{
+    if (columns == NULL || (field != DATE_BIRTHDAY && field != DATE_ANNIVERSARY)) return 0;
+    if (rows == NULL) capacity = 0;
+
+    return filterImpl(columns->dates[field], columns->count, filter, rows, capacity);
+}
+
+static void setRange(DateFilter* filter, int i, uint32_t lo, uint32_t hi)
+{
+    filter->lo[i] = lo;
+    filter->span[i] = hi - lo;
+}
+
+VCardErrorCode createDateColumns(size_t capacity, DateColumns** columns)
+{
+    if (columns == NULL) return OTHER_ERROR;
+
+    (*columns) = (DateColumns*)calloc(1, sizeof(DateColumns));
+    if ((*columns) == NULL) return OTHER_ERROR;
+
+    if (capacity == 0) capacity = 16;
+
+    for (int f = 0; f < 2; f++)
+    {
+        (*columns)->dates[f] = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+        (*columns)->times[f] = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+
+        if ((*columns)->dates[f] == NULL || (*columns)->times[f] == NULL)
+        {
+            freeDateColumns(*columns);
+            (*columns) = NULL;
+            return OTHER_ERROR;
+        }
+    }
+
+    (*columns)->capacity = capacity;
+    return OK;
+}
+
+void freeDateColumns(DateColumns* columns)
+{
+    if (columns == NULL) return;
+
+    for (int f = 0; f < 2; f++)
+    {
+        free(columns->dates[f]);
+        free(columns->times[f]);
+    }
+
+    free(columns);
+}
+
+static bool reserveRows(DateColumns* columns, size_t rows)
+{
+    if (rows <= columns->capacity) return true;
+
+    size_t capacity = columns->capacity * 2;
+    if (capacity < rows) capacity = rows;
+
+    //Each column keeps its old contents if a later one fails, and capacity stays the smallest
+    for (int f = 0; f < 2; f++)
+    {
+        uint32_t* dates = (uint32_t*)realloc(columns->dates[f], capacity * sizeof(uint32_t));
+        if (dates == NULL) return false;
+        columns->dates[f] = dates;
+
+        uint32_t* times = (uint32_t*)realloc(columns->times[f], capacity * sizeof(uint32_t));
+        if (times == NULL) return false;
+        columns->times[f] = times;
+    }
+
+    columns->capacity = capacity;
+    return true;
+}
+
+VCardErrorCode setDateRow(DateColumns* columns, size_t row, const Card* card)
+{
+    if (columns == NULL || row >= UINT32_MAX) return OTHER_ERROR;
+    if (!reserveRows(columns, row + 1)) return OTHER_ERROR;
+
+    for (int f = 0; f < 2; f++)
+    {
+        for (size_t i = columns->count; i < row; i++)
+        {
+            columns->dates[f][i] = 0;
+            columns->times[f][i] = 0;
+        }
+    }
+
+    const DateTime* birthday = (card != NULL) ? card->birthday : NULL;
+    const DateTime* anniversary = (card != NULL) ? card->anniversary : NULL;
+
+    columns->dates[DATE_BIRTHDAY][row] = packDate(birthday);
+    columns->times[DATE_BIRTHDAY][row] = packTime(birthday);
+    columns->dates[DATE_ANNIVERSARY][row] = packDate(anniversary);
+    columns->times[DATE_ANNIVERSARY][row] = packTime(anniversary);
+
+    if (row >= columns->count) columns->count = row + 1;
+    return OK;
+}
+
+VCardErrorCode buildDateColumns(Card** cards, size_t count, DateColumns** columns)
+{
+    if (cards == NULL && count > 0) return OTHER_ERROR;
+
+    VCardErrorCode err = createDateColumns(count, columns);
+    if (err != OK) return err;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        setDateRow(*columns, i, cards[i]);
+    }
+
+    return OK;
+}
+
+size_t queryDateMonth(const DateColumns* columns, DateField field, int month, uint32_t* rows, size_t capacity)
+{
+    if (month < 1 || month > 12) return 0;
+
+    DateFilter filter = {PACK_DATE(0, 0xF, 0), {0, 0}, {0, 0}, UINT32_MAX};
+    setRange(&filter, 0, PACK_DATE(0, month, 0), PACK_DATE(0, month, 0));
+    setRange(&filter, 1, PACK_DATE(0, month, 0), PACK_DATE(0, month, 0));
+
+    return runFilter(columns, field, &filter, rows, capacity);
+}
+
+size_t queryDateWithin(const DateColumns* columns, DateField field, int month, int day, int days, uint32_t* rows, size_t capacity)
+{
+    if (month < 1 || month > 12 || day < 1 || day > monthLengths[month] || days < 1) return 0;
+
+    //Month and day, ignoring the year; dates without a day are left out by need
+    DateFilter filter = {PACK_DATE(0, 0xF, 0x1F), {0, 0}, {0, 0}, PACK_DATE(0, 0, 0x1F)};
+
+    if (days >= 366)
+    {
+        setRange(&filter, 0, PACK_DATE(0, 1, 1), PACK_DATE(0, 12, 31));
+        setRange(&filter, 1, PACK_DATE(0, 1, 1), PACK_DATE(0, 12, 31));
+        return runFilter(columns, field, &filter, rows, capacity);
+    }
+
+    int endMonth = month, endDay = day;
+    bool wrapped = false;
+
+    for (int left = days - 1; left > 0; )
+    {
+        int rest = monthLengths[endMonth] - endDay;
+        if (left <= rest)
+        {
+            endDay += left;
+            break;
+        }
+
+        left -= rest + 1;
+        endDay = 1;
+        if (++endMonth > 12)
+        {
+            endMonth = 1;
+            wrapped = true;
+        }
+    }
+
+    if (wrapped)
+    {
+        setRange(&filter, 0, PACK_DATE(0, month, day), PACK_DATE(0, 12, 31));
+        setRange(&filter, 1, PACK_DATE(0, 1, 1), PACK_DATE(0, endMonth, endDay));
+    }
+    else
+    {
+        setRange(&filter, 0, PACK_DATE(0, month, day), PACK_DATE(0, endMonth, endDay));
+        setRange(&filter, 1, PACK_DATE(0, month, day), PACK_DATE(0, endMonth, endDay));
+    }
+
+    return runFilter(columns, field, &filter, rows, capacity);
+}
+
+size_t queryDateBetween(const DateColumns* columns, DateField field, uint32_t from, uint32_t to, uint32_t* rows, size_t capacity)
+{
+    if (to < from) return 0;
+
+    DateFilter filter = {UINT32_MAX, {0, 0}, {0, 0}, UINT32_MAX};
+    setRange(&filter, 0, from, to);
+    setRange(&filter, 1, from, to);
+
+    return runFilter(columns, field, &filter, rows, capacity);
+}
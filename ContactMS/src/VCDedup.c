@@ -0,0 +1,555 @@
+#include <strings.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCDedup.h"
+
+//Digits of a phone number compared, so country prefixes and trunk zeros do not matter
+#define PHONE_DIGITS 10
+#define MIN_PHONE_DIGITS 7
+
+//Weight of a shared phone number in a score; households and offices share numbers
+#define PHONE_WEIGHT 0.5
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+//Kinds of blocking key, mixed into the key so an email and a name cannot collide
+enum {KEY_NAME = 1, KEY_EMAIL, KEY_PHONE};
+
+//Sorted, distinct hashes of a card's values: start and count in the hash pool
+typedef struct hashSet {
+    size_t  start;
+    int     count;
+} HashSet;
+
+typedef struct cardSignature {
+    HashSet names;
+    HashSet emails;
+    HashSet phones;
+} CardSignature;
+
+typedef struct blockKey {
+    uint64_t    key;
+    int         card;
+} BlockKey;
+
+typedef struct scoredPair {
+    double  score;
+    int     a;
+    int     b;
+} ScoredPair;
+
+//Growable arrays, so building the signatures of a million cards makes a handful of allocations
+typedef struct dedupState {
+    uint64_t*       hashes;
+    size_t          hashCount;
+    size_t          hashCapacity;
+
+    BlockKey*       keys;
+    size_t          keyCount;
+    size_t          keyCapacity;
+
+    ScoredPair*     pairs;
+    size_t          pairCount;
+    size_t          pairCapacity;
+
+    CardSignature*  signatures;
+} DedupState;
+
+static bool reserve(void** items, size_t* capacity, size_t needed, size_t size)
+{
+    if (needed <= *capacity) return true;
+
+    size_t newCapacity = (*capacity == 0) ? 1024 : *capacity;
+    while (newCapacity < needed) newCapacity *= 2;
+
+    void* tmp = realloc(*items, newCapacity * size);
+    if (tmp == NULL) return false;
+
+    (*items) = tmp;
+    (*capacity) = newCapacity;
+    return true;
+}
+
+static bool addHash(DedupState* state, uint64_t hash)
+{
+    if (!reserve((void**)&state->hashes, &state->hashCapacity, state->hashCount + 1, sizeof(uint64_t))) return false;
+
+    state->hashes[state->hashCount++] = hash;
+    return true;
+}
+
+static bool addKey(DedupState* state, uint64_t hash, int kind, int card)
+{
+    if (!reserve((void**)&state->keys, &state->keyCapacity, state->keyCount + 1, sizeof(BlockKey))) return false;
+
+    state->keys[state->keyCount].key = (hash ^ (uint64_t)kind) * FNV_PRIME;
+    state->keys[state->keyCount].card = card;
+    state->keyCount++;
+    return true;
+}
+
+static unsigned char foldByte(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+//Letters, digits and every byte of a multi-byte UTF-8 character
+static bool isWordByte(unsigned char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+static bool addNameWords(DedupState* state, const char* value)
+{
+    const unsigned char* p = (const unsigned char*)value;
+
+    while (*p != '\0')
+    {
+        while (*p != '\0' && !isWordByte(*p)) p++;
+
+        uint64_t hash = FNV_OFFSET;
+        int len = 0;
+        for (; isWordByte(*p); p++, len++)
+        {
+            hash = (hash ^ foldByte(*p)) * FNV_PRIME;
+        }
+
+        if (len > 1 && !addHash(state, hash)) return false;
+    }
+
+    return true;
+}
+
+static bool addEmail(DedupState* state, const char* value)
+{
+    const unsigned char* p = (const unsigned char*)value;
+
+    while (*p == ' ' || *p == '\t') p++;
+    if (strncasecmp((const char*)p, "mailto:", 7) == 0) p += 7;
+
+    const unsigned char* end = p + strlen((const char*)p);
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    if (end == p) return true;
+
+    uint64_t hash = FNV_OFFSET;
+    for (; p < end; p++)
+    {
+        hash = (hash ^ foldByte(*p)) * FNV_PRIME;
+    }
+
+    return addHash(state, hash);
+}
+
+static bool addPhone(DedupState* state, const char* value)
+{
+    char digits[PHONE_DIGITS];
+    int count = 0;
+
+    //A ring of the last PHONE_DIGITS digits
+    for (const char* p = value; *p != '\0'; p++)
+    {
+        if (*p >= '0' && *p <= '9') digits[count++ % PHONE_DIGITS] = *p;
+    }
+    if (count < MIN_PHONE_DIGITS) return true;
+
+    int kept = (count < PHONE_DIGITS) ? count : PHONE_DIGITS;
+
+    uint64_t hash = FNV_OFFSET;
+    for (int i = count - kept; i < count; i++)
+    {
+        hash = (hash ^ (unsigned char)digits[i % PHONE_DIGITS]) * FNV_PRIME;
+    }
+
+    return addHash(state, hash);
+}
+
+//Sorts the hashes added since start and drops repeats; a set is a few values, so insertion sort
+static HashSet closeSet(DedupState* state, size_t start)
+{
+    uint64_t* hashes = state->hashes + start;
+    size_t count = state->hashCount - start;
+
+    for (size_t i = 1; i < count; i++)
+    {
+        uint64_t hash = hashes[i];
+        size_t j = i;
+
+        for (; j > 0 && hashes[j - 1] > hash; j--) hashes[j] = hashes[j - 1];
+        hashes[j] = hash;
+    }
+
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (unique == 0 || hashes[unique - 1] != hashes[i]) hashes[unique++] = hashes[i];
+    }
+
+    state->hashCount = start + unique;
+
+    HashSet set = {start, (int)unique};
+    return set;
+}
+
+static bool buildSignature(DedupState* state, const Card* card, int index)
+{
+    CardSignature* sig = &state->signatures[index];
+    size_t start = state->hashCount;
+
+    if (card->fn != NULL && !addNameWords(state, (const char*)getFromFront(card->fn->values))) return false;
+
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property* prop;
+    while ((prop = (Property*)nextElement(&iter)) != NULL)
+    {
+        if (prop->kind == PROP_FN && !addNameWords(state, (const char*)getFromFront(prop->values))) return false;
+
+        if (prop->kind == PROP_N)
+        {
+            ListIterator values = createIterator(prop->values);
+            const char* value;
+            while ((value = (const char*)nextElement(&values)) != NULL)
+            {
+                if (!addNameWords(state, value)) return false;
+            }
+        }
+    }
+    sig->names = closeSet(state, start);
+
+    start = state->hashCount;
+    iter = createIterator(card->optionalProperties);
+    while ((prop = (Property*)nextElement(&iter)) != NULL)
+    {
+        if (prop->kind == PROP_EMAIL && !addEmail(state, (const char*)getFromFront(prop->values))) return false;
+    }
+    sig->emails = closeSet(state, start);
+
+    start = state->hashCount;
+    iter = createIterator(card->optionalProperties);
+    while ((prop = (Property*)nextElement(&iter)) != NULL)
+    {
+        if (prop->kind == PROP_TEL && !addPhone(state, (const char*)getFromFront(prop->values))) return false;
+    }
+    sig->phones = closeSet(state, start);
+
+    return true;
+}
+
+static bool addBlockKeys(DedupState* state, int index)
+{
+    const CardSignature* sig = &state->signatures[index];
+
+    //The name key is the whole set of words, so word order and N versus FN do not matter
+    if (sig->names.count > 0)
+    {
+        uint64_t hash = FNV_OFFSET;
+        for (int i = 0; i < sig->names.count; i++)
+        {
+            hash = (hash ^ state->hashes[sig->names.start + i]) * FNV_PRIME;
+        }
+        if (!addKey(state, hash, KEY_NAME, index)) return false;
+    }
+
+    for (int i = 0; i < sig->emails.count; i++)
+    {
+        if (!addKey(state, state->hashes[sig->emails.start + i], KEY_EMAIL, index)) return false;
+    }
+    for (int i = 0; i < sig->phones.count; i++)
+    {
+        if (!addKey(state, state->hashes[sig->phones.start + i], KEY_PHONE, index)) return false;
+    }
+
+    return true;
+}
+
+//Size of the intersection of two sorted sets
+static int sharedHashes(const DedupState* state, HashSet a, HashSet b)
+{
+    const uint64_t* x = state->hashes + a.start;
+    const uint64_t* y = state->hashes + b.start;
+    int i = 0, j = 0, shared = 0;
+
+    while (i < a.count && j < b.count)
+    {
+        if (x[i] < y[j]) i++;
+        else if (x[i] > y[j]) j++;
+        else
+        {
+            shared++;
+            i++;
+            j++;
+        }
+    }
+
+    return shared;
+}
+
+static double scorePair(const DedupState* state, int first, int second)
+{
+    const CardSignature* a = &state->signatures[first];
+    const CardSignature* b = &state->signatures[second];
+
+    int sharedNames = sharedHashes(state, a->names, b->names);
+    int unionNames = a->names.count + b->names.count - sharedNames;
+
+    double score = (unionNames > 0) ? (double)sharedNames / unionNames : 0;
+    double weight = 1;
+
+    if (a->emails.count > 0 && b->emails.count > 0)
+    {
+        score += (sharedHashes(state, a->emails, b->emails) > 0) ? 1 : 0;
+        weight += 1;
+    }
+    if (a->phones.count > 0 && b->phones.count > 0)
+    {
+        score += (sharedHashes(state, a->phones, b->phones) > 0) ? PHONE_WEIGHT : 0;
+        weight += PHONE_WEIGHT;
+    }
+
+    return score / weight;
+}
+
+/*  LSD radix sort of the keys, 16 bits per pass. Keys are added in card order and every
+    pass is stable, so cards stay in increasing order within a block. A few times faster
+    than qsort on millions of keys.
+*/
+static bool sortKeys(DedupState* state)
+{
+    BlockKey* buffer = (BlockKey*)malloc((state->keyCount + 1) * sizeof(BlockKey));
+    size_t* counts = (size_t*)malloc(65536 * sizeof(size_t));
+    if (buffer == NULL || counts == NULL)
+    {
+        free(buffer);
+        free(counts);
+        return false;
+    }
+
+    BlockKey* from = state->keys;
+    BlockKey* to = buffer;
+
+    for (int shift = 0; shift < 64; shift += 16)
+    {
+        memset(counts, 0, 65536 * sizeof(size_t));
+        for (size_t i = 0; i < state->keyCount; i++)
+        {
+            counts[(from[i].key >> shift) & 0xFFFF]++;
+        }
+
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 65536; digit++)
+        {
+            size_t count = counts[digit];
+            counts[digit] = offset;
+            offset += count;
+        }
+
+        for (size_t i = 0; i < state->keyCount; i++)
+        {
+            to[counts[(from[i].key >> shift) & 0xFFFF]++] = from[i];
+        }
+
+        BlockKey* tmp = from;
+        from = to;
+        to = tmp;
+    }
+
+    //An even number of passes leaves the result in state->keys
+    free(buffer);
+    free(counts);
+    return true;
+}
+
+//Highest score first, so clusters are joined through their strongest pairs
+static int comparePairs(const void* first, const void* second)
+{
+    const ScoredPair* a = (const ScoredPair*)first;
+    const ScoredPair* b = (const ScoredPair*)second;
+
+    if (a->score != b->score) return (a->score < b->score) - (a->score > b->score);
+    if (a->a != b->a) return (a->a > b->a) - (a->a < b->a);
+    return (a->b > b->b) - (a->b < b->b);
+}
+
+//Scores each card of every block against the DEDUP_WINDOW cards after it
+static bool scoreBlocks(DedupState* state, double threshold)
+{
+    size_t start = 0;
+
+    while (start < state->keyCount)
+    {
+        size_t end = start + 1;
+        while (end < state->keyCount && state->keys[end].key == state->keys[start].key) end++;
+
+        for (size_t i = start; i < end; i++)
+        {
+            for (size_t j = i + 1; j < end && j <= i + DEDUP_WINDOW; j++)
+            {
+                int a = state->keys[i].card;
+                int b = state->keys[j].card;
+
+                double score = scorePair(state, a, b);
+                if (score < threshold) continue;
+
+                if (!reserve((void**)&state->pairs, &state->pairCapacity, state->pairCount + 1, sizeof(ScoredPair))) return false;
+
+                ScoredPair pair = {score, a, b};
+                state->pairs[state->pairCount++] = pair;
+            }
+        }
+
+        start = end;
+    }
+
+    return true;
+}
+
+static int findRoot(int* parents, int x)
+{
+    while (parents[x] != x)
+    {
+        parents[x] = parents[parents[x]];
+        x = parents[x];
+    }
+
+    return x;
+}
+
+//Union-find over the pairs, strongest first; a cluster's score is that of the pair that completed it
+static DuplicateReport* buildReport(DedupState* state, int count)
+{
+    int* parents = (int*)malloc((count + 1) * sizeof(int));
+    int* sizes = (int*)malloc((count + 1) * sizeof(int));
+    double* scores = (double*)malloc((count + 1) * sizeof(double));
+    int* slots = (int*)malloc((count + 1) * sizeof(int));
+    DuplicateReport* report = (DuplicateReport*)calloc(1, sizeof(DuplicateReport));
+
+    if (parents == NULL || sizes == NULL || scores == NULL || slots == NULL || report == NULL)
+    {
+        free(parents);
+        free(sizes);
+        free(scores);
+        free(slots);
+        free(report);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        parents[i] = i;
+        sizes[i] = 1;
+        scores[i] = 1;
+        slots[i] = -1;
+    }
+
+    if (state->pairCount > 1) qsort(state->pairs, state->pairCount, sizeof(ScoredPair), &comparePairs);
+
+    for (size_t i = 0; i < state->pairCount; i++)
+    {
+        int a = findRoot(parents, state->pairs[i].a);
+        int b = findRoot(parents, state->pairs[i].b);
+        if (a == b) continue;
+
+        if (sizes[a] < sizes[b])
+        {
+            int tmp = a;
+            a = b;
+            b = tmp;
+        }
+
+        parents[b] = a;
+        sizes[a] += sizes[b];
+        scores[a] = state->pairs[i].score;
+    }
+
+    //A cluster has at least 2 members, so count / 2 clusters is the most there can be
+    report->clusters = (DuplicateCluster*)malloc((count / 2 + 1) * sizeof(DuplicateCluster));
+    report->members = (int*)malloc((count + 1) * sizeof(int));
+
+    if (report->clusters != NULL && report->members != NULL)
+    {
+        //Clusters are numbered in the order of their first member, and get their members in increasing order
+        for (int i = 0; i < count; i++)
+        {
+            int root = findRoot(parents, i);
+            if (sizes[root] < 2) continue;
+
+            if (slots[root] < 0)
+            {
+                DuplicateCluster* cluster = &report->clusters[report->clusterCount];
+                cluster->first = report->memberCount;
+                cluster->count = 0;
+                cluster->score = scores[root];
+
+                slots[root] = report->clusterCount++;
+                report->memberCount += sizes[root];
+            }
+
+            DuplicateCluster* cluster = &report->clusters[slots[root]];
+            report->members[cluster->first + cluster->count++] = i;
+        }
+
+        DuplicateCluster* clusters = (DuplicateCluster*)realloc(report->clusters, (report->clusterCount + 1) * sizeof(DuplicateCluster));
+        if (clusters != NULL) report->clusters = clusters;
+    }
+    else
+    {
+        freeDuplicateReport(report);
+        report = NULL;
+    }
+
+    free(parents);
+    free(sizes);
+    free(scores);
+    free(slots);
+
+    return report;
+}
+
+VCardErrorCode findDuplicateCards(Card** cards, int count, double threshold, DuplicateReport** report)
+{
+    if (report == NULL) return OTHER_ERROR;
+    (*report) = NULL;
+
+    if ((cards == NULL && count > 0) || count < 0) return OTHER_ERROR;
+
+    DedupState state;
+    memset(&state, 0, sizeof(DedupState));
+
+    state.signatures = (CardSignature*)calloc(count + 1, sizeof(CardSignature));
+    bool ok = state.signatures != NULL;
+
+    for (int i = 0; i < count && ok; i++)
+    {
+        if (cards[i] == NULL) continue;
+
+        ok = buildSignature(&state, cards[i], i) && addBlockKeys(&state, i);
+    }
+
+    if (ok)
+    {
+        ok = sortKeys(&state) && scoreBlocks(&state, threshold);
+    }
+
+    if (ok)
+    {
+        (*report) = buildReport(&state, count);
+        ok = (*report) != NULL;
+    }
+
+    free(state.hashes);
+    free(state.keys);
+    free(state.pairs);
+    free(state.signatures);
+
+    return ok ? OK : OTHER_ERROR;
+}
+
+void freeDuplicateReport(DuplicateReport* report)
+{
+    if (report == NULL) return;
+
+    free(report->clusters);
+    free(report->members);
+    free(report);
+}
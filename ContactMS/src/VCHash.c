@@ -0,0 +1,192 @@
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHash.h"
+
+/*  Multiply-fold hashing as in wyhash: each step multiplies two 64-bit words into 128 bits
+    and folds the halves, taking 16 bytes of input per step. Every string is hashed with
+    its length and every list with its count, so the same bytes split differently, or a
+    value moved between lists, hash differently.
+*/
+
+#define SECRET0 0xa0761d6478bd642fULL
+#define SECRET1 0xe7037ed1a0b428dbULL
+#define SECRET2 0x8ebc6af09c88c6e3ULL
+#define SECRET3 0x589965cc75374cc3ULL
+
+//Marks absent parts, so a NULL string or date differs from an empty one
+#define ABSENT 0xffffffffffffffffULL
+
+static inline uint64_t mix(uint64_t a, uint64_t b)
+{
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+//Little-endian reads byte by byte, so the hash does not depend on alignment; compilers make them one load
+static inline uint64_t read64(const unsigned char* p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline uint64_t read32(const unsigned char* p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24);
+}
+
+static inline uint64_t hashWord(uint64_t h, uint64_t word)
+{
+    return mix(h ^ SECRET0, word ^ SECRET1);
+}
+
+/*  Strings of up to 16 bytes, most property values and all names, are read as a few
+    overlapping loads instead of byte by byte. The reads may cover some bytes twice;
+    the length, mixed in with them, keeps strings of different lengths apart.
+*/
+static uint64_t hashString(uint64_t h, const char* str)
+{
+    if (str == NULL) return hashWord(h, ABSENT);
+
+    const unsigned char* p = (const unsigned char*)str;
+    size_t len = strlen(str);
+    uint64_t a, b;
+
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            size_t step = (len >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + step);
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - step);
+        }
+        else if (len > 0)
+        {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+        {
+            a = 0;
+            b = 0;
+        }
+    }
+    else
+    {
+        size_t left = len;
+        for (; left > 16; p += 16, left -= 16)
+        {
+            h = mix(read64(p) ^ SECRET2, read64(p + 8) ^ h);
+        }
+
+        //The last 16 bytes, overlapping the last block if the length is not a multiple of 16
+        a = read64(p + left - 16);
+        b = read64(p + left - 8);
+    }
+
+    return mix(a ^ SECRET2 ^ len, b ^ h ^ SECRET3);
+}
+
+static uint64_t hashValues(uint64_t h, const List* values)
+{
+    if (values == NULL) return hashWord(h, ABSENT);
+
+    h = hashWord(h, (uint64_t)values->length);
+
+    ListIterator iter = createIterator((List*)values);
+    const char* value;
+    while ((value = (const char*)nextElement(&iter)) != NULL)
+    {
+        h = hashString(h, value);
+    }
+
+    return h;
+}
+
+static uint64_t hashParameters(uint64_t h, const List* parameters)
+{
+    if (parameters == NULL) return hashWord(h, ABSENT);
+
+    h = hashWord(h, (uint64_t)parameters->length);
+
+    ListIterator iter = createIterator((List*)parameters);
+    const Parameter* param;
+    while ((param = (const Parameter*)nextElement(&iter)) != NULL)
+    {
+        h = hashString(h, param->name);
+        h = hashString(h, param->value);
+    }
+
+    return h;
+}
+
+static uint64_t hashProperty(uint64_t h, const Property* prop)
+{
+    if (prop == NULL) return hashWord(h, ABSENT);
+
+    h = hashString(h, prop->name);
+    h = hashString(h, prop->group);
+    h = hashParameters(h, prop->parameters);
+    return hashValues(h, prop->values);
+}
+
+static uint64_t hashDate(uint64_t h, const DateTime* date)
+{
+    if (date == NULL) return hashWord(h, ABSENT);
+
+    h = hashWord(h, ((uint64_t)date->UTC << 1) | (uint64_t)date->isText);
+    h = hashString(h, date->date);
+    h = hashString(h, date->time);
+    return hashString(h, date->text);
+}
+
+uint64_t cardHash(const Card* obj)
+{
+    uint64_t h = SECRET3;
+
+    if (obj == NULL)
+    {
+        h = hashWord(h, ABSENT);
+    }
+    else
+    {
+        h = hashProperty(h, obj->fn);
+
+        const List* props = obj->optionalProperties;
+        if (props == NULL)
+        {
+            h = hashWord(h, ABSENT);
+        }
+        else
+        {
+            h = hashWord(h, (uint64_t)props->length);
+
+            ListIterator iter = createIterator((List*)props);
+            const Property* prop;
+            while ((prop = (const Property*)nextElement(&iter)) != NULL)
+            {
+                h = hashProperty(h, prop);
+            }
+        }
+
+        h = hashDate(h, obj->birthday);
+        h = hashDate(h, obj->anniversary);
+    }
+
+    h = mix(h ^ SECRET1, SECRET2);
+
+    //0 means "not computed" in Card.hash
+    return (h != 0) ? h : 1;
+}
+
+uint64_t getCardHash(Card* obj)
+{
+    if (obj == NULL) return 0;
+
+    if (obj->hash == 0) obj->hash = cardHash(obj);
+    return obj->hash;
+}
+
+void invalidateCardHash(Card* obj)
+{
+    if (obj != NULL) obj->hash = 0;
+}
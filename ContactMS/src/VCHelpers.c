@@ -3,342 +3,556 @@
 #include "VCHelpers.h"
 #include "VCValidate.h"
 
+#include <ctype.h>
 
-VCardErrorCode createProperty(Property* prop, const char* propStr)
+
+//Arena cards take all their memory from the arena, heap cards from malloc
+static void* allocate(CardArena* arena, size_t size)
+{
+    return (arena != NULL) ? arenaAlloc(arena, size) : malloc(size);
+}
+
+void* cardAlloc(Card* card, size_t size)
+{
+    return allocate(card->arena, size);
+}
+
+//Arena memory is only released by freeArena
+static void deleteNothing(void* toBeDeleted)
+{
+}
+
+List* createCardList(CardArena* arena, int capacity, char* (*printFunction)(void*), void (*deleteFunction)(void*), int (*compareFunction)(const void*, const void*))
+{
+    if (arena == NULL) return initializeArrayList(printFunction, deleteFunction, compareFunction, capacity, NULL);
+
+    return initializeArrayList(printFunction, &deleteNothing, compareFunction, capacity, &arena->listAllocator);
+}
+
+//Copies len bytes of start into a new NUL terminated string
+char* copySpan(CardArena* arena, const char* start, size_t len)
 {
-    prop->name = (char*)malloc(sizeof(char) * 1);
-    prop->name[0] = '\0';
-    prop->group = (char*)malloc(sizeof(char) * 1);
-    prop->group[0] = '\0';
+    char* str = (char*)allocate(arena, len + 1);
+    if (str == NULL) return NULL;
+
+    memcpy(str, start, len);
+    str[len] = '\0';
 
-    prop->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
-    prop->values = initializeList(&valueToString, &deleteValue, &compareValues);
+    return str;
+}
+
+//Names and common values come from the intern table, with a private copy as fallback
+char* internSpan(CardArena* arena, const char* start, size_t len)
+{
+    const char* shared = internString(start, len);
+    if (shared != NULL) return (char*)shared;
 
-    char* copy = (char*)malloc(strlen(propStr) + 1);
-    if (copy == NULL) return OTHER_ERROR;
+    return copySpan(arena, start, len);
+}
 
-    strcpy(copy, propStr);
+//Parameters whose values come from a small vocabulary ("work", "cell", "uri", "1", ...)
+static bool hasCommonValues(const char* name, size_t len)
+{
+    static const char* const names[] = {"TYPE", "VALUE", "PREF", "CALSCALE", "ENCODING", "CHARSET"};
 
-    //Split group.name;params : values
-    const char* splitPos = strchr(copy, ':');
-    if (splitPos == NULL)
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
     {
-        free(copy);
-        return INV_PROP;
-    }   
+        if (strlen(names[i]) != len) continue;
 
-    //group.name;params
-    size_t mixedSize = (size_t)(splitPos - copy);
-    char* mixedStr = (char*)malloc(mixedSize + 1);
-    if (mixedStr == NULL)
+        size_t j = 0;
+        while (j < len && toupper((unsigned char)name[j]) == names[i][j]) j++;
+        if (j == len) return true;
+    }
+
+    return false;
+}
+
+static bool containsSpan(const char* str, size_t len, const char* needle)
+{
+    size_t needleLen = strlen(needle);
+
+    for (size_t i = 0; i + needleLen <= len; i++)
     {
-        free(copy);
-        return OTHER_ERROR;
+        if (memcmp(str + i, needle, needleLen) == 0) return true;
     }
-    strncpy(mixedStr, copy, mixedSize + 1);
-    mixedStr[mixedSize] = '\0';
 
-    //group.
-    const char* endOfGroup = strchr(mixedStr, '.');
-    const char* endOfName = strchr(mixedStr, ';');
+    return false;
+}
+
+/*  The create functions work on (pointer, length) spans so that lines can be parsed
+    straight out of a file buffer or mapping. The only allocations are the strings
+    that end up in the Property, taken from arena unless it is NULL. Names, groups
+    and common parameter values are shared through the intern table instead.
 
-    size_t groupSize = 0;
-    if (endOfGroup != NULL)
+    Each line is scanned once for its delimiters (see VCScan.h); the splitting below
+    only walks the delimiter offsets.
+*/
+
+//Parameters in str[start, end); positions[first, last) are the delimiters in that range
+static VCardErrorCode addParameters(List* params, const char* str, size_t start, size_t end, const uint32_t* positions, size_t first, size_t last, CardArena* arena)
+{
+    size_t token = start;
+    size_t i = first;
+
+    while (token < end)
     {
-        groupSize = endOfGroup - mixedStr;
-        prop->group = (char*)realloc(prop->group, groupSize + 1);
+        //Token runs to the next ';' outside quotes, '=' is the first one in the token
+        size_t tokenEnd = end;
+        size_t equalSign = end;
+        bool quoted = false;
 
-        if (prop->group == NULL) 
+        for (; i < last; i++)
         {
-            free(copy);
-            free(mixedStr);
-            return OTHER_ERROR;
+            char ch = str[positions[i]];
+
+            if (ch == '"') quoted = !quoted;
+            else if (ch == '=' && equalSign == end) equalSign = positions[i];
+            else if (ch == ';' && !quoted)
+            {
+                tokenEnd = positions[i++];
+                break;
+            }
         }
 
-        strncpy(prop->group, mixedStr, groupSize + 1);
-        prop->group[groupSize] = '\0';
-    }
+        if (equalSign == end || equalSign > tokenEnd) return INV_PROP;
 
-    const char* nameStart = (endOfGroup != NULL) ? endOfGroup + 1 : mixedStr;
+        Parameter* param = (Parameter*)allocate(arena, sizeof(Parameter));
+        if (param == NULL) return OTHER_ERROR;
 
-    size_t nameSize = 0;
-    if (endOfName != NULL) nameSize = endOfName - nameStart;
-    else nameSize = mixedSize - groupSize;
+        const char* valueStart = str + equalSign + 1;
+        size_t valueLen = tokenEnd - equalSign - 1;
 
-    if (nameSize > 0)
-    {
-        prop->name = (char*)realloc(prop->name, nameSize + 1);
-        if (prop->name == NULL)
+        param->name = internSpan(arena, str + token, equalSign - token);
+        if (hasCommonValues(str + token, equalSign - token)) param->value = internSpan(arena, valueStart, valueLen);
+        else param->value = copySpan(arena, valueStart, valueLen);
+
+        if (param->name == NULL || param->value == NULL)
         {
-            free(copy);
-            free(mixedStr);
+            if (arena == NULL) deleteParameter(param);
             return OTHER_ERROR;
         }
-        strncpy(prop->name, nameStart, nameSize);
-        prop->name[nameSize] = '\0';
-    } 
-    else return INV_PROP;
 
-    if (endOfName != NULL)
+        insertBack(params, param);
+
+        token = tokenEnd + 1;
+    }
+
+    return OK;
+}
+
+//Values in str[start, end) split on every ';'; positions[first, last) are the delimiters in that range
+static VCardErrorCode addValues(List* values, const char* str, size_t start, size_t end, const uint32_t* positions, size_t first, size_t last, CardArena* arena)
+{
+    size_t lastToken = start;
+
+    for (size_t i = first; i < last; i++)
     {
-        const char* paramsStart = endOfName + 1;
-        size_t paramsSize = strlen(mixedStr) - (paramsStart - mixedStr);
+        if (str[positions[i]] != ';') continue;
 
-        if (paramsSize > 0)
-        {
-            char* paramStr = (char*)malloc(paramsSize + 1);
-            if (paramStr == NULL)
-            {
-                free(copy);
-                free(mixedStr);
-                return OTHER_ERROR;
-            }
-            strncpy(paramStr, paramsStart, paramsSize);
-            paramStr[paramsSize] = '\0';
+        char* newValue = copySpan(arena, str + lastToken, positions[i] - lastToken);
+        if (newValue == NULL) return OTHER_ERROR;
 
-            VCardErrorCode paramErr = createParameterList(prop->parameters, paramStr);
-            if (paramErr != OK) return paramErr;
+        insertBack(values, newValue);
 
-            free(paramStr);
-        }
+        lastToken = positions[i] + 1;
+    }
+
+    if (lastToken < end)
+    {
+        char* newValue = copySpan(arena, str + lastToken, end - lastToken);
+        if (newValue == NULL) return OTHER_ERROR;
+
+        insertBack(values, newValue);
     }
 
-    createValueList(prop->values, splitPos + 1);
-    
-    free(copy);
-    free(mixedStr);
     return OK;
 }
 
-VCardErrorCode createDateTime(DateTime* date, const char* dateStr)
+static VCardErrorCode tokenizeProperty(Property* prop, const DelimiterScan* scan, size_t len, CardArena* arena)
 {
-    if (date == NULL || dateStr == NULL || strlen(dateStr) == 0) return INV_PROP;
+    const char* str = scan->str;
 
-    char* actualDateStr = strchr(dateStr, ':');
-    if (actualDateStr == NULL || *(actualDateStr + 1) == '\0') return INV_PROP;
-    actualDateStr++;
+    //Split group.name;params : values, a ':' inside a quoted parameter value does not count
+    size_t splitIdx = scan->count;
+    size_t nameIdx = scan->count;
+    size_t endOfGroup = len;
+    bool quoted = false;
 
-    date->UTC = 0;
-    date->isText = 0;
-    date->date = (char*)malloc(1);
-    date->time = (char*)malloc(1);
-    date->text = (char*)malloc(1);
+    for (size_t i = 0; i < scan->count; i++)
+    {
+        char ch = str[scan->positions[i]];
 
-    if (date->date == NULL || date->time == NULL || date->text == NULL) return OTHER_ERROR;
+        if (ch == '"') quoted = !quoted;
+        else if (quoted) continue;
+        else if (ch == ':')
+        {
+            splitIdx = i;
+            break;
+        }
+        else if (ch == ';' && nameIdx == scan->count) nameIdx = i;
+        else if (ch == '.' && nameIdx == scan->count && endOfGroup == len) endOfGroup = scan->positions[i];
+    }
 
-    date->date[0] = '\0';
-    date->time[0] = '\0';
-    date->text[0] = '\0';
+    if (splitIdx == scan->count) return INV_PROP;
+
+    size_t splitPos = scan->positions[splitIdx];
+    if (nameIdx == scan->count) nameIdx = splitIdx;
+    size_t endOfName = scan->positions[nameIdx];
+
+    //group.
+    if (endOfGroup < endOfName) prop->group = internSpan(arena, str, endOfGroup);
+    else prop->group = internSpan(arena, "", 0);
+
+    size_t nameStart = (endOfGroup < endOfName) ? endOfGroup + 1 : 0;
+    size_t nameSize = endOfName - nameStart;
+
+    if (nameSize == 0) return INV_PROP;
+
+    prop->name = internSpan(arena, str + nameStart, nameSize);
+    prop->kind = propertyKind(str + nameStart, nameSize);
+    if (prop->name == NULL || prop->group == NULL) return OTHER_ERROR;
+
+    //;params
+    if (endOfName + 1 < splitPos)
+    {
+        VCardErrorCode paramErr = addParameters(prop->parameters, str, endOfName + 1, splitPos, scan->positions, nameIdx + 1, splitIdx, arena);
+        if (paramErr != OK) return paramErr;
+    }
+
+    //:values, a missing value is left for validateProperty to report
+    return addValues(prop->values, str, splitPos + 1, len, scan->positions, splitIdx + 1, scan->count, arena);
+}
+
+VCardErrorCode createProperty(Property* prop, const char* propStr, size_t len, CardArena* arena)
+{
+    prop->name = NULL;
+    prop->group = NULL;
+    prop->kind = PROP_OTHER;
+
+    DelimiterScan scan;
+    bool scanned = scanLine(&scan, propStr, len);
+
+    //There are no more parameters or values than ';'-separated pieces, so neither list grows
+    int pieces = 1;
+    for (size_t i = 0; scanned && i < scan.count; i++)
+    {
+        if (propStr[scan.positions[i]] == ';') pieces++;
+    }
+
+    prop->parameters = createCardList(arena, pieces, &parameterToString, &deleteParameter, &compareParameters);
+    prop->values = createCardList(arena, pieces, &valueToString, &deleteValue, &compareValues);
+
+    if (!scanned) return OTHER_ERROR;
+
+    VCardErrorCode err = tokenizeProperty(prop, &scan, len, arena);
+
+    freeScan(&scan);
+    return err;
+}
+
+VCardErrorCode createDateTime(DateTime* date, const char* dateStr, size_t len, CardArena* arena)
+{
+    if (date == NULL) return INV_PROP;
+
+    date->UTC = 0;
+    date->isText = 0;
+    date->date = NULL;
+    date->time = NULL;
+    date->text = NULL;
 
-    char* copy = (char*)malloc(strlen(actualDateStr) + 1);
-    if (copy == NULL) return OTHER_ERROR;
+    if (dateStr == NULL || len == 0) return INV_PROP;
 
-    strcpy(copy, actualDateStr);
+    const char* actualDateStr = memchr(dateStr, ':', len);
+    if (actualDateStr == NULL || actualDateStr + 1 == dateStr + len) return INV_PROP;
+    actualDateStr++;
 
-    size_t len = strlen(copy);
+    size_t dateLen = dateStr + len - actualDateStr;
 
-    if (copy[len - 1] == 'Z')
+    if (actualDateStr[dateLen - 1] == 'Z')
     {
         date->UTC = 1;
-        copy[len - 1] = '\0';
+        dateLen--;
     }
 
-    if (strstr(copy, "circa") != NULL)
+    if (containsSpan(actualDateStr, dateLen, "circa"))
     {
         date->isText = 1;
-        date->text = (char*)realloc(date->text, strlen(copy) + 1);
-        if (date->text == NULL)
+        date->date = copySpan(arena, "", 0);
+        date->time = copySpan(arena, "", 0);
+        date->text = copySpan(arena, actualDateStr, dateLen);
+    }
+    else
+    {
+        const char* tFound = memchr(actualDateStr, 'T', dateLen);
+
+        if (tFound == NULL)
         {
-            free(copy);
-            return OTHER_ERROR;
+            date->date = copySpan(arena, actualDateStr, dateLen);
+            date->time = copySpan(arena, "", 0);
         }
-        strcpy(date->text, copy);
-        return OK;
+        else
+        {
+            date->date = copySpan(arena, actualDateStr, tFound - actualDateStr);
+            date->time = copySpan(arena, tFound + 1, actualDateStr + dateLen - tFound - 1);
+        }
+        date->text = copySpan(arena, "", 0);
     }
 
-    char* tFound = strchr(copy, 'T');
+    if (date->date == NULL || date->time == NULL || date->text == NULL) return OTHER_ERROR;
 
-    if (tFound == NULL)
-    {
-        date->date = (char*)realloc(date->date, strlen(copy) + 1);
+    return OK;
+}
 
-        if (date->date == NULL)
-        {
-            free(copy);
-            return OTHER_ERROR;
-        }
+VCardErrorCode createParameterList(List* params, const char* paramsStr, size_t len, CardArena* arena)
+{
+    if (params == NULL || paramsStr == NULL || len == 0) return INV_PROP;
 
-        strcpy(date->date, copy);
-    } else
-    {
-        *tFound = '\0';
-        date->date = (char*)realloc(date->date, strlen(copy) + 1);
-        date->time = (char*)realloc(date->time, strlen(tFound + 1) + 1);
+    DelimiterScan scan;
+    if (!scanLine(&scan, paramsStr, len)) return OTHER_ERROR;
 
-        if (date->date == NULL || date->time == NULL)
-        {
-            free(copy);
-            return OTHER_ERROR;
-        }
+    VCardErrorCode err = addParameters(params, paramsStr, 0, len, scan.positions, 0, scan.count, arena);
 
-        strcpy(date->date, copy);
-        strcpy(date->time, tFound + 1);
+    freeScan(&scan);
+    return err;
+}
+
+VCardErrorCode createValueList(List* values, const char* valueStr, size_t len, CardArena* arena)
+{
+    if (values == NULL || valueStr == NULL || len == 0) return INV_PROP;
+
+    DelimiterScan scan;
+    if (!scanLine(&scan, valueStr, len)) return OTHER_ERROR;
+
+    VCardErrorCode err = addValues(values, valueStr, 0, len, scan.positions, 0, scan.count, arena);
+
+    freeScan(&scan);
+    return err;
+}
+
+
+Card* initializeCardWithArena(CardArena* arena)
+{
+    Card* card = (Card*)allocate(arena, sizeof(Card));
+    if (card == NULL) return NULL;
+
+    card->fn = NULL;
+    card->optionalProperties = createCardList(arena, CARD_PROPERTY_CAPACITY, &propertyToString, &deleteProperty, &compareProperties);
+    card->birthday = NULL;
+    card->anniversary = NULL;
+    card->arena = arena;
+    card->index = NULL;
+    card->hash = 0;
+
+    return card;
+}
+
+Card* initializeCard(bool useArena)
+{
+    CardArena* arena = NULL;
+
+    if (useArena)
+    {
+        arena = createArena(CARD_ARENA_SIZE);
+        if (arena == NULL) return NULL;
     }
 
-    free(copy);
-    return OK;
+    Card* card = initializeCardWithArena(arena);
+    if (card == NULL) freeArena(arena);
+
+    return card;
 }
 
-VCardErrorCode createParameterList(List* params, const char* paramsStr)
+void initCardParser(CardParser* parser, Card* card)
 {
-    if (params == NULL || paramsStr == NULL || strlen(paramsStr) == 0) return INV_PROP;
+    parser->card = card;
+    parser->state = EXPECT_BEGIN;
+    parser->propErr = OK;
+}
 
-    char* copy = malloc(strlen(paramsStr) + 1);
-    if (copy == NULL) return OTHER_ERROR;
+bool hasPrefix(const char* line, size_t len, const char* prefix)
+{
+    size_t prefixLen = strlen(prefix);
+    if (len < prefixLen) return false;
 
-    strcpy(copy, paramsStr);
+    for (size_t i = 0; i < prefixLen; i++)
+    {
+        if (toupper((unsigned char)line[i]) != prefix[i]) return false;
+    }
 
-    char* token = copy;
-    do
+    return true;
+}
+
+//Kind of the property on line, from the name between the optional group and the first ';' or ':'
+static PropertyKind lineKind(const char* line, size_t len)
+{
+    size_t nameStart = 0;
+    size_t nameEnd = 0;
+
+    while (nameEnd < len && line[nameEnd] != ':' && line[nameEnd] != ';')
     {
-        char* equalSign = strchr(token, '=');
-        if (equalSign == NULL)
-        {
-            free(copy);
-            return INV_PROP;
-        }
+        if (line[nameEnd] == '.' && nameStart == 0) nameStart = nameEnd + 1;
+        nameEnd++;
+    }
 
-        *equalSign = '\0';
-        char* name = token;
-        char* value = equalSign + 1;
-        
-        Parameter* param = (Parameter*)malloc(sizeof(Parameter));
-        if (param == NULL)
-        {
-            free(copy);
-            return OTHER_ERROR;
-        }
+    return propertyKind(line + nameStart, nameEnd - nameStart);
+}
 
-        param->name = (char*)malloc(strlen(name) + 1);
-        param->value = (char*)malloc(strlen(value) + 1);
+static VCardErrorCode parseFnLine(Card* card, const char* line, size_t len)
+{
+    //Only the first FN is kept
+    if (card->fn != NULL) return OK;
 
-        if (param->name == NULL || param->value == NULL)
-        {
-            free(param);
-            free(copy);
-            return OTHER_ERROR;
-        }
+    Property* prop = (Property*)cardAlloc(card, sizeof(Property));
+    if (prop == NULL) return OTHER_ERROR;
+
+    VCardErrorCode fnErr = createProperty(prop, line, len, card->arena);
+    if (fnErr != OK)
+    {
+        if (card->arena == NULL) deleteProperty(prop);
+        return fnErr;
+    }
 
-        strcpy(param->name, name);
-        strcpy(param->value, value);
+    card->fn = prop;
+    return OK;
+}
 
-        insertBack(params, param);
+static VCardErrorCode parseDateLine(Card* card, PropertyKind kind, const char* line, size_t len)
+{
+    DateTime* date = (DateTime*)cardAlloc(card, sizeof(DateTime));
+    if (date == NULL) return INV_DT;
 
-        token = strchr(token, ';');
-        if (token != NULL) token++;
-    } while (token != NULL && *token != '\0');
+    VCardErrorCode dateErr = createDateTime(date, line, len, card->arena);
+    if (dateErr != OK)
+    {
+        if (card->arena == NULL) deleteDate(date);
+        return dateErr;
+    }
 
-    free(copy);
+    DateTime** dest = (kind == PROP_BDAY) ? &card->birthday : &card->anniversary;
+    if (card->arena == NULL) deleteDate(*dest);
+    *dest = date;
     return OK;
 }
 
-VCardErrorCode createValueList(List* values, const char* valueStr)
+VCardErrorCode parseCardLine(CardParser* parser, const char* line, size_t len)
 {
-    if (values == NULL || valueStr == NULL || strlen(valueStr) == 0) return INV_PROP;
+    Card* card = parser->card;
+
+    switch (parser->state)
+    {
+        case EXPECT_BEGIN:
+            if (!hasPrefix(line, len, "BEGIN:VCARD")) return INV_CARD;
+            parser->state = EXPECT_VERSION;
+            return OK;
+        case EXPECT_VERSION:
+            if (!hasPrefix(line, len, "VERSION:4.0")) return INV_CARD;
+            parser->state = IN_CARD;
+            return OK;
+        case AFTER_END:
+            //Only blank lines may follow END:VCARD
+            if (len == 0) return OK;
+            return (card->fn == NULL) ? INV_PROP : INV_CARD;
+        case IN_CARD:
+            break;
+    }
 
-    char* copy = malloc(strlen(valueStr) + 1);
-    if (copy == NULL) return OTHER_ERROR;
-    strcpy(copy, valueStr);
+    PropertyKind kind = lineKind(line, len);
 
-    char* token = copy;
-    char* lastToken = copy;
-    while ((token = strpbrk(token, ";")) != NULL)
+    switch (kind)
     {
-        size_t len = token - lastToken;
+        case PROP_END:
+            if (!hasPrefix(line, len, "END:VCARD")) break;
+            parser->state = AFTER_END;
+            return OK;
+        case PROP_FN:
+            return parseFnLine(card, line, len);
+        default:
+            break;
+    }
 
-        char* newValue = (char*)malloc(len + 1);
-        if (newValue == NULL)
-        {
-            free(copy);
-            return OTHER_ERROR;
-        }
+    //After a bad property only the structure is checked, the card is discarded anyway
+    if (parser->propErr != OK) return OK;
 
-        strncpy(newValue, lastToken, len);
-        newValue[len] = '\0';
-        insertBack(values, newValue);
+    if (kind == PROP_BDAY || kind == PROP_ANNIVERSARY)
+    {
+        parser->propErr = parseDateLine(card, kind, line, len);
+        return OK;
+    }
 
-        token++;
-        lastToken = token;
+    Property* prop = (Property*)cardAlloc(card, sizeof(Property));
+    if (prop == NULL)
+    {
+        parser->propErr = INV_PROP;
+        return OK;
     }
 
-    if (*lastToken != '\0')
+    VCardErrorCode propErr = createProperty(prop, line, len, card->arena);
+    if (propErr != OK)
     {
-        char* newValue = (char*)malloc(strlen(lastToken) + 1);
-        if (newValue == NULL)
-        {
-            free(copy);
-            return OTHER_ERROR;
-        }
-        strcpy(newValue, lastToken);
-        insertBack(values, newValue);
+        if (card->arena == NULL) deleteProperty(prop);
+        parser->propErr = propErr;
+        return OK;
     }
 
-    free(copy);
+    insertBack(card->optionalProperties, prop);
     return OK;
 }
 
+VCardErrorCode finishCardParser(CardParser* parser)
+{
+    if (parser->state == EXPECT_BEGIN || parser->state == EXPECT_VERSION) return INV_CARD;
+    if (parser->card->fn == NULL) return INV_PROP;
+    if (parser->state != AFTER_END) return INV_CARD;
+
+    return parser->propErr;
+}
 
-char* bdayText(DateTime* date)
+//Reads one physical line (any length) into line starting at offset start
+static bool readPhysicalLine(FILE* fptr, char** line, size_t* size, size_t start)
 {
-    char * fullBirStr = malloc(1);
-    fullBirStr[0] = '\0';
+    size_t len = start;
+    bool readAny = false;
 
-    if (date != NULL)
+    while (1)
     {
-        char* birStr = dateToString(date);
-        int birLen = 5 + strlen(birStr) + 1;
-
-        char* tmp = realloc(fullBirStr, birLen);
-        if (tmp == NULL)
+        if (*size - len < 2)
         {
-            free(fullBirStr);
-            free(birStr);
-            return NULL;
+            size_t newSize = (*size == 0) ? 128 : *size * 2;
+            char* tmp = (char*)realloc(*line, newSize);
+            if (tmp == NULL) return false;
+
+            *line = tmp;
+            *size = newSize;
         }
-        fullBirStr = tmp;
 
-        sprintf(fullBirStr, "BDAY:%s", birStr);
-        free(birStr);
-    }
+        if (fgets(*line + len, (int)(*size - len), fptr) == NULL) break;
 
-    return fullBirStr;
+        readAny = true;
+        len += strlen(*line + len);
+        if ((*line)[len - 1] == '\n') break;
+    }
 
+    return readAny;
 }
 
-char* annText(DateTime* date)
+bool readFoldedLine(FILE* fptr, char** line, size_t* size)
 {
-    char * fullAnnStr = malloc(1);
-    fullAnnStr[0] = '\0';
+    if (!readPhysicalLine(fptr, line, size, 0)) return false;
+    removeCRLF(*line);
 
-    if (date != NULL)
+    int ch = checkNextChar(fptr);
+    while (ch == ' ' || ch == '\t')
     {
-        char* annStr = dateToString(date);
-        int annLen = 12 + strlen(annStr) + 1;
+        size_t len = strlen(*line);
+        if (!readPhysicalLine(fptr, line, size, len)) break;
 
-        char* tmp = realloc(fullAnnStr, annLen);
-        if (tmp == NULL)
-        {
-            free(fullAnnStr);
-            free(annStr);
-            return NULL;
-        }
-        fullAnnStr = tmp;
+        removeCRLF(*line + len);
+        removeSpace(*line + len);
 
-        sprintf(fullAnnStr, "ANNIVERSARY:%s", annStr);
-        free(annStr);
+        ch = checkNextChar(fptr);
     }
 
-    return fullAnnStr;
+    return true;
 }
 
 
@@ -0,0 +1,271 @@
+#include <ctype.h>
+#include <strings.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCKind.h"
+#include "VCIndex.h"
+#include "VCHash.h"
+
+//Slots of the table for other names when it is first needed, a power of two
+#define OTHER_INITIAL_SLOTS 8
+
+//FNV-1a over the upper-cased name, so lookups ignore case
+static uint64_t hashName(const char* name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (const unsigned char* p = (const unsigned char*)name; *p != '\0'; p++)
+    {
+        hash ^= (uint64_t)toupper(*p);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static bool bucketAppend(PropertyBucket* bucket, Property* prop)
+{
+    if (bucket->count == bucket->capacity)
+    {
+        int capacity = (bucket->capacity == 0) ? 4 : bucket->capacity * 2;
+        Property** tmp = (Property**)realloc(bucket->items, capacity * sizeof(Property*));
+        if (tmp == NULL) return false;
+
+        bucket->items = tmp;
+        bucket->capacity = capacity;
+    }
+
+    bucket->items[bucket->count++] = prop;
+    return true;
+}
+
+static void bucketRemove(PropertyBucket* bucket, const Property* prop)
+{
+    for (int i = 0; i < bucket->count; i++)
+    {
+        if (bucket->items[i] == prop)
+        {
+            memmove(bucket->items + i, bucket->items + i + 1, (bucket->count - i - 1) * sizeof(Property*));
+            bucket->count--;
+            return;
+        }
+    }
+}
+
+//Slot of name in the table of other names: its own, or the empty one where it would go
+static OtherPropertySlot* findOther(PropertyIndex* index, const char* name, uint64_t hash)
+{
+    size_t mask = (size_t)index->otherCapacity - 1;
+
+    for (size_t i = hash & mask; ; i = (i + 1) & mask)
+    {
+        OtherPropertySlot* slot = &index->others[i];
+        if (slot->name == NULL) return slot;
+        if (slot->hash == hash && strcasecmp(slot->name, name) == 0) return slot;
+    }
+}
+
+static bool growOthers(PropertyIndex* index)
+{
+    int capacity = (index->otherCapacity == 0) ? OTHER_INITIAL_SLOTS : index->otherCapacity * 2;
+
+    OtherPropertySlot* slots = (OtherPropertySlot*)calloc(capacity, sizeof(OtherPropertySlot));
+    if (slots == NULL) return false;
+
+    OtherPropertySlot* old = index->others;
+    int oldCapacity = index->otherCapacity;
+
+    index->others = slots;
+    index->otherCapacity = capacity;
+
+    for (int i = 0; i < oldCapacity; i++)
+    {
+        if (old[i].name != NULL) (*findOther(index, old[i].name, old[i].hash)) = old[i];
+    }
+
+    free(old);
+    return true;
+}
+
+//Bucket for a property name, created if create is set; NULL if there is none
+static PropertyBucket* findBucket(PropertyIndex* index, const char* name, PropertyKind kind, bool create)
+{
+    if (kind != PROP_OTHER) return &index->kinds[kind];
+
+    if (index->otherCapacity == 0)
+    {
+        if (!create || !growOthers(index)) return NULL;
+    }
+
+    uint64_t hash = hashName(name);
+    OtherPropertySlot* slot = findOther(index, name, hash);
+    if (slot->name != NULL) return &slot->bucket;
+    if (!create) return NULL;
+
+    //Keep the table at most 3/4 full
+    if ((index->otherCount + 1) * 4 > index->otherCapacity * 3)
+    {
+        if (!growOthers(index)) return NULL;
+        slot = findOther(index, name, hash);
+    }
+
+    slot->name = (char*)malloc(strlen(name) + 1);
+    if (slot->name == NULL) return NULL;
+
+    strcpy(slot->name, name);
+    slot->hash = hash;
+    index->otherCount++;
+
+    return &slot->bucket;
+}
+
+static bool indexProperty(PropertyIndex* index, Property* prop)
+{
+    PropertyBucket* bucket = findBucket(index, prop->name, prop->kind, true);
+    return bucket != NULL && bucketAppend(bucket, prop);
+}
+
+static void freeIndex(PropertyIndex* index)
+{
+    if (index == NULL) return;
+
+    for (int i = 0; i < PROPERTY_KIND_COUNT; i++)
+    {
+        free(index->kinds[i].items);
+    }
+
+    for (int i = 0; i < index->otherCapacity; i++)
+    {
+        free(index->others[i].name);
+        free(index->others[i].bucket.items);
+    }
+
+    free(index->others);
+    free(index);
+}
+
+void freePropertyIndex(Card* card)
+{
+    if (card == NULL) return;
+
+    freeIndex(card->index);
+    card->index = NULL;
+}
+
+VCardErrorCode buildPropertyIndex(Card* card)
+{
+    if (card == NULL) return OTHER_ERROR;
+
+    freePropertyIndex(card);
+
+    PropertyIndex* index = (PropertyIndex*)calloc(1, sizeof(PropertyIndex));
+    if (index == NULL) return OTHER_ERROR;
+
+    bool ok = card->fn == NULL || indexProperty(index, card->fn);
+
+    ListIterator iter = createIterator(card->optionalProperties);
+    void* elem;
+    while (ok && (elem = nextElement(&iter)) != NULL)
+    {
+        ok = indexProperty(index, (Property*)elem);
+    }
+
+    if (!ok)
+    {
+        freeIndex(index);
+        return OTHER_ERROR;
+    }
+
+    index->indexedFn = card->fn;
+    index->indexedModifications = card->optionalProperties->modifications;
+
+    card->index = index;
+    return OK;
+}
+
+//The card's index, built or rebuilt if it is missing or out of date
+static PropertyIndex* currentIndex(Card* card)
+{
+    PropertyIndex* index = card->index;
+
+    if (index != NULL && index->indexedFn == card->fn && index->indexedModifications == card->optionalProperties->modifications)
+    {
+        return index;
+    }
+
+    return (buildPropertyIndex(card) == OK) ? card->index : NULL;
+}
+
+int getProperties(Card* card, const char* name, Property* const** props)
+{
+    if (props != NULL) (*props) = NULL;
+    if (card == NULL || name == NULL) return 0;
+
+    PropertyIndex* index = currentIndex(card);
+    if (index == NULL) return 0;
+
+    PropertyBucket* bucket = findBucket(index, name, propertyKind(name, strlen(name)), false);
+    if (bucket == NULL || bucket->count == 0) return 0;
+
+    if (props != NULL) (*props) = bucket->items;
+    return bucket->count;
+}
+
+Property* getFirstProperty(Card* card, const char* name)
+{
+    Property* const* props;
+    return (getProperties(card, name, &props) > 0) ? props[0] : NULL;
+}
+
+VCardErrorCode addProperty(Card* card, Property* prop)
+{
+    if (card == NULL || card->optionalProperties == NULL || prop == NULL || prop->name == NULL) return INV_PROP;
+
+    prop->kind = propertyKind(prop->name, strlen(prop->name));
+
+    int length = getLength(card->optionalProperties);
+    unsigned int modifications = card->optionalProperties->modifications;
+    insertBack(card->optionalProperties, prop);
+    if (getLength(card->optionalProperties) == length) return OTHER_ERROR;
+
+    invalidateCardHash(card);
+
+    PropertyIndex* index = card->index;
+    if (index == NULL) return OK;
+
+    //An index that was already stale, or cannot take the property, is rebuilt on the next lookup
+    if (index->indexedModifications != modifications || !indexProperty(index, prop))
+    {
+        freePropertyIndex(card);
+        return OK;
+    }
+
+    index->indexedModifications = card->optionalProperties->modifications;
+    return OK;
+}
+
+Property* removeProperty(Card* card, Property* prop)
+{
+    if (card == NULL || card->optionalProperties == NULL || prop == NULL) return NULL;
+
+    unsigned int modifications = card->optionalProperties->modifications;
+    if (removeFromList(card->optionalProperties, prop) == NULL) return NULL;
+
+    invalidateCardHash(card);
+
+    PropertyIndex* index = card->index;
+    if (index == NULL) return prop;
+
+    if (index->indexedModifications != modifications)
+    {
+        freePropertyIndex(card);
+        return prop;
+    }
+
+    PropertyBucket* bucket = findBucket(index, prop->name, prop->kind, false);
+    if (bucket != NULL) bucketRemove(bucket, prop);
+
+    index->indexedModifications = card->optionalProperties->modifications;
+    return prop;
+}
@@ -0,0 +1,164 @@
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "VCIntern.h"
+
+//Address space reserved for interned strings; pages are only committed when used
+#define INTERN_REGION_SIZE ((size_t)64 << 20)
+
+#define INTERN_INITIAL_SLOTS 1024
+
+typedef struct internEntry {
+    const char* str;
+    uint32_t    hash;
+    uint32_t    len;
+} InternEntry;
+
+static pthread_once_t internOnce = PTHREAD_ONCE_INIT;
+static pthread_rwlock_t internLock = PTHREAD_RWLOCK_INITIALIZER;
+
+static char* _Atomic regionStart = NULL;
+static size_t regionUsed = 0;
+
+//Open addressing, power of two slots, at most 70% full
+static InternEntry* table = NULL;
+static size_t tableSlots = 0;
+static size_t tableCount = 0;
+
+static void initInternTable(void)
+{
+    table = (InternEntry*)calloc(INTERN_INITIAL_SLOTS, sizeof(InternEntry));
+    if (table == NULL) return;
+
+    void* region = mmap(NULL, INTERN_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED)
+    {
+        free(table);
+        table = NULL;
+        return;
+    }
+
+    tableSlots = INTERN_INITIAL_SLOTS;
+    atomic_store_explicit(&regionStart, (char*)region, memory_order_release);
+}
+
+static uint32_t hashString(const char* str, size_t len)
+{
+    //FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const char* lookup(const char* str, size_t len, uint32_t hash)
+{
+    size_t mask = tableSlots - 1;
+
+    for (size_t i = hash & mask; table[i].str != NULL; i = (i + 1) & mask)
+    {
+        if (table[i].hash == hash && table[i].len == len && memcmp(table[i].str, str, len) == 0) return table[i].str;
+    }
+
+    return NULL;
+}
+
+static void placeEntry(InternEntry* slots, size_t slotCount, InternEntry entry)
+{
+    size_t mask = slotCount - 1;
+    size_t i = entry.hash & mask;
+
+    while (slots[i].str != NULL) i = (i + 1) & mask;
+    slots[i] = entry;
+}
+
+static bool growTable(void)
+{
+    size_t newSlots = tableSlots * 2;
+    InternEntry* newTable = (InternEntry*)calloc(newSlots, sizeof(InternEntry));
+    if (newTable == NULL) return false;
+
+    for (size_t i = 0; i < tableSlots; i++)
+    {
+        if (table[i].str != NULL) placeEntry(newTable, newSlots, table[i]);
+    }
+
+    free(table);
+    table = newTable;
+    tableSlots = newSlots;
+    return true;
+}
+
+//Called with the write lock held
+static const char* insert(const char* str, size_t len, uint32_t hash)
+{
+    char* region = atomic_load_explicit(&regionStart, memory_order_relaxed);
+
+    if (regionUsed + len + 1 > INTERN_REGION_SIZE) return NULL;
+    if ((tableCount + 1) * 10 > tableSlots * 7 && !growTable()) return NULL;
+
+    char* copy = region + regionUsed;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    regionUsed += len + 1;
+
+    InternEntry entry = {copy, hash, (uint32_t)len};
+    placeEntry(table, tableSlots, entry);
+    tableCount++;
+
+    return copy;
+}
+
+const char* internString(const char* str, size_t len)
+{
+    if (str == NULL || len > INTERN_MAX_LENGTH) return NULL;
+
+    pthread_once(&internOnce, &initInternTable);
+    if (atomic_load_explicit(&regionStart, memory_order_acquire) == NULL) return NULL;
+
+    uint32_t hash = hashString(str, len);
+
+    pthread_rwlock_rdlock(&internLock);
+    const char* found = lookup(str, len, hash);
+    pthread_rwlock_unlock(&internLock);
+
+    if (found != NULL) return found;
+
+    pthread_rwlock_wrlock(&internLock);
+    found = lookup(str, len, hash);
+    if (found == NULL) found = insert(str, len, hash);
+    pthread_rwlock_unlock(&internLock);
+
+    return found;
+}
+
+bool isInterned(const char* str)
+{
+    const char* region = atomic_load_explicit(&regionStart, memory_order_acquire);
+
+    return region != NULL && str >= region && str < region + INTERN_REGION_SIZE;
+}
+
+bool internEquals(const char* first, const char* second)
+{
+    if (first == second) return true;
+
+    //Two different interned strings are never equal
+    if (isInterned(first) && isInterned(second)) return false;
+
+    return strcmp(first, second) == 0;
+}
+
+void freeUnlessInterned(char* str)
+{
+    if (!isInterned(str)) free(str);
+}
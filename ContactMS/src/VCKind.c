@@ -0,0 +1,83 @@
+#include <stdint.h>
+
+#include "VCKind.h"
+
+/*  Perfect hash over the upper-cased names: 32 bit FNV-1a started from KIND_HASH_SEED,
+    top six bits as the slot. The seed is the first one for which all the names in
+    PropertyKind land in different slots, so a lookup is one hash and one compare.
+    Adding a name means searching for a new seed and rebuilding the table, which
+    make kindtable does (see KindTable.c).
+*/
+#define KIND_HASH_SEED 3161200u
+#define KIND_SLOTS 64
+#define KIND_MAX_LENGTH 12
+
+typedef struct kindEntry {
+    const char*  name;
+    PropertyKind kind;
+} KindEntry;
+
+static const KindEntry kindTable[KIND_SLOTS] = {
+    [0] = {"LOGO", PROP_LOGO},
+    [1] = {"SOUND", PROP_SOUND},
+    [2] = {"NICKNAME", PROP_NICKNAME},
+    [3] = {"MEMBER", PROP_MEMBER},
+    [4] = {"RELATED", PROP_RELATED},
+    [5] = {"ORG", PROP_ORG},
+    [6] = {"IMPP", PROP_IMPP},
+    [7] = {"CALURI", PROP_CALURI},
+    [8] = {"KIND", PROP_KIND},
+    [9] = {"ADR", PROP_ADR},
+    [10] = {"TZ", PROP_TZ},
+    [13] = {"SOURCE", PROP_SOURCE},
+    [14] = {"BEGIN", PROP_BEGIN},
+    [17] = {"XML", PROP_XML},
+    [19] = {"PHOTO", PROP_PHOTO},
+    [20] = {"TEL", PROP_TEL},
+    [22] = {"CALADRURI", PROP_CALADRURI},
+    [23] = {"VERSION", PROP_VERSION},
+    [26] = {"KEY", PROP_KEY},
+    [28] = {"EMAIL", PROP_EMAIL},
+    [29] = {"BDAY", PROP_BDAY},
+    [34] = {"N", PROP_N},
+    [37] = {"CATEGORIES", PROP_CATEGORIES},
+    [40] = {"PRODID", PROP_PRODID},
+    [41] = {"NOTE", PROP_NOTE},
+    [43] = {"LANG", PROP_LANG},
+    [45] = {"UID", PROP_UID},
+    [47] = {"GENDER", PROP_GENDER},
+    [48] = {"FBURL", PROP_FBURL},
+    [49] = {"GEO", PROP_GEO},
+    [51] = {"REV", PROP_REV},
+    [52] = {"TITLE", PROP_TITLE},
+    [53] = {"FN", PROP_FN},
+    [54] = {"CLIENTPIDMAP", PROP_CLIENTPIDMAP},
+    [55] = {"URL", PROP_URL},
+    [57] = {"END", PROP_END},
+    [59] = {"ANNIVERSARY", PROP_ANNIVERSARY},
+    [60] = {"ROLE", PROP_ROLE},
+};
+
+static char upper(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') ? (char)(ch - 'a' + 'A') : ch;
+}
+
+PropertyKind propertyKind(const char* name, size_t len)
+{
+    if (len == 0 || len > KIND_MAX_LENGTH) return PROP_OTHER;
+
+    char folded[KIND_MAX_LENGTH];
+    uint32_t hash = KIND_HASH_SEED;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        folded[i] = upper(name[i]);
+        hash = (hash ^ (unsigned char)folded[i]) * 16777619u;
+    }
+
+    const KindEntry* entry = &kindTable[hash >> 26];
+    if (entry->name == NULL || strlen(entry->name) != len || memcmp(entry->name, folded, len) != 0) return PROP_OTHER;
+
+    return entry->kind;
+}
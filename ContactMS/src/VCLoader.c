@@ -0,0 +1,294 @@
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCValidate.h"
+#include "VCAPIHelpers.h"
+#include "VCLoader.h"
+
+//Upper bound on worker threads, whatever the caller asks for
+#define MAX_LOADER_THREADS 64
+
+typedef struct loaderJob {
+    //Work done for each index, by whichever thread takes it
+    void            (*process)(const struct loaderJob* job, size_t i);
+
+    //Directory the file names are relative to, NULL if they are paths already
+    const char*     dirName;
+    char**          fileNames;
+    size_t          count;
+
+    //Parse cache to consult and fill, may be NULL
+    CardCache*      cache;
+
+    //Caller-owned arrays, count entries each
+    Card**          cards;
+    Contact*        contacts;
+    VCardErrorCode* errors;
+
+    //Next index to hand out
+    atomic_size_t   next;
+} LoaderJob;
+
+static int compareNames(const void* first, const void* second)
+{
+    return strcmp(*(char* const*)first, *(char* const*)second);
+}
+
+static void loadOne(const LoaderJob* job, size_t i)
+{
+    char* path = job->fileNames[i];
+    char* fileName = job->fileNames[i];
+
+    if (job->dirName != NULL)
+    {
+        size_t pathLen = strlen(job->dirName) + strlen(fileName) + 2;
+        path = (char*)malloc(pathLen);
+        if (path == NULL)
+        {
+            job->cards[i] = NULL;
+            job->errors[i] = OTHER_ERROR;
+            return;
+        }
+        snprintf(path, pathLen, "%s/%s", job->dirName, fileName);
+    }
+    else
+    {
+        //Contacts carry the bare file name, like ContactModel does
+        char* slash = strrchr(path, '/');
+        if (slash != NULL) fileName = slash + 1;
+    }
+
+    Card* card = NULL;
+    VCardErrorCode err = OK;
+
+    struct stat info;
+    bool haveInfo = job->cache != NULL && stat(path, &info) == 0;
+
+    if (!haveInfo || !cardCacheLookup(job->cache, path, &info, &err, &card))
+    {
+        err = createCard(path, &card);
+        if (err == OK) err = validateCard(card);
+
+        if (haveInfo) cardCacheStore(job->cache, path, &info, err, card);
+    }
+
+    if (path != job->fileNames[i]) free(path);
+
+    if (err != OK)
+    {
+        deleteCard(card);
+        card = NULL;
+        memset(&job->contacts[i], 0, sizeof(Contact));
+    }
+    else
+    {
+        job->contacts[i] = getContact(fileName, card);
+    }
+
+    job->cards[i] = card;
+    job->errors[i] = err;
+}
+
+static void validateOne(const LoaderJob* job, size_t i)
+{
+    job->errors[i] = validateCard(job->cards[i]);
+}
+
+static void* loaderThread(void* arg)
+{
+    LoaderJob* job = (LoaderJob*)arg;
+
+    size_t i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count)
+    {
+        job->process(job, i);
+    }
+
+    return NULL;
+}
+
+//Runs job on up to threads threads, the calling thread included
+static void runLoaderJob(LoaderJob* job, int threads)
+{
+    atomic_init(&job->next, 0);
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if ((size_t)threads > job->count) threads = (int)job->count;
+    if (threads > MAX_LOADER_THREADS) threads = MAX_LOADER_THREADS;
+    if (threads < 1) threads = 1;
+
+    pthread_t workers[MAX_LOADER_THREADS];
+    int started = 0;
+
+    for (int t = 1; t < threads; t++)
+    {
+        if (pthread_create(&workers[started], NULL, &loaderThread, job) != 0) break;
+        started++;
+    }
+
+    loaderThread(job);
+
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(workers[t], NULL);
+    }
+}
+
+//Sorted list of card file names in dirName
+static VCardErrorCode listCardFiles(const char* dirName, CardDirectory* dir)
+{
+    DIR* dp = opendir(dirName);
+    if (dp == NULL) return INV_FILE;
+
+    int capacity = 0;
+    struct dirent* entry;
+
+    while ((entry = readdir(dp)) != NULL)
+    {
+        if (validateFileName(entry->d_name) != OK) continue;
+
+        if (dir->count == capacity)
+        {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            char** tmp = (char**)realloc(dir->fileNames, capacity * sizeof(char*));
+            if (tmp == NULL)
+            {
+                closedir(dp);
+                return OTHER_ERROR;
+            }
+            dir->fileNames = tmp;
+        }
+
+        dir->fileNames[dir->count] = (char*)malloc(strlen(entry->d_name) + 1);
+        if (dir->fileNames[dir->count] == NULL)
+        {
+            closedir(dp);
+            return OTHER_ERROR;
+        }
+        strcpy(dir->fileNames[dir->count], entry->d_name);
+        dir->count++;
+    }
+
+    closedir(dp);
+
+    if (dir->count > 0)
+    {
+        qsort(dir->fileNames, dir->count, sizeof(char*), &compareNames);
+    }
+
+    return OK;
+}
+
+VCardErrorCode loadCardDirectory(const char* dirName, int threads, CardDirectory** result)
+{
+    (*result) = NULL;
+
+    if (dirName == NULL) return INV_FILE;
+
+    CardDirectory* dir = (CardDirectory*)calloc(1, sizeof(CardDirectory));
+    if (dir == NULL) return OTHER_ERROR;
+
+    VCardErrorCode err = listCardFiles(dirName, dir);
+    if (err != OK)
+    {
+        freeCardDirectory(dir, true);
+        return err;
+    }
+
+    size_t n = (dir->count > 0) ? dir->count : 1;
+    dir->cards = (Card**)calloc(n, sizeof(Card*));
+    dir->contacts = (Contact*)calloc(n, sizeof(Contact));
+    dir->errors = (VCardErrorCode*)calloc(n, sizeof(VCardErrorCode));
+
+    if (dir->cards == NULL || dir->contacts == NULL || dir->errors == NULL)
+    {
+        freeCardDirectory(dir, true);
+        return OTHER_ERROR;
+    }
+
+    LoaderJob job;
+    job.process = &loadOne;
+    job.cache = NULL;
+    job.dirName = dirName;
+    job.fileNames = dir->fileNames;
+    job.count = dir->count;
+    job.cards = dir->cards;
+    job.contacts = dir->contacts;
+    job.errors = dir->errors;
+
+    runLoaderJob(&job, threads);
+
+    (*result) = dir;
+    return OK;
+}
+
+int loadCardBatch(char** fileNames, int count, int threads, Card** cards, VCardErrorCode* errors, Contact* contacts)
+{
+    return loadCardBatchCached(NULL, fileNames, count, threads, cards, errors, contacts);
+}
+
+int loadCardBatchCached(CardCache* cache, char** fileNames, int count, int threads, Card** cards, VCardErrorCode* errors, Contact* contacts)
+{
+    if (fileNames == NULL || cards == NULL || errors == NULL || contacts == NULL || count <= 0) return 0;
+
+    LoaderJob job;
+    job.process = &loadOne;
+    job.cache = cache;
+    job.dirName = NULL;
+    job.fileNames = fileNames;
+    job.count = count;
+    job.cards = cards;
+    job.contacts = contacts;
+    job.errors = errors;
+
+    runLoaderJob(&job, threads);
+
+    int loaded = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (errors[i] == OK) loaded++;
+    }
+
+    return loaded;
+}
+
+void validateCards(Card** cards, size_t n, VCardErrorCode* out, int threads)
+{
+    if (cards == NULL || out == NULL || n == 0) return;
+
+    LoaderJob job;
+    job.process = &validateOne;
+    job.cache = NULL;
+    job.dirName = NULL;
+    job.fileNames = NULL;
+    job.count = n;
+    job.cards = cards;
+    job.contacts = NULL;
+    job.errors = out;
+
+    runLoaderJob(&job, threads);
+}
+
+void freeCardDirectory(CardDirectory* dir, bool deleteCards)
+{
+    if (dir == NULL) return;
+
+    for (int i = 0; i < dir->count; i++)
+    {
+        if (dir->fileNames != NULL) free(dir->fileNames[i]);
+        if (deleteCards && dir->cards != NULL) deleteCard(dir->cards[i]);
+    }
+
+    free(dir->fileNames);
+    free(dir->cards);
+    free(dir->contacts);
+    free(dir->errors);
+    free(dir);
+}
@@ -1,10 +1,12 @@
 #include "LinkedListAPI.h"
 #include "VCParser.h"
 #include "VCHelpers.h"
+#include "VCIndex.h"
 #include "VCValidate.h"
+#include "VCWriter.h"
 
 
-VCardErrorCode createCard(char* fileName, Card** obj)
+static VCardErrorCode readCardFile(char* fileName, Card** obj, bool useArena)
 {
     VCardErrorCode filenameErr = validateFileName(fileName);
 
@@ -20,7 +22,7 @@ VCardErrorCode createCard(char* fileName, Card** obj)
         return INV_FILE;
     }
 
-    (*obj) = (Card*)malloc(sizeof(Card));
+    (*obj) = initializeCard(useArena);
 
     if ((*obj) == NULL)
     {
@@ -28,144 +30,44 @@ VCardErrorCode createCard(char* fileName, Card** obj)
         return INV_CARD;
     }
 
+    //Structure is validated while the card is built, so every line is read exactly once
+    CardParser parser;
+    initCardParser(&parser, (*obj));
 
-    (*obj)->fn = NULL;
-    (*obj)->optionalProperties = initializeList(&propertyToString, &deleteProperty, &compareProperties);
-    (*obj)->birthday = NULL;
-    (*obj)->anniversary = NULL;
+    char* line = NULL;
+    size_t size = 0;
+    VCardErrorCode err = OK;
 
-    VCardErrorCode validateErr = validateFileCard(fptr, (*obj));
+    while (err == OK && readFoldedLine(fptr, &line, &size))
+    {
+        err = parseCardLine(&parser, line, strlen(line));
+    }
 
-    if (validateErr != OK)
+    if (err == OK)
     {
-        deleteCard((*obj));
-        fclose(fptr);
-        return validateErr;
-    }
-
-    //Skip over FN in while loop, 80 = _\t + 75 + \n\r\0
-    char buffer[160];
-
-    while (fgets(buffer, sizeof(buffer), fptr) != NULL)
-    {
-        VCardErrorCode clrErr = removeCRLF(buffer);
-        if (clrErr != OK)
-        {
-            return clrErr;
-        }
-
-        if (strncmp(buffer, "END:VCARD", 9) == 0)
-        {
-            break;
-        }
-        if (strncmp(buffer, "FN:", 3) == 0)
-        {
-            continue;
-        }
-        if (strncmp(buffer, " ", 1) == 0 || strncmp(buffer, "\t", 1) == 0)
-        {
-            continue;
-        }
-        if (strncmp(buffer, "BDAY", 4) == 0)
-        {
-            DateTime* bday = (DateTime*)malloc(sizeof(DateTime));
-            if (bday == NULL)
-            {
-                fclose(fptr);
-                return INV_DT;
-            }
-
-            VCardErrorCode bdayErr = createDateTime(bday, buffer);
-            if (bdayErr != OK)
-            {
-                fclose(fptr);
-                deleteDate(bday);
-                return bdayErr;
-            }
-
-            (*obj)->birthday = bday;
-            continue;
-        }
-        if (strncmp(buffer, "ANNIVERSARY", 11) == 0)
-        {
-            DateTime* ann = (DateTime*)malloc(sizeof(DateTime));
-            if (ann == NULL)
-            {
-                fclose(fptr);
-                return INV_DT;
-            }
-
-            VCardErrorCode annErr = createDateTime(ann, buffer);
-            if (annErr != OK)
-            {
-                fclose(fptr);
-                deleteDate(ann);
-                return annErr;
-            }
-
-            (*obj)->anniversary = ann;
-            continue;
-        }
-
-        char propBuffer[320] = "";
-        strcpy(propBuffer, buffer);
-
-        while (1)
-        {
-            int nextChar = fgetc(fptr);
-            if (nextChar != ' ' && nextChar != '\t')
-            {
-                if (nextChar != EOF)
-                {
-                    ungetc(nextChar, fptr);
-                }                    
-                break;
-            }
-
-            if (fgets(buffer, sizeof(buffer), fptr) == NULL)
-            {
-                break;
-            }
-
-            VCardErrorCode clrErr = removeCRLF(buffer);
-            if (clrErr != OK)
-            {
-                return clrErr;
-            }
-
-            removeSpace(buffer);
-
-            if (strlen(propBuffer) + strlen(buffer) < sizeof(propBuffer) - 1)
-            {
-                strcat(propBuffer, buffer);
-            }
-            else
-            {
-                break;
-            }
-        }
-
-        Property* prop = (Property*)malloc(sizeof(Property));
-
-        if (prop == NULL)
-        {
-            fclose(fptr);
-            return INV_PROP;
-        }
-        
-        VCardErrorCode propErr = createProperty(prop, propBuffer);
+        err = finishCardParser(&parser);
+    }
 
-        if (propErr != OK)
-        {
-            fclose(fptr);
-            deleteProperty(prop);
-            return propErr;
-        }
+    free(line);
+    fclose(fptr);
 
-        insertBack((*obj)->optionalProperties, prop);
+    if (err != OK)
+    {
+        deleteCard((*obj));
+        (*obj) = NULL;
     }
-    fclose(fptr);
-    return OK;
+
+    return err;
+}
+
+VCardErrorCode createCard(char* fileName, Card** obj)
+{
+    return readCardFile(fileName, obj, false);
+}
+
+VCardErrorCode createCardInArena(char* fileName, Card** obj)
+{
+    return readCardFile(fileName, obj, true);
 }
 
 void deleteCard(Card* obj)
@@ -175,6 +77,14 @@ void deleteCard(Card* obj)
         return;
     }
 
+    freePropertyIndex(obj);
+
+    if (obj->arena != NULL)
+    {
+        freeArena(obj->arena);
+        return;
+    }
+
     deleteProperty(obj->fn);
 
     freeList(obj->optionalProperties);
@@ -192,27 +102,18 @@ char* cardToString(const Card* obj)
         return NULL;
     }
 
-    int len = 0;
-
-    char* fnStr = propertyToString(obj->fn);
-    char* propStr = toString(obj->optionalProperties);
-    char* fullBirStr = bdayText(obj->birthday);
-    char* fullAnnStr = annText(obj->anniversary);
+    //Measure, then fill a single allocation of the exact size
+    TextBuffer buf;
+    initMeasuringBuffer(&buf);
+    appendCardSummary(&buf, obj);
 
-    len += strlen(fnStr) + strlen(propStr) + strlen(fullBirStr) + strlen(fullAnnStr) + 1;
-    char* str = (char*)malloc(len);
-    if (str == NULL)
+    if (!allocateMeasured(&buf))
     {
         return NULL;
     }
 
-    sprintf(str, "%s%s%s%s", fnStr, propStr, fullBirStr, fullAnnStr);
-
-    free(fnStr);
-    free(propStr);
-    free(fullBirStr);
-    free(fullAnnStr);
-    return str;
+    appendCardSummary(&buf, obj);
+    return buf.data;
 }
 
 char* errorToString(VCardErrorCode err)
@@ -258,8 +159,8 @@ void deleteProperty(void* toBeDeleted)
 
     Property* toDelete = (Property*)toBeDeleted;
 
-    free(toDelete->name);
-    free(toDelete->group);
+    freeUnlessInterned(toDelete->name);
+    freeUnlessInterned(toDelete->group);
 
     freeList(toDelete->parameters);
     freeList(toDelete->values);
@@ -277,12 +178,12 @@ int compareProperties(const void* first,const void* second)
     Property* pro1 = (Property*)first;
     Property* pro2 = (Property*)second;
 
-    if (strcmp(pro1->name, pro2->name) != 0)
+    if (!internEquals(pro1->name, pro2->name))
     {
         return false;
     }
     
-    if (strcmp(pro1->group, pro2->group) != 0)
+    if (!internEquals(pro1->group, pro2->group))
     {
         return false;
     }
@@ -304,45 +205,17 @@ int compareProperties(const void* first,const void* second)
 
 char* propertyToString(void* prop)
 {
-    if (prop == NULL)
-    {
-        char* temp = (char*)malloc(sizeof(char) * 1);
-        temp[0] = '\0';
-        return temp;
-    }
-
-    Property* pro = (Property*)prop;
-
-    char* paramStr = toString(pro->parameters);
-    char* valStr = toString(pro->values);
-
-    int len = strlen(pro->name) + strlen(pro->group) + strlen(paramStr) + strlen(valStr) + 5;
-    char* str = (char*)malloc(sizeof(char)*len);
+    TextBuffer buf;
+    initMeasuringBuffer(&buf);
+    appendProperty(&buf, (Property*)prop);
 
-    size_t paramLen = strlen(paramStr);
-    if (paramLen > 0 && paramStr[paramLen - 1] == ';') {
-        paramStr[paramLen - 1] = '\0';
-    }
-
-    size_t valLen = strlen(valStr);
-    if (valLen > 0 && valStr[valLen - 1] == ';') {
-        valStr[valLen - 1] = '\0';
-    }
-
-
-    if (pro->group == NULL || strlen(pro->group) == 0)
+    if (!allocateMeasured(&buf))
     {
-        sprintf(str, "%s%s:%s", pro->name, paramStr, valStr);
-    }
-    else
-    {
-        sprintf(str, "%s.%s%s:%s", pro->group, pro->name, paramStr, valStr);
+        return NULL;
     }
-        
-    free(paramStr);
-    free(valStr);
 
-    return str;
+    appendProperty(&buf, (Property*)prop);
+    return buf.data;
 }
 
 
@@ -355,8 +228,8 @@ void deleteParameter(void* toBeDeleted)
 
     Parameter* toDelete = (Parameter*)toBeDeleted;
 
-    free(toDelete->name);
-    free(toDelete->value);
+    freeUnlessInterned(toDelete->name);
+    freeUnlessInterned(toDelete->value);
     free(toDelete);
 }
 
@@ -370,12 +243,12 @@ int compareParameters(const void* first,const void* second)
     Parameter* par1 = (Parameter*)first;
     Parameter* par2 = (Parameter*)second;
 
-    if (strcmp(par1->name, par2->name) != 0)
+    if (!internEquals(par1->name, par2->name))
     {
         return false;
     }
     
-    if (strcmp(par1->value, par2->value) != 0)
+    if (!internEquals(par1->value, par2->value))
     {
         return false;
     }
@@ -499,104 +372,24 @@ int compareDates(const void* first,const void* second)
 
 char* dateToString(void* date)
 {
-    if (date == NULL)
-    {
-        char* temp = (char*)malloc(1);
-        temp[0] = '\0';
-        return temp;
-    }
-
-    DateTime* dateTime = (DateTime*)date;
-
-    if (dateTime->isText)
-    {
-        char* str = (char*)malloc(strlen(dateTime->text) + 1);
-        if (str != NULL)
-        {
-            strcpy(str, dateTime->text);
-        }
-        return str;
-    }
-
-    size_t len = strlen(dateTime->date) + strlen(dateTime->time) + 3;
-    char* str = (char*)malloc(len);
-
-    if (strlen(dateTime->date) > 0 && strlen(dateTime->time) > 0)
-    {
-        sprintf(str, "%sT%s", dateTime->date, dateTime->time);
-    }
-    else if (strlen(dateTime->date) > 0)
-    {
-        sprintf(str, "%s", dateTime->date);
-    }
-    else if (strlen(dateTime->time) > 0)
-    {
-        sprintf(str, "T%s", dateTime->time);
-    }
+    TextBuffer buf;
+    initMeasuringBuffer(&buf);
+    appendDate(&buf, (DateTime*)date);
 
-    if (dateTime->UTC)
+    if (!allocateMeasured(&buf))
     {
-        strcat(str, "Z");
+        return NULL;
     }
 
-    return str;
+    appendDate(&buf, (DateTime*)date);
+    return buf.data;
 }
 
 
 
 VCardErrorCode writeCard(const char* fileName, const Card* obj)
 {
-    if (obj == NULL) return WRITE_ERROR;
-
-    VCardErrorCode filenameErr = validateFileName(fileName);
-    if (filenameErr != OK) return WRITE_ERROR;
-
-    FILE * fptr = fopen(fileName, "w");
-    if (fptr == NULL) return WRITE_ERROR;
-
-
-    fprintf(fptr, "BEGIN:VCARD\r\n");
-    fprintf(fptr, "VERSION:4.0\r\n");
-
-
-    if (obj->fn == NULL) return WRITE_ERROR;
-    char* fnStr = propertyToString(obj->fn);
-    fprintf(fptr, "%s\r\n", fnStr);
-
-    free(fnStr);
-
-
-    if (obj->birthday != NULL) 
-    {
-        char* fullBirStr = bdayText(obj->birthday);
-        fprintf(fptr, "%s\r\n", fullBirStr);
-        free(fullBirStr);
-    }
-
-    if (obj->anniversary != NULL) 
-    {
-        char* fullAnnStr = annText(obj->anniversary);
-        fprintf(fptr, "%s\r\n", fullAnnStr);
-        free(fullAnnStr);
-    }
-
-    
-    ListIterator iter = createIterator(obj->optionalProperties);
-    void * elem;
-    while ((elem = nextElement(&iter)) != NULL)
-    {
-        Property* prop = (Property*)elem;
-        
-        char* propStr = propertyToString(prop);
-        fprintf(fptr, "%s\r\n", propStr);
-        free(propStr);
-    }
-
-    fprintf(fptr, "END:VCARD\r\n");
-
-
-    fclose(fptr);
-    return OK;
+    return writeCardWithFlags(fileName, obj, 0);
 }
 
 VCardErrorCode validateCard(const Card* obj)
@@ -613,6 +406,8 @@ VCardErrorCode validateCard(const Card* obj)
 
     if (obj->optionalProperties == NULL) return INV_CARD;
 
+    uint64_t seen = 0;
+
     ListIterator iter = createIterator(obj->optionalProperties);
     void * elem;
     while ((elem = nextElement(&iter)) != NULL)
@@ -622,7 +417,7 @@ VCardErrorCode validateCard(const Card* obj)
         VCardErrorCode propErr = validateProperty(prop);
         if (propErr != OK) return propErr;
         
-        VCardErrorCode cardnalityErr = cardnalityCheck(prop->name);
+        VCardErrorCode cardnalityErr = cardnalityCheck(prop->kind, &seen);
         if (cardnalityErr != OK) return cardnalityErr;
     }
 
@@ -0,0 +1,226 @@
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+#include "VCPush.h"
+
+
+VCardParser* vcardParserNew(CardCallback onCard, void* userData)
+{
+    if (onCard == NULL) return NULL;
+
+    VCardParser* ctx = (VCardParser*)calloc(1, sizeof(VCardParser));
+    if (ctx == NULL) return NULL;
+
+    ctx->onCard = onCard;
+    ctx->userData = userData;
+
+    return ctx;
+}
+
+static bool appendBytes(char** buffer, size_t* len, size_t* size, const char* bytes, size_t count)
+{
+    if (*len + count > *size)
+    {
+        size_t newSize = (*size == 0) ? 128 : *size;
+        while (newSize < *len + count) newSize *= 2;
+
+        char* tmp = (char*)realloc(*buffer, newSize);
+        if (tmp == NULL) return false;
+
+        *buffer = tmp;
+        *size = newSize;
+    }
+
+    memcpy(*buffer + *len, bytes, count);
+    *len += count;
+    return true;
+}
+
+static bool isBegin(const char* line, size_t len)
+{
+    return hasPrefix(line, len, "BEGIN:VCARD");
+}
+
+//Hands the current card to the callback, or its error if it is not valid
+static void closeCard(VCardParser* ctx, VCardErrorCode err)
+{
+    if (err == OK) err = finishCardParser(&ctx->parser);
+
+    if (err != OK)
+    {
+        deleteCard(ctx->card);
+        ctx->card = NULL;
+        ctx->resync = true;
+        ctx->onCard(NULL, err, ctx->userData);
+        return;
+    }
+
+    Card* card = ctx->card;
+    ctx->card = NULL;
+    ctx->onCard(card, OK, ctx->userData);
+}
+
+//One complete, unfolded line
+static VCardErrorCode dispatchLine(VCardParser* ctx, const char* line, size_t len)
+{
+    if (ctx->card != NULL && ctx->parser.state == IN_CARD && isBegin(line, len))
+    {
+        //A new card started before END:VCARD
+        closeCard(ctx, OK);
+    }
+
+    if (ctx->card == NULL)
+    {
+        if (len == 0) return OK;
+        if (ctx->resync && !isBegin(line, len)) return OK;
+        ctx->resync = false;
+
+        ctx->card = initializeCard(ctx->useArena);
+        if (ctx->card == NULL) return OTHER_ERROR;
+
+        initCardParser(&ctx->parser, ctx->card);
+    }
+
+    VCardErrorCode err = parseCardLine(&ctx->parser, line, len);
+
+    if (err != OK) closeCard(ctx, err);
+    else if (ctx->parser.state == AFTER_END) closeCard(ctx, OK);
+
+    return OK;
+}
+
+//First byte of a physical line: anything but a fold ends the logical line held so far
+static VCardErrorCode startPhysicalLine(VCardParser* ctx, char first)
+{
+    if (first == ' ' || first == '\t') return OK;
+
+    ctx->endDispatched = false;
+    if (!ctx->haveLogical) return OK;
+
+    ctx->haveLogical = false;
+    return dispatchLine(ctx, ctx->logical, ctx->logicalLen);
+}
+
+/*  A card is reported when its END:VCARD line arrives, not when the line after it starts.
+    Folds cannot make END:VCARD anything else, so any that follow are dropped.
+*/
+static VCardErrorCode dispatchIfEnd(VCardParser* ctx)
+{
+    if (!hasPrefix(ctx->logical, ctx->logicalLen, "END:VCARD")) return OK;
+
+    ctx->haveLogical = false;
+    ctx->endDispatched = true;
+    return dispatchLine(ctx, ctx->logical, ctx->logicalLen);
+}
+
+//One complete physical line, CRLF removed
+static VCardErrorCode handlePhysicalLine(VCardParser* ctx, const char* line, size_t len)
+{
+    if (len > 0 && (line[0] == ' ' || line[0] == '\t'))
+    {
+        //The END:VCARD this continues was already dispatched, and a fold cannot change it
+        if (ctx->endDispatched) return OK;
+
+        if (ctx->haveLogical)
+        {
+            //Same as removeSpace, all leading whitespace of the continuation goes
+            while (len > 0 && (*line == ' ' || *line == '\t'))
+            {
+                line++;
+                len--;
+            }
+
+            if (!appendBytes(&ctx->logical, &ctx->logicalLen, &ctx->logicalSize, line, len)) return OTHER_ERROR;
+            return dispatchIfEnd(ctx);
+        }
+    }
+
+    if (ctx->haveLogical)
+    {
+        ctx->haveLogical = false;
+        VCardErrorCode err = dispatchLine(ctx, ctx->logical, ctx->logicalLen);
+        if (err != OK) return err;
+    }
+
+    ctx->logicalLen = 0;
+    ctx->haveLogical = true;
+
+    if (!appendBytes(&ctx->logical, &ctx->logicalLen, &ctx->logicalSize, line, len)) return OTHER_ERROR;
+    return dispatchIfEnd(ctx);
+}
+
+VCardErrorCode vcardParserFeed(VCardParser* ctx, const char* bytes, size_t len)
+{
+    if (ctx == NULL || (bytes == NULL && len > 0)) return OTHER_ERROR;
+
+    const char* pos = bytes;
+    const char* end = bytes + len;
+
+    while (pos < end)
+    {
+        if (ctx->partialLen == 0)
+        {
+            VCardErrorCode err = startPhysicalLine(ctx, *pos);
+            if (err != OK) return err;
+        }
+
+        const char* newline = memchr(pos, '\n', end - pos);
+
+        if (newline == NULL)
+        {
+            if (!appendBytes(&ctx->partial, &ctx->partialLen, &ctx->partialSize, pos, end - pos)) return OTHER_ERROR;
+            break;
+        }
+
+        const char* line = pos;
+        size_t lineLen = newline - pos;
+
+        //Start of this line came in an earlier chunk
+        if (ctx->partialLen > 0)
+        {
+            if (!appendBytes(&ctx->partial, &ctx->partialLen, &ctx->partialSize, pos, lineLen)) return OTHER_ERROR;
+            line = ctx->partial;
+            lineLen = ctx->partialLen;
+        }
+
+        if (lineLen > 0 && line[lineLen - 1] == '\r') lineLen--;
+
+        VCardErrorCode err = handlePhysicalLine(ctx, line, lineLen);
+        ctx->partialLen = 0;
+        if (err != OK) return err;
+
+        pos = newline + 1;
+    }
+
+    return OK;
+}
+
+VCardErrorCode vcardParserFinish(VCardParser* ctx)
+{
+    if (ctx == NULL) return OTHER_ERROR;
+
+    VCardErrorCode err = OK;
+
+    if (ctx->partialLen > 0)
+    {
+        size_t lineLen = ctx->partialLen;
+        if (ctx->partial[lineLen - 1] == '\r') lineLen--;
+
+        err = handlePhysicalLine(ctx, ctx->partial, lineLen);
+    }
+
+    if (err == OK && ctx->haveLogical)
+    {
+        ctx->haveLogical = false;
+        err = dispatchLine(ctx, ctx->logical, ctx->logicalLen);
+    }
+
+    //Input ended inside a card
+    if (ctx->card != NULL) closeCard(ctx, OK);
+
+    free(ctx->partial);
+    free(ctx->logical);
+    free(ctx);
+
+    return err;
+}
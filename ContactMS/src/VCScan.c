@@ -0,0 +1,162 @@
+#include <stdlib.h>
+
+#include "VCScan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+
+static inline bool isDelimiter(char ch)
+{
+    return ch == ':' || ch == ';' || ch == '.' || ch == '=' || ch == '"';
+}
+
+static inline void addPosition(uint32_t* positions, size_t capacity, size_t* count, size_t pos)
+{
+    if (*count < capacity) positions[*count] = (uint32_t)pos;
+    (*count)++;
+}
+
+//Appends the set bits of mask as offsets from base
+static inline void addMask(uint32_t* positions, size_t capacity, size_t* count, size_t base, uint32_t mask)
+{
+    while (mask != 0)
+    {
+        addPosition(positions, capacity, count, base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+static size_t scanTail(const char* str, size_t start, size_t len, uint32_t* positions, size_t capacity, size_t count)
+{
+    for (size_t i = start; i < len; i++)
+    {
+        if (isDelimiter(str[i])) addPosition(positions, capacity, &count, i);
+    }
+
+    return count;
+}
+
+size_t scanDelimitersScalar(const char* str, size_t len, uint32_t* positions, size_t capacity)
+{
+    return scanTail(str, 0, len, positions, capacity, 0);
+}
+
+#ifdef SCAN_X86
+
+//16 bytes at a time from start; inlined into both scanners so the AVX2 one stays VEX encoded
+static inline size_t scanBlocks16(const char* str, size_t start, size_t len, uint32_t* positions, size_t capacity, size_t* count)
+{
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i semicolon = _mm_set1_epi8(';');
+    const __m128i dot = _mm_set1_epi8('.');
+    const __m128i equals = _mm_set1_epi8('=');
+    const __m128i quote = _mm_set1_epi8('"');
+
+    size_t i = start;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(str + i));
+
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, colon), _mm_cmpeq_epi8(chunk, semicolon)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, dot), _mm_cmpeq_epi8(chunk, equals)),
+                         _mm_cmpeq_epi8(chunk, quote)));
+
+        addMask(positions, capacity, count, i, (uint32_t)_mm_movemask_epi8(hits));
+    }
+
+    return i;
+}
+
+static size_t scanSSE2(const char* str, size_t len, uint32_t* positions, size_t capacity)
+{
+    size_t count = 0;
+    size_t i = scanBlocks16(str, 0, len, positions, capacity, &count);
+
+    return scanTail(str, i, len, positions, capacity, count);
+}
+
+__attribute__((target("avx2")))
+static size_t scanAVX2(const char* str, size_t len, uint32_t* positions, size_t capacity)
+{
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i semicolon = _mm256_set1_epi8(';');
+    const __m256i dot = _mm256_set1_epi8('.');
+    const __m256i equals = _mm256_set1_epi8('=');
+    const __m256i quote = _mm256_set1_epi8('"');
+
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(str + i));
+
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, colon), _mm256_cmpeq_epi8(chunk, semicolon)),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, dot), _mm256_cmpeq_epi8(chunk, equals)),
+                            _mm256_cmpeq_epi8(chunk, quote)));
+
+        addMask(positions, capacity, &count, i, (uint32_t)_mm256_movemask_epi8(hits));
+    }
+
+    //Leaving dirty upper halves makes every later SSE instruction in the process pay a transition penalty
+    _mm256_zeroupper();
+
+    //Last 16..31 bytes
+    i = scanBlocks16(str, i, len, positions, capacity, &count);
+
+    return scanTail(str, i, len, positions, capacity, count);
+}
+
+static size_t (*scanImpl)(const char*, size_t, uint32_t*, size_t) = &scanSSE2;
+
+//Picks the widest scanner the CPU supports when the library is loaded
+__attribute__((constructor))
+static void selectScanner(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) scanImpl = &scanAVX2;
+}
+
+#else
+
+static size_t (*scanImpl)(const char*, size_t, uint32_t*, size_t) = &scanDelimitersScalar;
+
+#endif
+
+size_t scanDelimiters(const char* str, size_t len, uint32_t* positions, size_t capacity)
+{
+    return scanImpl(str, len, positions, capacity);
+}
+
+bool scanLine(DelimiterScan* scan, const char* str, size_t len)
+{
+    scan->str = str;
+    scan->positions = scan->inlinePositions;
+    scan->count = scanDelimiters(str, len, scan->positions, SCAN_INLINE_POSITIONS);
+
+    if (scan->count > SCAN_INLINE_POSITIONS)
+    {
+        scan->positions = (uint32_t*)malloc(scan->count * sizeof(uint32_t));
+        if (scan->positions == NULL)
+        {
+            scan->positions = scan->inlinePositions;
+            return false;
+        }
+
+        scanDelimiters(str, len, scan->positions, scan->count);
+    }
+
+    return true;
+}
+
+void freeScan(DelimiterScan* scan)
+{
+    if (scan->positions != scan->inlinePositions) free(scan->positions);
+    scan->positions = scan->inlinePositions;
+}
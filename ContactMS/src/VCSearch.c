@@ -0,0 +1,555 @@
+#include "LinkedListAPI.h"
+#include "OrderedListAPI.h"
+#include "VCParser.h"
+#include "VCSearch.h"
+
+//Slots of the trigram table when it is first needed, a power of two
+#define GRAM_INITIAL_SLOTS 1024
+
+//Ids are renumbered when the removed ones are half of them, and at least this many
+#define MIN_REMOVED_IDS 4096
+
+static unsigned char foldByte(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static void foldCopy(char* dest, const char* src, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        dest[i] = (char)foldByte((unsigned char)src[i]);
+    }
+    dest[len] = '\0';
+}
+
+static bool sameFolded(const char* a, const char* b)
+{
+    while (*a != '\0' && foldByte((unsigned char)*a) == foldByte((unsigned char)*b))
+    {
+        a++;
+        b++;
+    }
+
+    return *a == *b;
+}
+
+//The top byte is set so no trigram is 0, the empty slot
+static uint32_t gramAt(const char* text)
+{
+    const unsigned char* p = (const unsigned char*)text;
+
+    return (1u << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+//Text, then id; a term with no entry (a search key) comes first
+static int compareTerms(const void* first, const void* second)
+{
+    const SearchTerm* a = (const SearchTerm*)first;
+    const SearchTerm* b = (const SearchTerm*)second;
+
+    int cmp = strcmp(a->text, b->text);
+    if (cmp != 0) return cmp;
+    if (a->entry == NULL || b->entry == NULL) return (a->entry != NULL) - (b->entry != NULL);
+
+    return (a->entry->id > b->entry->id) - (a->entry->id < b->entry->id);
+}
+
+static char* printTerm(void* toBePrinted)
+{
+    const char* text = ((SearchTerm*)toBePrinted)->text;
+
+    char* str = (char*)malloc(strlen(text) + 1);
+    if (str != NULL) strcpy(str, text);
+
+    return str;
+}
+
+//Terms belong to their entries
+static void deleteNothing(void* toBeDeleted)
+{
+    (void)toBeDeleted;
+}
+
+static int compareGrams(const void* first, const void* second)
+{
+    uint32_t a = *(const uint32_t*)first;
+    uint32_t b = *(const uint32_t*)second;
+
+    return (a > b) - (a < b);
+}
+
+//Room for the trigrams of every term of an entry
+static size_t maxGrams(const SearchEntry* entry)
+{
+    size_t count = 0;
+
+    for (int i = 0; i < entry->termCount; i++)
+    {
+        size_t len = strlen(entry->terms[i].text);
+        if (len >= 3) count += len - 2;
+    }
+
+    return count;
+}
+
+//Writes the distinct trigrams of an entry to grams, sorted, and returns how many there are
+static size_t getGrams(const SearchEntry* entry, uint32_t* grams)
+{
+    size_t count = 0;
+
+    for (int i = 0; i < entry->termCount; i++)
+    {
+        const char* text = entry->terms[i].text;
+        size_t len = strlen(text);
+
+        for (size_t j = 0; j + 3 <= len; j++)
+        {
+            grams[count++] = gramAt(text + j);
+        }
+    }
+
+    qsort(grams, count, sizeof(uint32_t), &compareGrams);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (unique == 0 || grams[unique - 1] != grams[i]) grams[unique++] = grams[i];
+    }
+
+    return unique;
+}
+
+static size_t gramSlot(uint32_t gram, size_t mask)
+{
+    return (size_t)(((uint64_t)gram * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+//Slot of gram in the table: its own, or the empty one where it would go
+static GramPostings* findGram(const SearchIndex* index, uint32_t gram)
+{
+    size_t mask = index->gramCapacity - 1;
+
+    for (size_t i = gramSlot(gram, mask); ; i = (i + 1) & mask)
+    {
+        GramPostings* slot = &index->grams[i];
+        if (slot->gram == 0 || slot->gram == gram) return slot;
+    }
+}
+
+static bool growGrams(SearchIndex* index)
+{
+    size_t capacity = (index->gramCapacity == 0) ? GRAM_INITIAL_SLOTS : index->gramCapacity * 2;
+
+    GramPostings* slots = (GramPostings*)calloc(capacity, sizeof(GramPostings));
+    if (slots == NULL) return false;
+
+    GramPostings* old = index->grams;
+    size_t oldCapacity = index->gramCapacity;
+
+    index->grams = slots;
+    index->gramCapacity = capacity;
+
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (old[i].gram != 0) (*findGram(index, old[i].gram)) = old[i];
+    }
+
+    free(old);
+    return true;
+}
+
+//Ids only grow, so appending keeps postings sorted
+static bool addPosting(SearchIndex* index, uint32_t gram, int id)
+{
+    if ((index->gramCount + 1) * 4 > index->gramCapacity * 3 && !growGrams(index)) return false;
+
+    GramPostings* slot = findGram(index, gram);
+    if (slot->count == slot->capacity)
+    {
+        uint32_t capacity = (slot->capacity == 0) ? 4 : slot->capacity * 2;
+        uint32_t* tmp = (uint32_t*)realloc(slot->ids, capacity * sizeof(uint32_t));
+        if (tmp == NULL) return false;
+
+        slot->ids = tmp;
+        slot->capacity = capacity;
+    }
+
+    if (slot->gram == 0)
+    {
+        slot->gram = gram;
+        index->gramCount++;
+    }
+
+    slot->ids[slot->count++] = (uint32_t)id;
+
+    return true;
+}
+
+//Drops the ids of removed entries and numbers the others from 0, in the same order, so
+//postings and the order of equal terms stay sorted
+static void renumberEntries(SearchIndex* index)
+{
+    int* newIds = (int*)malloc((index->entryCount + 1) * sizeof(int));
+    if (newIds == NULL) return;
+
+    int count = 0;
+    for (int id = 0; id < index->entryCount; id++)
+    {
+        newIds[id] = (index->entries[id] != NULL) ? count++ : -1;
+    }
+
+    for (size_t i = 0; i < index->gramCapacity; i++)
+    {
+        GramPostings* slot = &index->grams[i];
+        uint32_t kept = 0;
+
+        for (uint32_t j = 0; j < slot->count; j++)
+        {
+            int id = newIds[slot->ids[j]];
+            if (id >= 0) slot->ids[kept++] = (uint32_t)id;
+        }
+        slot->count = kept;
+    }
+
+    for (int id = 0; id < index->entryCount; id++)
+    {
+        SearchEntry* entry = index->entries[id];
+        if (entry == NULL) continue;
+
+        entry->id = newIds[id];
+        index->entries[entry->id] = entry;
+    }
+
+    index->entryCount = count;
+    index->removedCount = 0;
+
+    free(newIds);
+}
+
+VCardErrorCode createSearchIndex(SearchIndex** index)
+{
+    if (index == NULL) return OTHER_ERROR;
+
+    (*index) = (SearchIndex*)calloc(1, sizeof(SearchIndex));
+    if ((*index) == NULL) return OTHER_ERROR;
+
+    (*index)->terms = initializeOrderedList(&printTerm, &deleteNothing, &compareTerms);
+    if ((*index)->terms == NULL)
+    {
+        free(*index);
+        (*index) = NULL;
+        return OTHER_ERROR;
+    }
+
+    return OK;
+}
+
+void freeSearchIndex(SearchIndex* index)
+{
+    if (index == NULL) return;
+
+    freeOrderedList(index->terms);
+
+    for (int id = 0; id < index->entryCount; id++)
+    {
+        free(index->entries[id]);
+    }
+    for (size_t i = 0; i < index->gramCapacity; i++)
+    {
+        free(index->grams[i].ids);
+    }
+
+    free(index->entries);
+    free(index->grams);
+    free(index);
+}
+
+//Copies the distinct non-empty terms, folded, after the struct
+static SearchEntry* createSearchEntry(void* item, const char* const* terms, int count)
+{
+    int termCount = 0;
+    size_t textLen = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (terms[i] == NULL || terms[i][0] == '\0') continue;
+
+        bool repeat = false;
+        for (int j = 0; j < i && !repeat; j++)
+        {
+            repeat = terms[j] != NULL && sameFolded(terms[i], terms[j]);
+        }
+        if (repeat) continue;
+
+        termCount++;
+        textLen += strlen(terms[i]) + 1;
+    }
+
+    SearchEntry* entry = (SearchEntry*)malloc(sizeof(SearchEntry) + termCount * sizeof(SearchTerm) + textLen);
+    if (entry == NULL) return NULL;
+
+    entry->item = item;
+    entry->id = -1;
+    entry->stamp = 0;
+    entry->termCount = 0;
+
+    char* str = (char*)(entry->terms + termCount);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (terms[i] == NULL || terms[i][0] == '\0') continue;
+
+        bool repeat = false;
+        for (int j = 0; j < entry->termCount && !repeat; j++)
+        {
+            repeat = sameFolded(terms[i], entry->terms[j].text);
+        }
+        if (repeat) continue;
+
+        size_t len = strlen(terms[i]);
+        foldCopy(str, terms[i], len);
+
+        entry->terms[entry->termCount].text = str;
+        entry->terms[entry->termCount].entry = entry;
+        entry->termCount++;
+
+        str += len + 1;
+    }
+
+    return entry;
+}
+
+VCardErrorCode addSearchEntry(SearchIndex* index, void* item, const char* const* terms, int count, SearchEntry** entry)
+{
+    if (index == NULL || (terms == NULL && count > 0) || entry == NULL) return OTHER_ERROR;
+
+    if (index->entryCount == index->entryCapacity)
+    {
+        int capacity = (index->entryCapacity == 0) ? 64 : index->entryCapacity * 2;
+        SearchEntry** tmp = (SearchEntry**)realloc(index->entries, capacity * sizeof(SearchEntry*));
+        if (tmp == NULL) return OTHER_ERROR;
+
+        index->entries = tmp;
+        index->entryCapacity = capacity;
+    }
+
+    SearchEntry* newEntry = createSearchEntry(item, terms, count);
+    if (newEntry == NULL) return OTHER_ERROR;
+
+    uint32_t* grams = (uint32_t*)malloc((maxGrams(newEntry) + 1) * sizeof(uint32_t));
+    if (grams == NULL)
+    {
+        free(newEntry);
+        return OTHER_ERROR;
+    }
+
+    newEntry->id = index->entryCount++;
+    index->entries[newEntry->id] = NULL;
+
+    //After a failure the id counts as removed, and the postings already added go with it
+    size_t gramCount = getGrams(newEntry, grams);
+    for (size_t i = 0; i < gramCount; i++)
+    {
+        if (!addPosting(index, grams[i], newEntry->id))
+        {
+            index->removedCount++;
+            free(grams);
+            free(newEntry);
+            return OTHER_ERROR;
+        }
+    }
+    free(grams);
+
+    index->entries[newEntry->id] = newEntry;
+
+    //insertOrdered cannot report a failed allocation; a term missing from the list only
+    //loses its prefix matches
+    for (int i = 0; i < newEntry->termCount; i++)
+    {
+        insertOrdered(index->terms, &newEntry->terms[i]);
+    }
+
+    (*entry) = newEntry;
+    return OK;
+}
+
+void removeSearchEntry(SearchIndex* index, SearchEntry* entry)
+{
+    if (index == NULL || entry == NULL) return;
+
+    for (int i = 0; i < entry->termCount; i++)
+    {
+        removeFromOrdered(index->terms, &entry->terms[i]);
+    }
+
+    index->entries[entry->id] = NULL;
+    index->removedCount++;
+    free(entry);
+
+    if (index->removedCount >= MIN_REMOVED_IDS && index->removedCount * 2 >= index->entryCount)
+    {
+        renumberEntries(index);
+    }
+}
+
+static void nextStamp(SearchIndex* index)
+{
+    if (++index->stamp != 0) return;
+
+    for (int id = 0; id < index->entryCount; id++)
+    {
+        if (index->entries[id] != NULL) index->entries[id]->stamp = 0;
+    }
+    index->stamp = 1;
+}
+
+//Adds the item of an entry unless this query returned it already
+static void addResult(SearchIndex* index, SearchEntry* entry, void** items, int* count)
+{
+    if (entry == NULL || entry->stamp == index->stamp) return;
+
+    entry->stamp = index->stamp;
+    items[(*count)++] = entry->item;
+}
+
+static bool entryContains(const SearchEntry* entry, const char* text)
+{
+    for (int i = 0; i < entry->termCount; i++)
+    {
+        if (strstr(entry->terms[i].text, text) != NULL) return true;
+    }
+
+    return false;
+}
+
+//First position at or after from with an id of at least id: doubling steps, then a binary search
+static uint32_t seekPosting(const GramPostings* postings, uint32_t from, uint32_t id)
+{
+    uint32_t step = 1;
+    uint32_t lo = from;
+    uint32_t hi = from;
+
+    while (hi < postings->count && postings->ids[hi] < id)
+    {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > postings->count) hi = postings->count;
+
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (postings->ids[mid] < id) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+static int compareCounts(const void* first, const void* second)
+{
+    uint32_t a = (*(const GramPostings* const*)first)->count;
+    uint32_t b = (*(const GramPostings* const*)second)->count;
+
+    return (a > b) - (a < b);
+}
+
+//Substring matches: the ids in the postings of every trigram of text, checked against the terms
+//since the trigrams may come from different terms
+static void querySubstrings(SearchIndex* index, const char* text, size_t len, void** items, int limit, int* count)
+{
+    if (index->gramCapacity == 0) return;
+
+    size_t listCount = len - 2;
+    const GramPostings** lists = (const GramPostings**)malloc(listCount * sizeof(GramPostings*));
+    uint32_t* positions = (uint32_t*)calloc(listCount, sizeof(uint32_t));
+    if (lists == NULL || positions == NULL)
+    {
+        free(lists);
+        free(positions);
+        return;
+    }
+
+    bool empty = false;
+    for (size_t i = 0; i < listCount && !empty; i++)
+    {
+        lists[i] = findGram(index, gramAt(text + i));
+        empty = lists[i]->count == 0;
+    }
+
+    if (!empty)
+    {
+        qsort(lists, listCount, sizeof(GramPostings*), &compareCounts);
+
+        //Leapfrog join: each list in turn moves to the first id not below the largest seen so far,
+        //so runs of ids missing from any one list are skipped without looking at them
+        uint32_t target = 0;
+        size_t agree = 0;
+
+        for (size_t j = 0; (*count) < limit; j = (j + 1) % listCount)
+        {
+            positions[j] = seekPosting(lists[j], positions[j], target);
+            if (positions[j] == lists[j]->count) break;
+
+            uint32_t id = lists[j]->ids[positions[j]];
+            if (id != target)
+            {
+                target = id;
+                agree = 1;
+            }
+            else
+            {
+                agree++;
+            }
+
+            if (agree == listCount)
+            {
+                SearchEntry* entry = index->entries[target];
+                if (entry != NULL && entry->stamp != index->stamp && entryContains(entry, text))
+                {
+                    addResult(index, entry, items, count);
+                }
+
+                target++;
+                agree = 0;
+            }
+        }
+    }
+
+    free(lists);
+    free(positions);
+}
+
+int querySearchIndex(SearchIndex* index, const char* text, void** items, int limit)
+{
+    if (index == NULL || text == NULL || items == NULL || limit <= 0) return 0;
+
+    size_t len = strlen(text);
+    char* folded = (char*)malloc(len + 1);
+    if (folded == NULL) return 0;
+
+    foldCopy(folded, text, len);
+    nextStamp(index);
+
+    int count = 0;
+
+    //Terms starting with text are together in the term list, from the first term not before it
+    SearchTerm key = {folded, NULL};
+    ListIterator iter = orderedIteratorFrom(index->terms, &key);
+
+    SearchTerm* term;
+    while (count < limit && (term = (SearchTerm*)nextElement(&iter)) != NULL && strncmp(term->text, folded, len) == 0)
+    {
+        addResult(index, term->entry, items, &count);
+    }
+
+    if (count < limit && len >= 3)
+    {
+        querySubstrings(index, folded, len, items, limit, &count);
+    }
+
+    free(folded);
+    return count;
+}
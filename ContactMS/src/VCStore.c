@@ -0,0 +1,445 @@
+#include <strings.h>
+
+#include "LinkedListAPI.h"
+#include "OrderedListAPI.h"
+#include "VCParser.h"
+#include "VCAPIHelpers.h"
+#include "VCDates.h"
+#include "VCSearch.h"
+#include "VCStore.h"
+
+//Only dates with a month go into the date indexes
+static void getMonthDay(const DateTime* date, int* month, int* day)
+{
+    uint32_t packed = packDate(date);
+
+    (*month) = DATE_MONTH(packed);
+    (*day) = (*month != 0) ? DATE_DAY(packed) : 0;
+}
+
+//Name ignoring case, then exactly, then file name; a NULL name (a search key) comes first
+static int compareByName(const StoredContact* a, const StoredContact* b)
+{
+    if (a->name == NULL || b->name == NULL) return (a->name != NULL) - (b->name != NULL);
+
+    int cmp = strcasecmp(a->name, b->name);
+    if (cmp == 0) cmp = strcmp(a->name, b->name);
+    if (cmp == 0) cmp = strcmp(a->fileName, b->fileName);
+
+    return cmp;
+}
+
+static int compareMonthDay(int monthA, int dayA, int monthB, int dayB)
+{
+    if (monthA != monthB) return (monthA > monthB) - (monthA < monthB);
+    return (dayA > dayB) - (dayA < dayB);
+}
+
+static int compareFiles(const void* first, const void* second)
+{
+    return strcmp(((const StoredContact*)first)->fileName, ((const StoredContact*)second)->fileName);
+}
+
+static int compareNames(const void* first, const void* second)
+{
+    return compareByName((const StoredContact*)first, (const StoredContact*)second);
+}
+
+static int compareBirthdays(const void* first, const void* second)
+{
+    const StoredContact* a = (const StoredContact*)first;
+    const StoredContact* b = (const StoredContact*)second;
+
+    int cmp = compareMonthDay(a->birthdayMonth, a->birthdayDay, b->birthdayMonth, b->birthdayDay);
+    return (cmp != 0) ? cmp : compareByName(a, b);
+}
+
+static int compareAnniversaries(const void* first, const void* second)
+{
+    const StoredContact* a = (const StoredContact*)first;
+    const StoredContact* b = (const StoredContact*)second;
+
+    int cmp = compareMonthDay(a->anniversaryMonth, a->anniversaryDay, b->anniversaryMonth, b->anniversaryDay);
+    return (cmp != 0) ? cmp : compareByName(a, b);
+}
+
+static char* printStoredContact(void* toBePrinted)
+{
+    const char* fileName = ((StoredContact*)toBePrinted)->fileName;
+
+    char* str = (char*)malloc(strlen(fileName) + 1);
+    if (str != NULL) strcpy(str, fileName);
+
+    return str;
+}
+
+static void deleteStoredContact(void* toBeDeleted)
+{
+    free(toBeDeleted);
+}
+
+//The other indexes share the contacts owned by byFile
+static void deleteNothing(void* toBeDeleted)
+{
+    (void)toBeDeleted;
+}
+
+//Copies the strings after the struct, in one allocation
+static StoredContact* createStoredContact(const char* fileName, const char* name, const char* birthday, const char* anniversary)
+{
+    size_t fileLen = strlen(fileName) + 1;
+    size_t nameLen = strlen(name) + 1;
+    size_t birthdayLen = strlen(birthday) + 1;
+    size_t anniversaryLen = strlen(anniversary) + 1;
+
+    StoredContact* contact = (StoredContact*)malloc(sizeof(StoredContact) + fileLen + nameLen + birthdayLen + anniversaryLen);
+    if (contact == NULL) return NULL;
+
+    char* str = (char*)(contact + 1);
+
+    contact->fileName = memcpy(str, fileName, fileLen);
+    str += fileLen;
+    contact->name = memcpy(str, name, nameLen);
+    str += nameLen;
+    contact->birthday = memcpy(str, birthday, birthdayLen);
+    str += birthdayLen;
+    contact->anniversary = memcpy(str, anniversary, anniversaryLen);
+
+    contact->propCount = 0;
+    contact->birthdayMonth = 0;
+    contact->birthdayDay = 0;
+    contact->anniversaryMonth = 0;
+    contact->anniversaryDay = 0;
+    contact->search = NULL;
+
+    return contact;
+}
+
+static void indexContact(ContactStore* store, StoredContact* contact)
+{
+    insertOrdered(store->byFile, contact);
+    insertOrdered(store->byName, contact);
+    if (contact->birthdayMonth != 0) insertOrdered(store->byBirthday, contact);
+    if (contact->anniversaryMonth != 0) insertOrdered(store->byAnniversary, contact);
+}
+
+static StoredContact* unindexContact(ContactStore* store, const char* fileName)
+{
+    StoredContact key = {0};
+    key.fileName = (char*)fileName;
+
+    StoredContact* contact = (StoredContact*)deleteDataFromOrdered(store->byFile, &key);
+    if (contact == NULL) return NULL;
+
+    removeFromOrdered(store->byName, contact);
+    if (contact->birthdayMonth != 0) removeFromOrdered(store->byBirthday, contact);
+    if (contact->anniversaryMonth != 0) removeFromOrdered(store->byAnniversary, contact);
+    removeSearchEntry(store->search, contact->search);
+
+    return contact;
+}
+
+//The values the search index has for a card: FN, every N component and EMAIL
+static const char** getSearchTerms(const Card* card, int* count)
+{
+    int capacity = 1;
+
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property* prop;
+    while ((prop = (Property*)nextElement(&iter)) != NULL)
+    {
+        if (prop->kind == PROP_N) capacity += getLength(prop->values);
+        else if (prop->kind == PROP_FN || prop->kind == PROP_EMAIL) capacity++;
+    }
+
+    const char** terms = (const char**)malloc(capacity * sizeof(char*));
+    if (terms == NULL) return NULL;
+
+    (*count) = 0;
+    terms[(*count)++] = (const char*)getFromFront(card->fn->values);
+
+    iter = createIterator(card->optionalProperties);
+    while ((prop = (Property*)nextElement(&iter)) != NULL)
+    {
+        if (prop->kind == PROP_N)
+        {
+            ListIterator values = createIterator(prop->values);
+            const char* value;
+            while ((value = (const char*)nextElement(&values)) != NULL) terms[(*count)++] = value;
+        }
+        else if (prop->kind == PROP_FN || prop->kind == PROP_EMAIL)
+        {
+            terms[(*count)++] = (const char*)getFromFront(prop->values);
+        }
+    }
+
+    return terms;
+}
+
+VCardErrorCode createContactStore(ContactStore** store)
+{
+    if (store == NULL) return OTHER_ERROR;
+
+    (*store) = (ContactStore*)malloc(sizeof(ContactStore));
+    if ((*store) == NULL) return OTHER_ERROR;
+
+    (*store)->byFile = initializeOrderedList(&printStoredContact, &deleteStoredContact, &compareFiles);
+    (*store)->byName = initializeOrderedList(&printStoredContact, &deleteNothing, &compareNames);
+    (*store)->byBirthday = initializeOrderedList(&printStoredContact, &deleteNothing, &compareBirthdays);
+    (*store)->byAnniversary = initializeOrderedList(&printStoredContact, &deleteNothing, &compareAnniversaries);
+    (*store)->search = NULL;
+
+    if ((*store)->byFile == NULL || (*store)->byName == NULL || (*store)->byBirthday == NULL || (*store)->byAnniversary == NULL ||
+        createSearchIndex(&(*store)->search) != OK)
+    {
+        freeContactStore(*store);
+        (*store) = NULL;
+        return OTHER_ERROR;
+    }
+
+    return OK;
+}
+
+void freeContactStore(ContactStore* store)
+{
+    if (store == NULL) return;
+
+    freeOrderedList(store->byAnniversary);
+    freeOrderedList(store->byBirthday);
+    freeOrderedList(store->byName);
+    freeOrderedList(store->byFile);
+    freeSearchIndex(store->search);
+
+    free(store);
+}
+
+VCardErrorCode storeContact(ContactStore* store, const char* fileName, const Card* card)
+{
+    if (store == NULL || fileName == NULL || card == NULL) return OTHER_ERROR;
+    if (card->fn == NULL || getFromFront(card->fn->values) == NULL) return INV_CARD;
+
+    char* birthday = (card->birthday != NULL) ? dateToString(card->birthday) : NULL;
+    char* anniversary = (card->anniversary != NULL) ? dateToString(card->anniversary) : NULL;
+
+    StoredContact* contact = createStoredContact(fileName, (char*)getFromFront(card->fn->values),
+                                                 (birthday != NULL) ? birthday : "", (anniversary != NULL) ? anniversary : "");
+    free(birthday);
+    free(anniversary);
+
+    if (contact == NULL) return OTHER_ERROR;
+
+    contact->propCount = getLength(card->optionalProperties);
+    getMonthDay(card->birthday, &contact->birthdayMonth, &contact->birthdayDay);
+    getMonthDay(card->anniversary, &contact->anniversaryMonth, &contact->anniversaryDay);
+
+    int termCount = 0;
+    const char** terms = getSearchTerms(card, &termCount);
+    VCardErrorCode err = (terms != NULL) ? addSearchEntry(store->search, contact, terms, termCount, &contact->search) : OTHER_ERROR;
+    free(terms);
+
+    if (err != OK)
+    {
+        free(contact);
+        return err;
+    }
+
+    free(unindexContact(store, fileName));
+    indexContact(store, contact);
+
+    //insertOrdered cannot report a failed allocation. Missing from byFile, the contact would leak;
+    //missing from another index, it only drops out of that index's queries
+    StoredContact key = {0};
+    key.fileName = contact->fileName;
+    if (findOrdered(store->byFile, &key) != contact)
+    {
+        removeFromOrdered(store->byName, contact);
+        removeFromOrdered(store->byBirthday, contact);
+        removeFromOrdered(store->byAnniversary, contact);
+        removeSearchEntry(store->search, contact->search);
+        free(contact);
+        return OTHER_ERROR;
+    }
+
+    return OK;
+}
+
+bool unstoreContact(ContactStore* store, const char* fileName)
+{
+    if (store == NULL || fileName == NULL) return false;
+
+    StoredContact* contact = unindexContact(store, fileName);
+    free(contact);
+
+    return contact != NULL;
+}
+
+bool renameStoredContact(ContactStore* store, const char* oldFileName, const char* newFileName)
+{
+    if (store == NULL || oldFileName == NULL || newFileName == NULL) return false;
+
+    StoredContact key = {0};
+    key.fileName = (char*)oldFileName;
+
+    StoredContact* old = (StoredContact*)findOrdered(store->byFile, &key);
+    if (old == NULL) return false;
+    if (strcmp(oldFileName, newFileName) == 0) return true;
+
+    StoredContact* contact = createStoredContact(newFileName, old->name, old->birthday, old->anniversary);
+    if (contact == NULL) return false;
+
+    contact->propCount = old->propCount;
+    contact->birthdayMonth = old->birthdayMonth;
+    contact->birthdayDay = old->birthdayDay;
+    contact->anniversaryMonth = old->anniversaryMonth;
+    contact->anniversaryDay = old->anniversaryDay;
+
+    //The search entry has the card's terms, which the store does not keep, so it moves over
+    contact->search = old->search;
+    if (contact->search != NULL) contact->search->item = contact;
+    old->search = NULL;
+
+    free(unindexContact(store, oldFileName));
+    free(unindexContact(store, newFileName));
+    indexContact(store, contact);
+
+    return true;
+}
+
+int getStoredContactCount(ContactStore* store)
+{
+    return (store != NULL) ? getOrderedLength(store->byFile) : 0;
+}
+
+//Same truncation as the snprintf calls of getContact, without parsing a format
+static void copyField(char* dest, size_t size, const char* src)
+{
+    size_t len = strlen(src);
+    if (len >= size) len = size - 1;
+
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+}
+
+static void toContact(const StoredContact* stored, Contact* out)
+{
+    copyField(out->file_name, sizeof(out->file_name), stored->fileName);
+    copyField(out->name, sizeof(out->name), stored->name);
+    copyField(out->birthday, sizeof(out->birthday), stored->birthday);
+    copyField(out->anniversary, sizeof(out->anniversary), stored->anniversary);
+    out->prop_count = stored->propCount;
+}
+
+bool findStoredContact(ContactStore* store, const char* fileName, Contact* out)
+{
+    if (store == NULL || fileName == NULL) return false;
+
+    StoredContact key = {0};
+    key.fileName = (char*)fileName;
+
+    StoredContact* contact = (StoredContact*)findOrdered(store->byFile, &key);
+    if (contact == NULL) return false;
+
+    if (out != NULL) toContact(contact, out);
+    return true;
+}
+
+//Copies the page [offset, offset + limit) of the positions [first, end) of an index
+static int copyPage(OrderedList* index, int first, int end, int offset, int limit, Contact* out, int* total)
+{
+    int count = end - first;
+    if (total != NULL) (*total) = count;
+
+    if (out == NULL || offset < 0 || limit <= 0 || offset >= count) return 0;
+    if (limit > count - offset) limit = count - offset;
+
+    ListIterator iter = orderedIteratorAt(index, first + offset);
+    for (int i = 0; i < limit; i++)
+    {
+        toContact((StoredContact*)nextElement(&iter), &out[i]);
+    }
+
+    return limit;
+}
+
+int queryContactsByName(ContactStore* store, int offset, int limit, Contact* out, int* total)
+{
+    if (store == NULL)
+    {
+        if (total != NULL) (*total) = 0;
+        return 0;
+    }
+
+    return copyPage(store->byName, 0, getOrderedLength(store->byName), offset, limit, out, total);
+}
+
+//Positions of the contacts of index on month, or month/day, found from the ranks of the two bounding keys
+static int queryDates(OrderedList* index, bool birthday, int month, int day, int offset, int limit, Contact* out, int* total)
+{
+    if (month < 1 || month > 12 || day < 0 || day > 31)
+    {
+        if (total != NULL) (*total) = 0;
+        return 0;
+    }
+
+    //Keys with no name sort before every contact on their date
+    StoredContact from = {0};
+    StoredContact to = {0};
+
+    int* fromMonth = birthday ? &from.birthdayMonth : &from.anniversaryMonth;
+    int* fromDay = birthday ? &from.birthdayDay : &from.anniversaryDay;
+    int* toMonth = birthday ? &to.birthdayMonth : &to.anniversaryMonth;
+    int* toDay = birthday ? &to.birthdayDay : &to.anniversaryDay;
+
+    (*fromMonth) = month;
+    (*fromDay) = day;
+    if (day == 0)
+    {
+        (*toMonth) = month + 1;
+    }
+    else
+    {
+        (*toMonth) = month;
+        (*toDay) = day + 1;
+    }
+
+    return copyPage(index, orderedRank(index, &from), orderedRank(index, &to), offset, limit, out, total);
+}
+
+int queryContactsByBirthday(ContactStore* store, int month, int day, int offset, int limit, Contact* out, int* total)
+{
+    if (store == NULL)
+    {
+        if (total != NULL) (*total) = 0;
+        return 0;
+    }
+
+    return queryDates(store->byBirthday, true, month, day, offset, limit, out, total);
+}
+
+int queryContactsByAnniversary(ContactStore* store, int month, int day, int offset, int limit, Contact* out, int* total)
+{
+    if (store == NULL)
+    {
+        if (total != NULL) (*total) = 0;
+        return 0;
+    }
+
+    return queryDates(store->byAnniversary, false, month, day, offset, limit, out, total);
+}
+
+int searchContacts(ContactStore* store, const char* text, int limit, Contact* out)
+{
+    if (store == NULL || text == NULL || out == NULL || limit <= 0) return 0;
+
+    void** items = (void**)malloc(limit * sizeof(void*));
+    if (items == NULL) return 0;
+
+    int count = querySearchIndex(store->search, text, items, limit);
+    for (int i = 0; i < count; i++)
+    {
+        toContact((StoredContact*)items[i], &out[i]);
+    }
+
+    free(items);
+    return count;
+}
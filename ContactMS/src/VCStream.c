@@ -0,0 +1,113 @@
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCHelpers.h"
+#include "VCValidate.h"
+#include "VCStream.h"
+
+
+VCardErrorCode openCardStream(const char* fileName, CardStream** stream)
+{
+    (*stream) = NULL;
+
+    VCardErrorCode filenameErr = validateFileName(fileName);
+    if (filenameErr != OK) return filenameErr;
+
+    FILE* fptr = fopen(fileName, "r");
+    if (fptr == NULL) return INV_FILE;
+
+    (*stream) = (CardStream*)malloc(sizeof(CardStream));
+    if ((*stream) == NULL)
+    {
+        fclose(fptr);
+        return OTHER_ERROR;
+    }
+
+    (*stream)->fptr = fptr;
+    (*stream)->line = NULL;
+    (*stream)->size = 0;
+    (*stream)->pending = false;
+    (*stream)->resync = false;
+    (*stream)->count = 0;
+    (*stream)->useArena = false;
+
+    return OK;
+}
+
+static bool nextLine(CardStream* stream)
+{
+    if (stream->pending)
+    {
+        stream->pending = false;
+        return true;
+    }
+
+    return readFoldedLine(stream->fptr, &stream->line, &stream->size);
+}
+
+static bool isBegin(const char* line)
+{
+    return hasPrefix(line, strlen(line), "BEGIN:VCARD");
+}
+
+VCardErrorCode nextCard(CardStream* stream, Card** obj)
+{
+    (*obj) = NULL;
+
+    if (stream == NULL) return OTHER_ERROR;
+
+    //Find the start of the next card, skipping blank lines and the rest of a bad card
+    while (1)
+    {
+        if (!nextLine(stream)) return OK;
+
+        if (stream->line[0] == '\0') continue;
+        if (stream->resync && !isBegin(stream->line)) continue;
+        break;
+    }
+    stream->resync = false;
+    stream->count++;
+
+    Card* card = initializeCard(stream->useArena);
+    if (card == NULL) return OTHER_ERROR;
+
+    CardParser parser;
+    initCardParser(&parser, card);
+
+    VCardErrorCode err = parseCardLine(&parser, stream->line, strlen(stream->line));
+
+    while (err == OK && parser.state != AFTER_END && nextLine(stream))
+    {
+        //A new card started before END:VCARD, leave it for the next call
+        if (parser.state == IN_CARD && isBegin(stream->line))
+        {
+            stream->pending = true;
+            break;
+        }
+
+        err = parseCardLine(&parser, stream->line, strlen(stream->line));
+    }
+
+    if (err == OK)
+    {
+        err = finishCardParser(&parser);
+    }
+
+    if (err != OK)
+    {
+        deleteCard(card);
+        stream->resync = !stream->pending;
+        return err;
+    }
+
+    (*obj) = card;
+    return OK;
+}
+
+void closeCardStream(CardStream* stream)
+{
+    if (stream == NULL) return;
+
+    fclose(stream->fptr);
+    free(stream->line);
+    free(stream);
+}
@@ -12,128 +12,6 @@ VCardErrorCode validateFileName(const char* fileName)
     return INV_FILE;
 }
 
-VCardErrorCode validateFileCard(FILE* fptr, Card* obj)
-{
-    char buffer[78];
-
-    if (fgets(buffer, sizeof(buffer), fptr) == NULL)
-    {
-        return INV_CARD;
-    } 
-    if (strncmp(buffer, "BEGIN:VCARD", 11) != 0)
-    {
-        return INV_CARD;
-    }
-    
-    if (fgets(buffer, sizeof(buffer), fptr) == NULL)
-    {
-        return INV_CARD;
-    } 
-    if (strncmp(buffer, "VERSION:4.0", 11) != 0)
-    {
-        return INV_CARD;
-    }
-
-    int startPos = ftell(fptr);
-    if (startPos == -1)
-    {
-        fclose(fptr);
-        return OTHER_ERROR;
-    }
-    
-    int fn = 0;
-    while (fgets(buffer, sizeof(buffer), fptr) != NULL)
-    {
-        VCardErrorCode err = removeCRLF(buffer);
-        if (err != OK)
-        {
-            return err;
-        }
-        if (strncmp(buffer, "FN:", 3) == 0)
-        {
-            fn = 1;
-
-            char ch = checkNextChar(fptr);
-            char propBuffer[320] = "";
-            strcpy(propBuffer, buffer);
-
-            while (ch == ' ' || ch == '\t')
-            {
-                if (fgets(buffer, sizeof(buffer), fptr) == NULL)
-                {
-                    break;
-                }
-                
-                err = removeCRLF(buffer);
-                if (err != OK)
-                {
-                    return err;
-                }
-                removeSpace(buffer);
-
-                if (strlen(propBuffer) + strlen(buffer) < 319)
-                {
-                    strcat(propBuffer, buffer);
-                }
-                ch = checkNextChar(fptr);
-            }
-
-            Property* prop = (Property*)malloc(sizeof(Property));
-
-            if (prop == NULL)
-            {
-                fclose(fptr);
-                return OTHER_ERROR;
-            }
-        
-            VCardErrorCode err = createProperty(prop, propBuffer);
-            if (err != OK)
-            {
-                fclose(fptr);
-                deleteProperty(prop);
-                return err;
-            }
-
-            obj->fn = prop;
-            break;
-        }
-    }
-    if (!fn) 
-    {
-        return INV_PROP;
-    }
-
-    int end = 0;
-    while (fgets(buffer, sizeof(buffer), fptr) != NULL)
-    {
-        if (strncmp(buffer, "END:VCARD", 9) == 0)
-        {
-            end = 1;
-            break;
-        }
-    }
-    if (!end)
-    {
-        return INV_CARD;
-    }
-
-    while (fgets(buffer, sizeof(buffer), fptr) != NULL)
-    {
-        if (strlen(buffer) > 1)
-        {
-            return INV_CARD;
-        }
-    }
-
-    if (fseek(fptr, startPos, SEEK_SET) != 0)
-    {
-        return OTHER_ERROR;
-    }
-
-    return OK;
-}
-
-
 VCardErrorCode validateDateTime(const DateTime* date)
 {
     if (date->date == NULL || date->time == NULL || date->text == NULL) return INV_DT;
@@ -187,98 +65,36 @@ VCardErrorCode validateProperty(const Property* prop)
     return OK;
 }
 
-VCardErrorCode cardnalityCheck(const char* name)
-{
-    static int kind = 0;
-    static int n = 0;
-    static int gender = 0;
-    static int prodid = 0;
-    static int rev = 0;
-    static int uid = 0;
-
-
-    if (strcmp(name, "VERSION") == 0 || strcmp(name, "FN") == 0)
-    {
-        kind = 0;
-        n = 0;
-        gender = 0;
-        prodid = 0;
-        rev = 0;
-        uid = 0;
-        return INV_CARD;
-    }
-
-    if (strcmp(name, "BDAY") == 0 || strcmp(name, "ANN") == 0)
-    {
-        kind = 0;
-        n = 0;
-        gender = 0;
-        prodid = 0;
-        rev = 0;
-        uid = 0;
-        return INV_DT;
-    }
-
-    if (strcmp(name, "KIND") == 0)
-    {
-        kind++;
-        if (kind > 1)
-        {
-            kind = 0;
-            return INV_PROP;
-        }
-    }
-
-    if (strcmp(name, "N") == 0)
-    {
-        n++;
-        if (n > 1)
-        {
-            n = 0;
-            return INV_PROP;
-        }
-    }
-
-    if (strcmp(name, "GENDER") == 0)
-    {
-        gender++;
-        if (gender > 1)
-        {
-            gender = 0;
-            return INV_PROP;
-        }
-    }
-    
-    if (strcmp(name, "PRODID") == 0)
-    {
-        prodid++;
-        if (prodid > 1)
-        {
-            prodid = 0;
-            return INV_PROP;
-        }
-    }
+_Static_assert(PROP_CALURI < 64, "cardnalityCheck keeps one bit per PropertyKind in a uint64_t");
 
-    if (strcmp(name, "REV") == 0)
+VCardErrorCode cardnalityCheck(PropertyKind kind, uint64_t* seen)
+{
+    switch (kind)
     {
-        rev++;
-        if (rev > 1)
-        {
-            rev = 0;
-            return INV_PROP;
-        }
+        //These have their own fields in Card
+        case PROP_VERSION:
+        case PROP_FN:
+            return INV_CARD;
+        case PROP_BDAY:
+        case PROP_ANNIVERSARY:
+            return INV_DT;
+
+        //At most one of each
+        case PROP_KIND:
+        case PROP_N:
+        case PROP_GENDER:
+        case PROP_PRODID:
+        case PROP_REV:
+        case PROP_UID:
+            break;
+        default:
+            return OK;
     }
 
-    if (strcmp(name, "UID") == 0)
-    {
-        uid++;
-        if (uid > 1)
-        {
-            uid = 0;
-            return INV_PROP;
-        }
-    }
+    uint64_t bit = (uint64_t)1 << kind;
+    if (*seen & bit) return INV_PROP;
 
+    *seen |= bit;
     return OK;
 }
 
@@ -0,0 +1,283 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCValidate.h"
+#include "VCWatch.h"
+
+#define WATCH_EVENTS (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF)
+
+static bool isCardFile(const char* name)
+{
+    return name != NULL && validateFileName(name) == OK;
+}
+
+static char* copyString(const char* str)
+{
+    char* copy = (char*)malloc(strlen(str) + 1);
+    if (copy != NULL) strcpy(copy, str);
+    return copy;
+}
+
+//Removes name from the created set, true if it was there
+static bool takeCreated(CardWatcher* watcher, const char* name)
+{
+    for (size_t i = 0; i < watcher->createdCount; i++)
+    {
+        if (strcmp(watcher->created[i], name) == 0)
+        {
+            free(watcher->created[i]);
+            watcher->created[i] = watcher->created[--watcher->createdCount];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void addCreated(CardWatcher* watcher, const char* name)
+{
+    takeCreated(watcher, name);
+
+    if (watcher->createdCount == watcher->createdCapacity)
+    {
+        size_t capacity = (watcher->createdCapacity == 0) ? 16 : watcher->createdCapacity * 2;
+        char** tmp = (char**)realloc(watcher->created, capacity * sizeof(char*));
+        if (tmp == NULL) return;
+        watcher->created = tmp;
+        watcher->createdCapacity = capacity;
+    }
+
+    char* copy = copyString(name);
+    if (copy != NULL) watcher->created[watcher->createdCount++] = copy;
+}
+
+//Parses and validates one file of the directory, then reports it
+static void reportParsed(CardWatcher* watcher, CardChange change, const char* name)
+{
+    size_t pathLen = strlen(watcher->dirName) + strlen(name) + 2;
+    char* path = (char*)malloc(pathLen);
+    Card* card = NULL;
+    VCardErrorCode err = OTHER_ERROR;
+
+    if (path != NULL)
+    {
+        snprintf(path, pathLen, "%s/%s", watcher->dirName, name);
+
+        err = createCard(path, &card);
+        if (err == OK) err = validateCard(card);
+        if (err != OK)
+        {
+            deleteCard(card);
+            card = NULL;
+        }
+
+        free(path);
+    }
+
+    watcher->onChange(change, name, NULL, card, err, watcher->userData);
+}
+
+//A move out of the directory, or to a name that is not a card file
+static int flushMoveFrom(CardWatcher* watcher)
+{
+    if (watcher->moveFrom == NULL) return 0;
+
+    int reported = 0;
+    if (isCardFile(watcher->moveFrom))
+    {
+        watcher->onChange(CARD_DELETED, watcher->moveFrom, NULL, NULL, OK, watcher->userData);
+        reported = 1;
+    }
+
+    free(watcher->moveFrom);
+    watcher->moveFrom = NULL;
+    return reported;
+}
+
+static int handleMoveTo(CardWatcher* watcher, const struct inotify_event* event)
+{
+    char* from = NULL;
+    if (watcher->moveFrom != NULL && watcher->moveCookie == event->cookie)
+    {
+        from = watcher->moveFrom;
+        watcher->moveFrom = NULL;
+    }
+
+    int reported = flushMoveFrom(watcher);
+    bool fromCard = isCardFile(from);
+
+    if (isCardFile(event->name))
+    {
+        if (fromCard) watcher->onChange(CARD_RENAMED, event->name, from, NULL, OK, watcher->userData);
+        else reportParsed(watcher, CARD_CREATED, event->name);
+        reported++;
+    }
+    else if (fromCard)
+    {
+        watcher->onChange(CARD_DELETED, from, NULL, NULL, OK, watcher->userData);
+        reported++;
+    }
+
+    free(from);
+    return reported;
+}
+
+static int handleEvent(CardWatcher* watcher, const struct inotify_event* event)
+{
+    if (event->mask & IN_MOVED_TO) return handleMoveTo(watcher, event);
+
+    //Anything but the matching IN_MOVED_TO ends a pending move
+    int reported = flushMoveFrom(watcher);
+
+    if (event->mask & IN_MOVED_FROM)
+    {
+        watcher->moveFrom = copyString(event->name);
+        watcher->moveCookie = event->cookie;
+        return reported;
+    }
+
+    if (!isCardFile(event->name)) return reported;
+
+    if (event->mask & IN_CREATE)
+    {
+        addCreated(watcher, event->name);
+    }
+    else if (event->mask & IN_CLOSE_WRITE)
+    {
+        CardChange change = takeCreated(watcher, event->name) ? CARD_CREATED : CARD_MODIFIED;
+        reportParsed(watcher, change, event->name);
+        reported++;
+    }
+    else if (event->mask & IN_DELETE)
+    {
+        takeCreated(watcher, event->name);
+        watcher->onChange(CARD_DELETED, event->name, NULL, NULL, OK, watcher->userData);
+        reported++;
+    }
+
+    return reported;
+}
+
+VCardErrorCode openCardWatcher(const char* dirName, CardChangeCallback onChange, void* userData, CardWatcher** watcher)
+{
+    (*watcher) = NULL;
+
+    if (dirName == NULL || onChange == NULL) return INV_FILE;
+
+    CardWatcher* newWatcher = (CardWatcher*)calloc(1, sizeof(CardWatcher));
+    if (newWatcher == NULL) return OTHER_ERROR;
+
+    newWatcher->fd = -1;
+    newWatcher->wd = -1;
+    newWatcher->onChange = onChange;
+    newWatcher->userData = userData;
+
+    newWatcher->dirName = copyString(dirName);
+    if (newWatcher->dirName == NULL)
+    {
+        closeCardWatcher(newWatcher);
+        return OTHER_ERROR;
+    }
+
+    newWatcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (newWatcher->fd != -1) newWatcher->wd = inotify_add_watch(newWatcher->fd, dirName, WATCH_EVENTS | IN_ONLYDIR);
+
+    if (newWatcher->fd == -1 || newWatcher->wd == -1)
+    {
+        closeCardWatcher(newWatcher);
+        return INV_FILE;
+    }
+
+    (*watcher) = newWatcher;
+    return OK;
+}
+
+int processCardChanges(CardWatcher* watcher, int timeoutMs)
+{
+    if (watcher == NULL || watcher->wd == -1) return -1;
+
+    struct pollfd pfd = {watcher->fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready == 0 || (ready == -1 && errno == EINTR)) return 0;
+    if (ready == -1)
+    {
+        watcher->wd = -1;
+        return -1;
+    }
+
+    _Alignas(struct inotify_event) char buf[4096];
+    int reported = 0;
+    bool gone = false;
+    bool overflowed = false;
+
+    while (true)
+    {
+        ssize_t len = read(watcher->fd, buf, sizeof(buf));
+        if (len == -1 && errno == EINTR) continue;
+        if (len <= 0)
+        {
+            if (len == -1 && errno != EAGAIN) gone = true;
+            break;
+        }
+
+        for (char* pos = buf; pos < buf + len; )
+        {
+            const struct inotify_event* event = (const struct inotify_event*)pos;
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                gone = true;
+                continue;
+            }
+
+            //The queue overflowed and events were lost; reported once, after what did arrive
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                overflowed = true;
+                continue;
+            }
+
+            if (event->len == 0) continue;
+
+            reported += handleEvent(watcher, event);
+        }
+    }
+
+    //Both halves of a rename are queued together, so an unmatched move was out of the directory
+    reported += flushMoveFrom(watcher);
+
+    if (overflowed)
+    {
+        watcher->onChange(CARD_RESCAN, NULL, NULL, NULL, OK, watcher->userData);
+        reported++;
+    }
+
+    if (gone)
+    {
+        watcher->wd = -1;
+        return -1;
+    }
+
+    return reported;
+}
+
+void closeCardWatcher(CardWatcher* watcher)
+{
+    if (watcher == NULL) return;
+
+    if (watcher->fd != -1) close(watcher->fd);
+
+    for (size_t i = 0; i < watcher->createdCount; i++) free(watcher->created[i]);
+
+    free(watcher->created);
+    free(watcher->moveFrom);
+    free(watcher->dirName);
+    free(watcher);
+}
@@ -0,0 +1,404 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LinkedListAPI.h"
+#include "VCParser.h"
+#include "VCValidate.h"
+#include "VCWriter.h"
+
+//Makes temporary names unique between threads of one process
+static atomic_uint tempCounter;
+
+//Symbolic links followed before giving up, the same limit as the kernel's
+#define MAX_LINK_DEPTH 40
+
+//Write buffer of each thread, kept between writeCard calls and freed when the thread exits
+static pthread_once_t writeBufferOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t writeBufferKey;
+
+void initTextBuffer(TextBuffer* buf)
+{
+    buf->data = NULL;
+    buf->len = 0;
+    buf->capacity = 0;
+    buf->failed = false;
+    buf->measuring = false;
+}
+
+void initMeasuringBuffer(TextBuffer* buf)
+{
+    initTextBuffer(buf);
+    buf->measuring = true;
+}
+
+bool allocateMeasured(TextBuffer* buf)
+{
+    size_t len = buf->len;
+
+    initTextBuffer(buf);
+    buf->data = (char*)malloc(len + 1);
+    if (buf->data == NULL) return false;
+
+    buf->data[0] = '\0';
+    buf->capacity = len + 1;
+    return true;
+}
+
+static void deleteWriteBuffer(void* data)
+{
+    freeTextBuffer((TextBuffer*)data);
+    free(data);
+}
+
+static void createWriteBufferKey(void)
+{
+    pthread_key_create(&writeBufferKey, &deleteWriteBuffer);
+}
+
+static TextBuffer* threadWriteBuffer(void)
+{
+    pthread_once(&writeBufferOnce, &createWriteBufferKey);
+
+    TextBuffer* buf = (TextBuffer*)pthread_getspecific(writeBufferKey);
+    if (buf == NULL)
+    {
+        buf = (TextBuffer*)malloc(sizeof(TextBuffer));
+        if (buf == NULL) return NULL;
+
+        initTextBuffer(buf);
+        if (pthread_setspecific(writeBufferKey, buf) != 0)
+        {
+            free(buf);
+            return NULL;
+        }
+    }
+
+    return buf;
+}
+
+static bool reserveText(TextBuffer* buf, size_t extra)
+{
+    if (buf->failed) return false;
+    if (buf->len + extra < buf->capacity) return true;
+
+    size_t capacity = (buf->capacity == 0) ? 256 : buf->capacity;
+    while (capacity <= buf->len + extra) capacity *= 2;
+
+    char* tmp = (char*)realloc(buf->data, capacity);
+    if (tmp == NULL)
+    {
+        buf->failed = true;
+        return false;
+    }
+
+    buf->data = tmp;
+    buf->capacity = capacity;
+    return true;
+}
+
+void appendText(TextBuffer* buf, const char* text, size_t len)
+{
+    if (buf->measuring)
+    {
+        buf->len += len;
+        return;
+    }
+
+    if (!reserveText(buf, len)) return;
+
+    memcpy(buf->data + buf->len, text, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+void appendString(TextBuffer* buf, const char* str)
+{
+    if (str != NULL) appendText(buf, str, strlen(str));
+}
+
+void freeTextBuffer(TextBuffer* buf)
+{
+    free(buf->data);
+    initTextBuffer(buf);
+}
+
+void appendProperty(TextBuffer* buf, const Property* prop)
+{
+    if (prop == NULL) return;
+
+    if (prop->group != NULL && prop->group[0] != '\0')
+    {
+        appendString(buf, prop->group);
+        appendText(buf, ".", 1);
+    }
+    appendString(buf, prop->name);
+
+    ListIterator iter = createIterator(prop->parameters);
+    void* elem;
+    while ((elem = nextElement(&iter)) != NULL)
+    {
+        Parameter* param = (Parameter*)elem;
+
+        appendText(buf, ";", 1);
+        appendString(buf, param->name);
+        appendText(buf, "=", 1);
+        appendString(buf, param->value);
+    }
+
+    appendText(buf, ":", 1);
+
+    iter = createIterator(prop->values);
+    bool first = true;
+    while ((elem = nextElement(&iter)) != NULL)
+    {
+        if (!first) appendText(buf, ";", 1);
+        appendString(buf, (char*)elem);
+        first = false;
+    }
+}
+
+void appendDate(TextBuffer* buf, const DateTime* date)
+{
+    if (date == NULL) return;
+
+    if (date->isText)
+    {
+        appendString(buf, date->text);
+        return;
+    }
+
+    if (date->date[0] != '\0') appendString(buf, date->date);
+    if (date->time[0] != '\0')
+    {
+        appendText(buf, "T", 1);
+        appendString(buf, date->time);
+    }
+    if (date->UTC) appendText(buf, "Z", 1);
+}
+
+void appendCardSummary(TextBuffer* buf, const Card* obj)
+{
+    if (obj == NULL) return;
+
+    appendProperty(buf, obj->fn);
+
+    ListIterator iter = createIterator(obj->optionalProperties);
+    void* elem;
+    while ((elem = nextElement(&iter)) != NULL)
+    {
+        appendProperty(buf, (Property*)elem);
+    }
+
+    if (obj->birthday != NULL)
+    {
+        appendString(buf, "BDAY:");
+        appendDate(buf, obj->birthday);
+    }
+
+    if (obj->anniversary != NULL)
+    {
+        appendString(buf, "ANNIVERSARY:");
+        appendDate(buf, obj->anniversary);
+    }
+}
+
+bool appendCard(TextBuffer* buf, const Card* obj)
+{
+    if (obj == NULL || obj->fn == NULL) return false;
+
+    appendString(buf, "BEGIN:VCARD\r\nVERSION:4.0\r\n");
+    appendProperty(buf, obj->fn);
+    appendText(buf, "\r\n", 2);
+
+    if (obj->birthday != NULL)
+    {
+        appendString(buf, "BDAY:");
+        appendDate(buf, obj->birthday);
+        appendText(buf, "\r\n", 2);
+    }
+
+    if (obj->anniversary != NULL)
+    {
+        appendString(buf, "ANNIVERSARY:");
+        appendDate(buf, obj->anniversary);
+        appendText(buf, "\r\n", 2);
+    }
+
+    ListIterator iter = createIterator(obj->optionalProperties);
+    void* elem;
+    while ((elem = nextElement(&iter)) != NULL)
+    {
+        appendProperty(buf, (Property*)elem);
+        appendText(buf, "\r\n", 2);
+    }
+
+    appendString(buf, "END:VCARD\r\n");
+    return true;
+}
+
+//fsync the directory holding fileName, so a rename into it is on disk
+static bool syncDirectory(const char* fileName)
+{
+    const char* slash = strrchr(fileName, '/');
+    char* dirName;
+
+    if (slash == NULL)
+    {
+        dirName = NULL;
+    }
+    else
+    {
+        size_t len = (slash == fileName) ? 1 : (size_t)(slash - fileName);
+        dirName = (char*)malloc(len + 1);
+        if (dirName == NULL) return false;
+
+        memcpy(dirName, fileName, len);
+        dirName[len] = '\0';
+    }
+
+    int fd = open((dirName != NULL) ? dirName : ".", O_RDONLY | O_DIRECTORY);
+    free(dirName);
+    if (fd == -1) return false;
+
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+/*  The file a write to fileName ends up in: symbolic links are followed, even to a file
+    that does not exist yet, so the link is kept and its target is replaced.
+    Returns a malloc'd path, NULL if malloc fails or the links go round in a loop.
+*/
+static char* resolveLinks(const char* fileName)
+{
+    char* path = strdup(fileName);
+
+    for (int depth = 0; path != NULL; depth++)
+    {
+        struct stat info;
+        if (lstat(path, &info) != 0 || !S_ISLNK(info.st_mode)) return path;
+
+        if (depth == MAX_LINK_DEPTH) break;
+
+        char* target = (char*)malloc((size_t)info.st_size + 1);
+        if (target == NULL) break;
+
+        ssize_t len = readlink(path, target, (size_t)info.st_size + 1);
+        if (len < 0 || len > info.st_size)
+        {
+            free(target);
+            break;
+        }
+        target[len] = '\0';
+
+        //A relative target is relative to the directory of the link
+        const char* slash = strrchr(path, '/');
+        if (target[0] != '/' && slash != NULL)
+        {
+            size_t dirLen = (size_t)(slash - path) + 1;
+            char* joined = (char*)malloc(dirLen + (size_t)len + 1);
+            if (joined == NULL)
+            {
+                free(target);
+                break;
+            }
+
+            memcpy(joined, path, dirLen);
+            memcpy(joined + dirLen, target, (size_t)len + 1);
+            free(target);
+            target = joined;
+        }
+
+        free(path);
+        path = target;
+    }
+
+    free(path);
+    return NULL;
+}
+
+static bool writeAll(int fd, const char* data, size_t len)
+{
+    size_t written = 0;
+    while (written < len)
+    {
+        ssize_t n = write(fd, data + written, len - written);
+        if (n <= 0) return false;
+        written += (size_t)n;
+    }
+
+    return true;
+}
+
+VCardErrorCode writeCardWithFlags(const char* fileName, const Card* obj, int flags)
+{
+    if (obj == NULL || obj->fn == NULL) return WRITE_ERROR;
+    if (validateFileName(fileName) != OK) return WRITE_ERROR;
+
+    TextBuffer* buf = threadWriteBuffer();
+    if (buf == NULL) return WRITE_ERROR;
+
+    buf->len = 0;
+    buf->failed = false;
+
+    if (!appendCard(buf, obj) || buf->failed)
+    {
+        freeTextBuffer(buf);
+        return WRITE_ERROR;
+    }
+
+    //The temporary file goes next to the file really replaced, so the rename stays on one file system
+    char* target = resolveLinks(fileName);
+    size_t tmpLen = (target != NULL) ? strlen(target) + 48 : 0;
+    char* tmpName = (target != NULL) ? (char*)malloc(tmpLen) : NULL;
+    if (tmpName == NULL)
+    {
+        free(target);
+        return WRITE_ERROR;
+    }
+
+    snprintf(tmpName, tmpLen, "%s.%ld.%u.tmp", target, (long)getpid(), atomic_fetch_add(&tempCounter, 1));
+
+    VCardErrorCode result = WRITE_ERROR;
+    int fd = open(tmpName, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd != -1)
+    {
+        //A replaced card keeps its permissions, and its owner where the process may set it
+        struct stat info;
+        bool ok = true;
+        if (stat(target, &info) == 0)
+        {
+            ok = fchmod(fd, info.st_mode & 07777) == 0;
+
+            //EPERM for another owner's file, which then belongs to this process like a new one
+            if (ok && fchown(fd, info.st_uid, info.st_gid) != 0 && errno != EPERM) ok = false;
+        }
+
+        if (ok) ok = writeAll(fd, buf->data, buf->len);
+        if (ok && (flags & CARD_WRITE_FSYNC)) ok = fsync(fd) == 0;
+        if (close(fd) != 0) ok = false;
+
+        if (ok && rename(tmpName, target) == 0)
+        {
+            result = OK;
+            if ((flags & CARD_WRITE_FSYNC) && !syncDirectory(target)) result = WRITE_ERROR;
+        }
+        else
+        {
+            unlink(tmpName);
+        }
+    }
+
+    free(tmpName);
+    free(target);
+
+    if (buf->capacity > WRITE_BUFFER_KEEP) freeTextBuffer(buf);
+
+    return result;
+}